@@ -0,0 +1,5398 @@
+
+/*file: main.c*************************************************************************************
+ *
+ *
+ *  memhold 0.1
+ *
+ *
+ *  20240704144247UTC
+ *      ==48754== Command: ./memhold 2007
+ *      [ INFO ]  took 8.00s
+ *      ==48754== HEAP SUMMARY:
+ *      ==48754==     in use at exit: 0 bytes in 0 blocks
+ *      ==48754==   total heap usage: 9 allocs, 9 frees, 7,008 bytes allocated
+ *      ==48754== All heap blocks were freed -- no leaks are possible
+ *      ==48754== ERROR SUMMARY: 0 errors from 0 contexts (suppressed: 0 from 0)
+ *
+ *      ==46954== Command: ./memhold 2007
+ *      [ INFO ]  took 8.00s
+ *      ==46954== I refs:        285,880
+ *
+ *
+ *************************************************************************************************/
+
+#define _GNU_SOURCE // Required for: pthread_create() and friends
+
+#include "memhold.h" // Declares module functions
+
+
+#include <assert.h> // Required for: assert()
+#include <dirent.h> // Required for: opendir(), readdir(), rewinddir() - Only used by ProcessTable
+#include <errno.h>  // Required for: errno, ENOENT, ESRCH
+#include <fcntl.h>  // Required for: open(), O_RDONLY, O_CLOEXEC
+#include <float.h>  // Required for: FLT_MAX - Only used by MH_NO_LIMIT_CPU
+#include <limits.h> // Required for: INT_MAX, PATH_MAX
+#include <poll.h>   // Required for: poll() - Only used by ConfigReloader and RecordWriter
+#include <pthread.h> // Required for: pthread_create(), pthread_join() - Only used by ConfigReloader, `--pipeline` and benchmarks
+#include <signal.h> // Required for: sigaction(), SIGUSR1, sig_atomic_t
+#include <stdarg.h>    // Required for: va_list, va_start() - Only used by EmitLog()
+#include <stdatomic.h> // Required for: atomic_exchange(), atomic_load() - Only used by Config snapshots and `--pipeline`
+#include <stdio.h>  // Required for: printf(), fprintf(), sprintf(), stderr, stdout, popen() [with compiler option `-pthread`]
+#include <stdlib.h> // Required for: atoi(), exit()
+#include <string.h> // Required for: strcmp(), NULL
+#include <sys/eventfd.h> // Required for: eventfd() - Only used by ConfigReloader
+#include <sys/inotify.h> // Required for: inotify_init1(), inotify_add_watch() - Only used by ConfigReloader
+#include <sys/mman.h>    // Required for: MADV_COLD, MADV_PAGEOUT - Only used by soft holds
+#include <sys/resource.h> // Required for: RLIMIT_AS, RLIMIT_DATA, RLIMIT_CPU - Only used by limit caps
+#include <sys/wait.h>
+#include <time.h>   // Required for: clock(), clock_gettime(), [time() ~ not used]
+#include <unistd.h> // Required for: fork(), getpid(), sleep(),... [UNIX only lib]
+
+//-----------------------------------------------------------------------------
+// Debug Flags (set in build step)
+//-----------------------------------------------------------------------------
+
+// Debugging: ~ + MEMHOLD_SLOW = 0 --> fast code + MEMHOLD_SLOW = 1 --> slow code: See in "./Makefile": ~ + DFLAGS = -DMEMHOLD_SLOW=0
+#if defined(MEMHOLD_SLOW)
+    #define MEMHOLD_SLOW = 0
+
+#endif
+
+// For when we want to enjoy dabbling with xy problems, code golfing, busy work, and procrastination.
+#if defined(MEMHOLD_YAGNI)
+    #define MEMHOLD_YAGNI = 0
+
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Macros and Defines
+//-----------------------------------------------------------------------------
+
+// clang-format off
+#define COLOR_INFO    CLITERAL(Color) { 102, 191, 255, 255 }   // Sky Blue
+#define COLOR_WARN    CLITERAL(Color) { 255, 161, 0, 255 }     // Orange
+#define COLOR_ERROR   CLITERAL(Color) { 230, 41, 55, 255 }     // Red
+#define COLOR_SUCCESS CLITERAL(Color) { 0, 228, 48, 255 }      // Green
+// clang-format on
+
+
+//-----------------------------------------------------------------------------
+// Some constants
+//-----------------------------------------------------------------------------
+
+// 2s refresh cycle per loop
+static const int MAX_HOT_LOOP_COUNT = (1 << 8); //> `256 (0x100)` (1 << 8)
+
+// Limit fopen for file at path: `char path[256]; snprintf(path, sizeof(path), "/proc/%d/status", pid);`
+static const int MAX_RETRIES_FILE_NOT_FOUND = (1 << 3); //> `8 (0x100)` (1 << 3)
+
+// Most PIDs accepted on the command line
+#define MAX_USER_PIDS (1 << 6) //> `64 (0x40)` (1 << 6)
+
+// /proc/<pid>/cmdline bytes matched against `cmdline` rules
+#define MAX_CMDLINE_LEN (1 << 12) //> `4096 (0x1000)` (1 << 12)
+
+// Upper bound for `--threads=K`
+#define MAX_THREAD_TOP_K (1 << 5) //> `32 (0x20)` (1 << 5)
+
+// Upper bound for `--workers=N`
+#define MAX_SAMPLER_WORKERS (1 << 6) //> `64 (0x40)` (1 << 6)
+
+// Upper bound for `--top=N`
+#define MAX_RANK_TOP_N (1 << 5) //> `32 (0x20)` (1 << 5)
+
+// Values per swept parameter of `memhold simulate`
+#define MAX_SIMULATE_VALUES (1 << 6) //> `64 (0x40)` (1 << 6)
+
+// Threads that may hold a Config snapshot (see RegisterConfigReader())
+#define MAX_CONFIG_READERS (1 << 3) //> `8 (0x8)` (1 << 3)
+
+// Quiet time after the last write to the rules file before it is parsed
+static const int CONFIG_RELOAD_SETTLE_MS = (1 << 6); //> `64 (0x40)` (1 << 6)
+
+// Records per ring between pipeline stages (`--pipeline`), ~2MB each
+static const int STAGE_RING_CAPACITY = (1 << 12); //> `4096 (0x1000)` (1 << 12)
+
+// How often the emit stage looks up from a stalled record reader to check for a stop
+static const int EMIT_POLL_MS = (1 << 7); //> `128 (0x80)` (1 << 7)
+
+// Share of a limit cap (`as=`, `cputime=`) in use that warns the process runs into it
+#define LIMIT_CAP_NEAR_PERCENT 90
+
+
+
+//-----------------------------------------------------------------------------
+// DATA STRUCTURESSSSS
+//-----------------------------------------------------------------------------
+
+// Where per-process CPU samples come from (`--backend=procfs|uring|taskstats`)
+typedef enum
+{
+    SAMPLE_BACKEND_PROCFS = 0, // Text parsing of /proc/<pid>/stat
+    SAMPLE_BACKEND_URING,      // Same text, kept-open fds read in one io_uring batch per frame
+    SAMPLE_BACKEND_TASKSTATS,  // Binary structs over generic netlink
+
+} SampleBackend;
+
+// How frames are reported on stdout (`--format=text|jsonl|csv`)
+typedef enum
+{
+    OUTPUT_FORMAT_TEXT = 0, // `[ INFO ]` lines
+    OUTPUT_FORMAT_JSONL,    // One JSON object per process per frame
+    OUTPUT_FORMAT_CSV,      // Header, then one row per process per frame
+
+} OutputFormat;
+
+// What a rule pattern is matched against (see `--rules`)
+typedef enum
+{
+    RULE_MATCH_COMM = 0, // Exact /proc/<pid>/comm
+    RULE_MATCH_EXE,      // Substring of /proc/<pid>/exe target
+    RULE_MATCH_CMDLINE,  // Substring of /proc/<pid>/cmdline
+    RULE_MATCH_DEFAULT,  // No pattern: replaces the built-in thresholds
+
+} RuleMatch;
+
+// Settings a rule overrides
+// NOTE: Every bit registers one setting (use it with bit masks)
+typedef enum
+{
+    RULE_SET_MEM     = 0x00000001, // mem=
+    RULE_SET_CPU     = 0x00000002, // cpu=
+    RULE_SET_ACTION  = 0x00000004, // action=
+    RULE_SET_RECLAIM = 0x00000008, // reclaim=
+    RULE_SET_TRIGGER = 0x00000010, // trigger=
+    RULE_SET_OOM     = 0x00000020, // oom=
+
+    RULE_SET_LIMIT_AS   = 0x00000040, // as=      (RULE_SET_LIMIT_AS << LimitCapKind)
+    RULE_SET_LIMIT_DATA = 0x00000080, // data=
+    RULE_SET_LIMIT_CPU  = 0x00000100, // cputime=
+
+} RuleSetting;
+
+// What happens to a process over its memory threshold (`action=` in rules)
+typedef enum
+{
+    HOLD_ACTION_NONE = 0, // Warn only
+    HOLD_ACTION_COLD,     // Soft hold: MADV_COLD its private anonymous memory
+    HOLD_ACTION_PAGEOUT,  // Soft hold: MADV_PAGEOUT its private anonymous memory
+
+} HoldAction;
+
+// What makes a process with a hold action held (`trigger=` in rules)
+// NOTE: Every bit registers one trigger (use it with bit masks)
+typedef enum
+{
+    HOLD_TRIGGER_MEM    = 0x00000001, // Over its memory threshold
+    HOLD_TRIGGER_THRASH = 0x00000002, // Major faulting while the host thrashes (see `--thrash`)
+
+} HoldTrigger;
+
+// What memhold does with a process's oom_score_adj (`oom=` in rules)
+typedef enum
+{
+    OOM_POLICY_NONE = 0, // Leave it alone
+    OOM_POLICY_STEER,    // Raise it while over the memory threshold and growing
+    OOM_POLICY_PROTECT,  // Lower it to MH_OOM_PROTECT_ADJ
+
+} OomPolicy;
+
+// Resource limits memhold lowers with prlimit(2) (`as=`, `data=`, `cputime=` in rules)
+typedef enum
+{
+    LIMIT_CAP_AS = 0, // RLIMIT_AS, KB
+    LIMIT_CAP_DATA,   // RLIMIT_DATA, KB
+    LIMIT_CAP_CPU,    // RLIMIT_CPU, seconds
+    LIMIT_CAP_COUNT
+
+} LimitCapKind;
+
+// Caps by LimitCapKind, MH_NO_LIMIT to leave a process's own limit alone
+typedef struct LimitCaps
+{
+    size_t values[LIMIT_CAP_COUNT];
+
+} LimitCaps;
+
+typedef struct Rule
+{
+    RuleMatch    match;
+    char         pattern[MH_RULE_PATTERN_LEN];
+    unsigned int setMask; // RuleSetting bits
+
+    size_t memThreshold; // KB, MH_NO_LIMIT to never trigger
+    float  cpuThreshold; // Percent, MH_NO_LIMIT_CPU to never trigger
+
+    HoldAction   holdAction;
+    size_t       reclaimLimit; // KB advised per frame, MH_NO_LIMIT for all of it
+    unsigned int holdTriggers; // HoldTrigger bits
+    OomPolicy    oomPolicy;
+    LimitCaps    limitCaps;
+
+    int line; // Line in the rules file
+
+} Rule;
+
+// Aho-Corasick automaton flattened into a DFA over byte classes
+typedef struct PatternMatcher
+{
+    unsigned char byteClass[256]; // 0: byte is in no pattern
+    int           classCount;
+    int           stateCount; // 0: no patterns of this kind
+
+    int *delta;  // stateCount * classCount transitions
+    int *output; // Lowest rule index ending at each state, INT_MAX for none
+
+} PatternMatcher;
+
+// Rules compiled for O(len(name)) matching
+typedef struct RuleSet
+{
+    Rule *rules; // File order, lowest index wins
+    int   ruleCount;
+    Rule  defaults; // Settings of `default` lines
+
+    int         *commTable; // Rule index + 1, 0 for empty
+    unsigned int commTableMask;
+
+    PatternMatcher exeMatcher;
+    PatternMatcher cmdlineMatcher;
+
+} RuleSet;
+
+// Immutable snapshot of what `--rules=FILE` configures. Published with one
+// atomic pointer swap and never modified afterwards (see "Config reload").
+typedef struct Config
+{
+    unsigned int generation; // 0 for the first snapshot, +1 per reload
+
+    size_t memThreshold; // KB, built-in or `default mem=`
+    float  cpuThreshold; // Percent, built-in or `default cpu=`
+
+    HoldAction   holdAction;   // Built-in or `default action=`
+    size_t       reclaimLimit; // Built-in or `default reclaim=`
+    unsigned int holdTriggers; // Built-in or `default trigger=`
+    OomPolicy    oomPolicy;    // Built-in (`--oom`) or `default oom=`
+    LimitCaps    limitCaps;    // Built-in (none) or `default as= data= cputime=`
+
+    RuleSet rules;
+
+} Config;
+
+// Watches the rules file and publishes a new Config when it changes
+typedef struct ConfigReloader
+{
+    const char *fileName;
+    const char *baseName;           // Points into fileName
+    char        dirName[PATH_MAX];  // Watched, so editors that rename over the file are seen
+
+    int inotifyFd;
+    int stopFd; // eventfd, wakes the thread on StopConfigReloader()
+
+    pthread_t thread;
+    bool      running;
+
+} ConfigReloader;
+
+typedef struct Memhold
+{
+    bool flagLog;
+    bool flagVerbose;
+
+    const char *apiID;
+    char       *apiVersion;
+
+    float refreshSeconds;
+
+    float  cpuThreshold;
+    size_t memThreshold;
+
+    HoldAction   holdAction;   // Over the memory threshold
+    size_t       reclaimLimit; // KB per frame for soft holds
+    unsigned int holdTriggers; // HoldTrigger bits
+    OomPolicy    oomPolicy;    // For processes no `oom=` rule covers
+    LimitCaps    limitCaps;    // For processes no `as=`, `data=` or `cputime=` rule covers
+
+    SampleBackend sampleBackend; // Where CPU samples come from
+
+    bool flagThreads;    // Sample /proc/<pid>/task/<tid>/stat while the process is hot
+    int  threadTopK;     // Hottest threads reported per frame
+    long faultThreshold; // Major faults per frame that count as hot
+
+    bool        flagAll;       // Monitor every process in /proc (`--all`)
+    const char *rulesFileName; // `--rules=FILE`, reloaded when it changes
+
+    pid_t userProcessPID; // First of userProcessPIDs
+    pid_t userProcessPIDs[MAX_USER_PIDS];
+    int   userProcessCount;
+    pid_t memholdMainProcessPID;
+
+    long            clockTicks;  // sysconf(_SC_CLK_TCK), cached at startup
+    MemholdContext *context;     // libmemhold, shared by every sampling call
+    int             workerCount; // Sampler threads (`--workers=N`), 1 samples inline
+    SamplerPool    *samplerPool; // NULL when workerCount is 1
+
+    OutputFormat outputFormat; // `--format=`. Anything but text moves the `[ INFO ]` lines to stderr
+
+    int   topN;              // Processes per ranking in verbose output (`--top=N`)
+    float pressureThreshold; // PSI memory some avg10 (%) that holds the worst offender first, MH_NO_LIMIT_CPU for never
+    float thrashThreshold;   // Swap-ins + refaults per second that count as host thrashing, MH_NO_LIMIT_CPU for never
+    float workingSetSeconds; // Idle page tracking interval (`--wss`), 0 for RSS only
+
+    bool flagPipeline; // Sample, enforce and emit on their own threads (`--pipeline`)
+
+} Memhold;
+
+
+// What processes are ranked by (see Ranking)
+typedef enum
+{
+    RANK_RSS = 0, // memUsage
+    RANK_GROWTH,  // memGrowth
+    RANK_CPU,     // cpuPercent
+    RANK_COUNT
+
+} RankKey;
+
+// Max-heap of process slots by one key, indexed by slot. Only entries whose
+// key changed are sifted, so a frame where few processes move costs little
+// more than the compares, and the top N are read without sorting.
+typedef struct Ranking
+{
+    int    *heap;     // Slots, heap[0] ranks first
+    int    *position; // Slot -> index in heap, -1 when not ranked
+    double *keys;     // Slot -> key
+    int     count;
+    int     capacity; // Slots
+
+} Ranking;
+
+// One monitored process
+typedef struct Process
+{
+    bool  used; // Slot holds a live entry
+    pid_t pid;
+    char  comm[MH_COMM_LEN];
+
+    // (pid, starttime) is the identity. A PID reused by a new process never
+    // inherits the state or holds of the old one.
+    unsigned long long starttime; // Clock ticks after boot (CLOCK_BOOTTIME)
+    unsigned long long sampledUs; // CLOCK_MONOTONIC before the last taskstats sample, 0 for none
+
+    int    ruleIndex;    // Matched rule, -1 for defaults
+    size_t memThreshold; // KB, resolved from rules
+    float  cpuThreshold; // Percent, resolved from rules
+
+    HoldAction   holdAction;   // Resolved from rules
+    size_t       reclaimLimit; // KB per frame, resolved from rules
+    unsigned int holdTriggers; // Resolved from rules
+    Reclaimer    reclaimer;
+
+    OomPolicy oomPolicy; // Resolved from rules
+    OomScore  oomScore;  // Opened on the first change
+
+    ProcLimits         limits;                        // /proc/<pid>/limits at attach (`--verbose`)
+    LimitCaps          limitCaps;                     // Resolved from rules
+    LimitCaps          appliedCaps;                   // Caps prlimit(2) has set, MH_NO_LIMIT where the process's own limit holds
+    unsigned long long replacedSoft[LIMIT_CAP_COUNT]; // Soft limits the first cap replaced, put back by RestoreLimitCaps()
+    unsigned long long appliedSoft[LIMIT_CAP_COUNT];  // Soft limits as set
+    unsigned int       capsNear;                      // Edge state: (1 << LimitCapKind) bits of caps the process runs into
+
+    WorkingSet         workingSet;        // Open while over the memory threshold by RSS (`--wss`)
+    size_t             workingSetKB;      // Pages accessed over the last interval
+    bool               hasWorkingSet;     // workingSetKB is current, thresholds use it instead of RSS
+    bool               workingSetPending; // Pages marked idle, no estimate yet: memory holds wait for it
+    unsigned long long workingSetNs;      // When the pages were last marked idle
+
+    bool               primed;     // cpuTimeNs holds a previous sample
+    unsigned long long cpuTimeNs;  // Cumulative utime + stime
+    double             cpuPercent; // Of one CPU, over the last frame
+    size_t             memUsage;   // VmRSS in KB
+    size_t             vmSizeKB;   // VmSize (taskstats: its high-water mark), for `as=`
+    double             memGrowth;  // KB/s over the last frame
+    unsigned long      lastMajflt;
+    long               majfltDelta; // Major faults over the last frame
+
+    bool overMem;   // Edge state for threshold warnings
+    bool overCpu;   //
+    bool thrashing; // Major faulting while the host thrashes
+
+    TaskSample    taskSample;    // Latest sample (`--backend=taskstats`)
+    ThreadSampler threadSampler; // Active only while hot (`--threads`)
+
+} Process;
+
+// What DecideProcess() makes of one process in one frame
+typedef struct Decision
+{
+    bool overMem;
+    bool overCpu;
+    bool hold; // Its hold action is due
+
+} Decision;
+
+// Tracked processes in stable slots, indexed by PID
+typedef struct ProcessTable
+{
+    Process *slots;
+    int      slotCount; // Slots ever used (iterate up to this)
+    int      slotCapacity;
+    int      count; // Live processes
+
+    unsigned int sampledFields; // SampleField bits of the previous procfs frame, deltas need both ends
+
+    int *freeSlots; // Stack of reusable slots
+    int  freeCount;
+
+    int         *index; // Open addressing PID -> slot, -1 for empty
+    unsigned int indexMask;
+
+    DIR *procDir; // /proc, rewound by DiscoverProcesses()
+
+    ProcReader *reader; // Stat fds by slot (`--backend=uring`), NULL otherwise
+
+    Ranking rankings[RANK_COUNT];
+
+} ProcessTable;
+
+// Records of one frame, formatted without stdio and written with one
+// non-blocking write(). A frame that finds the previous one still pending
+// is dropped, so a slow reader never delays sampling.
+typedef struct RecordWriter
+{
+    int          fd;        // The original stdout, O_NONBLOCK. -1 for text output
+    int          fileFlags; // Its F_GETFL flags before, shared with whoever else holds it
+    OutputFormat format;
+
+    char  *buffer;
+    size_t length;  // Bytes of the current frame
+    size_t flushed; // Bytes of it already written, the rest is pending
+    size_t capacity;
+
+    unsigned long long writtenFrames;
+    unsigned long long droppedFrames;
+
+} RecordWriter;
+
+// Latency histograms of the main loop, in ns (see LogStats())
+typedef struct LoopStats
+{
+    SampleTimings sampleTimings; // Inline sampling. Pool workers and readers keep their own
+
+    Histogram frameNs;    // Sampling to the end of enforcement, sleep excluded
+    Histogram latenessNs; // How much later than asked the sleep between frames ended
+    Histogram actionNs;   // Start of the frame that saw a process over its threshold to the end of its hold
+
+    unsigned long long oomWrites;  // oom_score_adj writes
+    unsigned long long oomSkipped; // Changes under MH_OOM_HYSTERESIS, not written
+
+    unsigned long long limitWrites; // prlimit(2) calls that lowered or put back a limit
+
+} LoopStats;
+
+// What a StageRecord carries (`--pipeline`)
+typedef enum
+{
+    STAGE_RECORD_PROCESS = 0, // One sampled (or enforced) process
+    STAGE_RECORD_FRAME,       // End of a frame
+    STAGE_RECORD_LOG,         // A piece of log output
+
+} StageRecordType;
+
+// One frame as the sample stage hands it to evaluate/enforce
+typedef struct FrameInfo
+{
+    double             frameSeconds; // Since the previous frame, 0 on the first (it only primes deltas)
+    unsigned long long frameBeginNs; // Before sampling
+    int                slotCount;    // Slots to go through
+
+    int topRss[MAX_RANK_TOP_N]; // Slots with the most RSS first, for holds under pressure
+    int topRssCount;
+
+} FrameInfo;
+
+// Fixed-size record of the rings between pipeline stages
+typedef struct StageRecord
+{
+    StageRecordType    type;
+    int                slot;       // STAGE_RECORD_PROCESS
+    int                frame;      // Frames sampled so far
+    unsigned int       generation; // Config generation the frame was sampled with
+    unsigned long long timeMs;     // Wall clock of the frame, for records
+
+    union
+    {
+        Process   process;   // STAGE_RECORD_PROCESS
+        FrameInfo info;      // STAGE_RECORD_FRAME
+        char      text[256]; // STAGE_RECORD_LOG, NUL-terminated
+    };
+
+} StageRecord;
+
+// The sample stage: process table, backends and frame pacing
+typedef struct FrameSampler
+{
+    ProcessTable     table;
+    TaskstatsBackend taskstats;
+    int              configReader;
+    unsigned int     appliedGeneration;
+    struct timespec  lastFrameTime;
+    int              frame; // Frames sampled so far
+
+} FrameSampler;
+
+// The evaluate/enforce stage: host signals kept across frames
+typedef struct Enforcer
+{
+    int pressureFd; // /proc/pressure/memory, kept open
+    int vmStatFd;   // /proc/vmstat, kept open
+
+    VmStat lastVmStat;
+    bool   vmStatPrimed;
+    bool   hostThrashing;
+
+} Enforcer;
+
+// Sample -> evaluate/enforce -> emit, one thread each (`--pipeline`). The
+// sample stage waits when its ring is full; evaluate/enforce never waits on
+// the emit ring and drops records instead, so a stalled stdout delays
+// neither holds nor sampling.
+typedef struct Pipeline
+{
+    FrameSampler *sampler;
+    RecordRing   *sampleRing; // sample -> evaluate/enforce
+    RecordRing   *emitRing;   // evaluate/enforce -> emit
+
+    pthread_t sampleThread;
+    pthread_t emitThread;
+
+    Process *slots;      // Evaluate/enforce's copies of the sampled processes, by slot
+    int     *slotFrames; // Frame each slot was last sampled in
+    int      slotCapacity;
+
+    _Atomic unsigned long long emitBusyNs; // Emit stage writing output
+
+} Pipeline;
+
+// One (time, pid, rss, cpu) sample of a `memhold simulate` trace
+typedef struct TraceSample
+{
+    unsigned long long timeMs;
+    int                process; // Index into Trace.pids
+    unsigned int       rssKB;
+    float              cpuPercent;
+
+} TraceSample;
+
+typedef struct Trace
+{
+    TraceSample *samples; // By time
+    int          sampleCount;
+    int          sampleCapacity;
+
+    pid_t              *pids;   // By process index
+    unsigned long long *lastMs; // Time of the last sample of each process
+    int                 processCount;
+    int                 processCapacity;
+
+    int *processByPid; // Process index + 1, 0 for none
+    int  pidCapacity;
+
+} Trace;
+
+// One point of a `memhold simulate` sweep
+typedef struct SimulatePolicy
+{
+    size_t memThreshold; // KB, MH_NO_LIMIT to never trigger
+    float  cpuThreshold; // Percent, MH_NO_LIMIT_CPU to never trigger
+    float  refreshSeconds;
+
+} SimulatePolicy;
+
+// What one policy did over a trace
+typedef struct SimulateResult
+{
+    unsigned long long frameCount;
+    unsigned long long holdCount;    // Frames a process was held in
+    unsigned long long overMs;       // Trace time spent over the memory threshold, summed over processes
+    unsigned long long episodeCount; // Times a process went over the memory threshold
+    unsigned long long missedCount;  // Episodes over before any frame held them
+    Histogram          reactionMs;   // Start of an episode to its first hold
+
+} SimulateResult;
+
+// Trace state of one process while a policy runs
+typedef struct SimulateProcess
+{
+    bool               seen;    // Has had a sample
+    bool               over;    // Latest sample is over the memory threshold
+    bool               pending; // Over, not held yet
+    unsigned int       rssKB;   // Latest sample
+    float              cpuPercent;
+    unsigned long long lastMs;    // Time of the latest sample
+    unsigned long long episodeMs; // Start of the current episode
+
+} SimulateProcess;
+
+// One thread of `memhold bench threads`
+typedef struct BenchThreadsWork
+{
+    const MemholdContext *context; // Shared by every thread
+    const pid_t          *pids;
+    int                   count;
+    int                   roundCount;
+
+    long sampledCount; // Result
+
+} BenchThreadsWork;
+
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+// TODO: All declared global variables, must be initialized. Even if it is 0 again.
+
+Memhold memhold = {0};
+
+bool  gVerbose; //@Temp
+pid_t gProcPID;
+pid_t gProcPIDs[MAX_USER_PIDS];
+int   gProcPIDCount = 0;
+bool  gFlagAll      = false;
+int   gThreadTopK = 0; // 0: per-thread sampling disabled
+int   gWorkerCount  = 1;
+int   gTopN         = 5;
+
+float gPressureThreshold = 10.0f;
+float gThrashThreshold   = 1000.0f; // Pages per second, ~4MB/s
+
+OomPolicy gOomPolicy = OOM_POLICY_NONE;
+
+float gWorkingSetSeconds = 0.0f; // 0: thresholds apply to RSS
+
+SampleBackend gSampleBackend = SAMPLE_BACKEND_PROCFS;
+OutputFormat  gOutputFormat  = OUTPUT_FORMAT_TEXT;
+
+static const char *gProcReaderModeNames[] = {"pread", "io_uring", "io_uring (registered buffers)"}; // By ProcReaderMode
+
+// By LimitCapKind
+static const char  *gLimitCapNames[]     = {"as", "data", "cputime"};
+static const int    gLimitCapResources[] = {RLIMIT_AS, RLIMIT_DATA, RLIMIT_CPU};
+static const size_t gLimitCapScales[]    = {1024, 1024, 1}; // Cap units to limit units (bytes, seconds)
+
+const char *gRulesFileName = NULL;
+
+static int cntrFopenRetries = 0;
+
+static LoopStats    gLoopStats    = {0};
+static RecordWriter gRecordWriter = {.fd = -1};
+
+bool gPipeline = false;
+
+// Where this thread's frame output goes in `--pipeline` mode, NULL for stdout
+static _Thread_local RecordRing *tStageRing      = NULL;
+static _Thread_local bool        tStageRingWaits = false; // The sample stage waits for room, evaluate/enforce drops
+
+// Set by signal handlers, acted on between frames. Lock-free atomics, so the
+// `--pipeline` stages may look at them from any thread.
+static atomic_int gStopRequested  = 0; // SIGINT, SIGTERM
+static atomic_int gStatsRequested = 0; // SIGUSR1
+
+// Current Config snapshot and the epochs readers last announced (0: offline)
+static Config *_Atomic gConfig                                 = NULL;
+static atomic_ulong    gConfigEpoch                            = 1;
+static atomic_ulong    gConfigReaderEpochs[MAX_CONFIG_READERS] = {0};
+static atomic_int      gConfigReaderCount                      = 0;
+
+
+//-----------------------------------------------------------------------------
+// FUNCTIONSSSS
+//-----------------------------------------------------------------------------
+
+MHAPI Memhold InitMemhold(void);
+
+MHAPI Memhold InitMemhold(void)
+{
+    Memhold result = {};
+
+    result = (Memhold){
+        .flagLog     = true,     // TODO(Lloyd): Override via CLI args
+        .flagVerbose = gVerbose, // TODO(Lloyd): Override via CLI args
+
+        .apiID      = MEMHOLD_ID,
+        .apiVersion = MEMHOLD_VERSION,
+
+        .refreshSeconds = 2.0f,
+
+        .cpuThreshold = 50.0f,
+        .memThreshold = MH_MEMORY_THRESHOLD, //>10240kb Max: 500000kb
+
+        .holdAction   = HOLD_ACTION_NONE, // Set with `action=` in rules
+        .reclaimLimit = MH_NO_LIMIT,      // Set with `reclaim=` in rules
+        .holdTriggers = HOLD_TRIGGER_MEM, // Set with `trigger=` in rules
+        .oomPolicy    = gOomPolicy,       // Set with `--oom`, or `oom=` in rules
+        .limitCaps    = {{MH_NO_LIMIT, MH_NO_LIMIT, MH_NO_LIMIT}}, // Set with `as=`, `data=`, `cputime=` in rules
+
+        .sampleBackend = gSampleBackend, // Set with `--backend=taskstats`
+        .outputFormat  = gOutputFormat,  // Set with `--format=jsonl|csv`
+
+        .flagThreads    = (gThreadTopK > 0), // Set with `--threads[=K]`
+        .threadTopK     = gThreadTopK,
+        .faultThreshold = MH_FAULT_THRESHOLD,
+
+        .flagAll       = gFlagAll,       // Set with `--all`
+        .rulesFileName = gRulesFileName, // Set with `--rules=FILE`
+
+        .userProcessPID        = gProcPID,
+        .userProcessCount      = gProcPIDCount,
+        .memholdMainProcessPID = 0,
+
+        .clockTicks  = sysconf(_SC_CLK_TCK),
+        .workerCount = gWorkerCount, // Set with `--workers=N`
+
+        .topN              = gTopN,              // Set with `--top=N`
+        .pressureThreshold = gPressureThreshold, // Set with `--pressure=PCT|none`
+        .thrashThreshold   = gThrashThreshold,   // Set with `--thrash=PAGES|none`
+        .workingSetSeconds = gWorkingSetSeconds, // Set with `--wss[=SECONDS]`
+
+        .flagPipeline = gPipeline, // Set with `--pipeline`
+    };
+
+    return result;
+}
+
+MHAPI Config *LoadConfig(const char *fileName);
+MHAPI void    PublishConfig(Config *config);
+
+int Init(void);
+
+int Init(void)
+{
+    int status = -1; // SUCCESS
+
+    cntrFopenRetries = 0;
+    memhold          = InitMemhold();
+    {
+        memhold.memholdMainProcessPID = getpid();
+        memcpy(memhold.userProcessPIDs, gProcPIDs, sizeof(gProcPIDs));
+    }
+
+    memhold.context = CreateMemholdContext();
+    if (!memhold.context) return status;
+
+    if (memhold.workerCount > 1)
+    {
+        memhold.samplerPool = CreateSamplerPool(memhold.context, memhold.workerCount);
+        if (!memhold.samplerPool) return status;
+    }
+
+    Config *config = LoadConfig(memhold.rulesFileName);
+
+    if (!config) return status;
+    PublishConfig(config);
+
+    status = 0;
+
+    return status;
+};
+
+
+
+//-----------------------------------------------------------------------------
+// Module specific function declarations
+//-----------------------------------------------------------------------------
+
+int RunMain(void);
+
+MHAPI int  LoadRules(const char *fileName, RuleSet *ruleSet);
+MHAPI int  MatchRules(const RuleSet *ruleSet, const char *comm, const char *exe, const char *cmdline, int cmdlineLen);
+MHAPI void UnloadRules(RuleSet *ruleSet);
+
+MHAPI Config       *LoadConfig(const char *fileName);
+MHAPI void          UnloadConfig(Config *config);
+MHAPI void          PublishConfig(Config *config);
+MHAPI const Config *AcquireConfig(void);
+MHAPI int           RegisterConfigReader(void);
+MHAPI void          ConfigQuiescentState(int reader);
+MHAPI void          ConfigReaderOffline(int reader);
+MHAPI int           StartConfigReloader(ConfigReloader *reloader, const char *fileName);
+MHAPI void          StopConfigReloader(ConfigReloader *reloader);
+
+MHAPI int  FindProcess(const ProcessTable *table, pid_t pid);
+MHAPI int  AttachProcess(ProcessTable *table, const Config *config, pid_t pid);
+MHAPI void DetachProcess(ProcessTable *table, int slot);
+MHAPI int  DiscoverProcesses(ProcessTable *table, const Config *config);
+MHAPI void UnloadProcessTable(ProcessTable *table);
+
+int RunBench(int argc, char *argv[]);
+int RunSimulate(int argc, char *argv[]);
+
+MHAPI void LogProcLimits(const Process *process);
+MHAPI void NoOp(void); // Placeholder function that does nothing.
+
+
+#if MEMHOLD_YAGNI
+MHAPI void PanicUnimplemented(void);
+#endif /* if MEMHOLD_YAGNI */
+
+
+//-----------------------------------------------------------------------------
+// Module specific function implementations
+//-----------------------------------------------------------------------------
+
+
+MHAPI void NoOp(void) {}
+
+
+// "unlimited", or the value in the units of /proc/<pid>/limits
+static void FormatProcLimit(unsigned long long value, char *text, size_t size)
+{
+    if (value == MH_LIMIT_UNLIMITED) snprintf(text, size, "unlimited");
+    else snprintf(text, size, "%llu", value);
+}
+
+
+// One line per row of /proc/<pid>/limits, as parsed at attach (`--verbose`)
+MHAPI void LogProcLimits(const Process *process)
+{
+    if (!process->limits.found)
+    {
+        fprintf(stdout, "[ INFO ]  PID: %d  %s  limits: unavailable\n", process->pid, process->comm);
+        return;
+    }
+
+    for (int resource = 0; resource < MH_PROC_LIMIT_COUNT; resource++)
+    {
+        if (!(process->limits.found & (1u << resource))) continue;
+
+        char soft[32], hard[32];
+        FormatProcLimit(process->limits.soft[resource], soft, sizeof(soft));
+        FormatProcLimit(process->limits.hard[resource], hard, sizeof(hard));
+
+        fprintf(stdout, "[ INFO ]  PID: %d  %s  %-21s soft: %-20s hard: %s\n", process->pid, process->comm, GetProcLimitName(resource), soft, hard);
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// Rules (`--rules=FILE`)
+//-----------------------------------------------------------------------------
+//
+// Per-program thresholds. One rule per line, first matching line wins:
+//
+//     # <match>  <pattern>          [key=value ...]
+//     default                       mem=10M cpu=50
+//     comm       clangd             mem=2G
+//     comm       waybar             mem=200M
+//     comm       postgres           mem=none
+//     exe        /opt/firefox/      mem=4G cpu=80
+//     cmdline    "--type=renderer"  mem=1G
+//     comm       chromium           mem=3G action=pageout reclaim=256M
+//
+// Match kinds: ~
+//   - comm:    exact match on /proc/<pid>/comm
+//   - exe:     substring of the /proc/<pid>/exe link target
+//   - cmdline: substring of /proc/<pid>/cmdline, arguments joined by spaces
+//   - default: no pattern, replaces the built-in thresholds
+//
+// The file is watched while memhold runs. Saving it applies the new rules to
+// every tracked process on the next frame (see "Config reload").
+//
+// Keys: ~
+//   - mem: KB, or with K/M/G/T suffix. `none` never triggers
+//   - cpu: percent of one CPU. `none` never triggers
+//   - action: over `mem`, `none` (warn only), `cold` or `pageout` (soft hold)
+//   - reclaim: most memory a soft hold advises per frame, like `mem`. `none`
+//     advises all private anonymous memory each frame
+//   - as, data: cap RLIMIT_AS / RLIMIT_DATA with prlimit(2), like `mem`. The
+//     kernel then refuses allocations past it. `none` leaves the limit alone
+//   - cputime: cap RLIMIT_CPU, in seconds or with s/m/h suffix (SIGXCPU past it)
+//
+// Note: ~
+//   - comm rules compile into a hash table. exe and cmdline patterns compile
+//     into one Aho-Corasick DFA each, so matching a process costs
+//     O(len(comm) + len(exe) + len(cmdline)) no matter how many rules exist.
+
+// FNV-1a. Hashes the exact `comm` of a process.
+static unsigned int HashString(const char *text)
+{
+    unsigned int hash = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+        hash = (hash ^ *p) * 16777619u;
+
+    return hash;
+}
+
+
+// Parse "2G", "200M", "512K", "10240" (KB) or "none". Returns -1 on error.
+static int ParseRuleSize(const char *text, size_t *sizeKB)
+{
+    if (strcmp(text, "none") == 0)
+    {
+        *sizeKB = MH_NO_LIMIT;
+        return 0;
+    }
+
+    char              *end   = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (end == text) return -1;
+
+    switch (*end)
+    {
+    case '\0':
+    case 'K':
+    case 'k': break;
+    case 'M':
+    case 'm': value <<= 10; break;
+    case 'G':
+    case 'g': value <<= 20; break;
+    case 'T':
+    case 't': value <<= 30; break;
+    default: return -1;
+    }
+
+    if ((*end != '\0') && (end[1] != '\0')) return -1; // "200MB": a typo, not 200M
+
+    *sizeKB = (size_t)value;
+
+    return 0;
+}
+
+
+// Parse "80", "80%" or "none". Returns -1 on error.
+static int ParseRulePercent(const char *text, float *percent)
+{
+    if (strcmp(text, "none") == 0)
+    {
+        *percent = MH_NO_LIMIT_CPU;
+        return 0;
+    }
+
+    char *end = NULL;
+    *percent  = strtof(text, &end);
+
+    return ((end == text) || ((*end != '\0') && (strcmp(end, "%") != 0))) ? -1 : 0;
+}
+
+
+// Parse "3600", "90s", "30m", "2h" or "none" into seconds. Returns -1 on error.
+static int ParseRuleSeconds(const char *text, size_t *seconds)
+{
+    if (strcmp(text, "none") == 0)
+    {
+        *seconds = MH_NO_LIMIT;
+        return 0;
+    }
+
+    char              *end   = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (end == text) return -1;
+
+    switch (*end)
+    {
+    case '\0':
+    case 's': break;
+    case 'm': value *= 60; break;
+    case 'h': value *= 3600; break;
+    default: return -1;
+    }
+
+    if ((*end != '\0') && (end[1] != '\0')) return -1;
+
+    *seconds = (size_t)value;
+
+    return 0;
+}
+
+
+// Take the caps `setMask` overrides from `from`
+static void MergeLimitCaps(LimitCaps *caps, const LimitCaps *from, unsigned int setMask)
+{
+    for (int kind = 0; kind < LIMIT_CAP_COUNT; kind++)
+        if (setMask & (RULE_SET_LIMIT_AS << kind)) caps->values[kind] = from->values[kind];
+}
+
+
+// Parse "mem", "thrash" or "mem,thrash" into HoldTrigger bits. Returns -1 on error.
+static int ParseRuleTriggers(char *text, unsigned int *triggers)
+{
+    char *savePtr = NULL;
+
+    *triggers = 0;
+
+    for (char *name = strtok_r(text, ",", &savePtr); name; name = strtok_r(NULL, ",", &savePtr))
+    {
+        if (strcmp(name, "mem") == 0) *triggers |= HOLD_TRIGGER_MEM;
+        else if (strcmp(name, "thrash") == 0) *triggers |= HOLD_TRIGGER_THRASH;
+        else return -1;
+    }
+
+    return (*triggers != 0) ? 0 : -1;
+}
+
+
+// Split `line` in place into whitespace separated tokens. Double quotes group
+// a token with spaces. Returns the token count.
+static int TokenizeRuleLine(char *line, char **tokens, int maxTokens)
+{
+    int   tokenCount = 0;
+    char *p          = line;
+
+    while (tokenCount < maxTokens)
+    {
+        while ((*p == ' ') || (*p == '\t'))
+            p++;
+
+        if ((*p == '\0') || (*p == '\n') || (*p == '#')) break;
+
+        if (*p == '"')
+        {
+            tokens[tokenCount++] = ++p;
+            while (*p && (*p != '"'))
+                p++;
+        }
+        else
+        {
+            tokens[tokenCount++] = p;
+            while (*p && (*p != ' ') && (*p != '\t') && (*p != '\n'))
+                p++;
+        }
+
+        if (*p == '\0') break;
+        *p++ = '\0';
+    }
+
+    return tokenCount;
+}
+
+
+// Build the Aho-Corasick DFA for every rule of kind `match`.
+//
+// Bytes that appear in no pattern share byte class 0, so each DFA row is only
+// as wide as the pattern alphabet (usually < 64) instead of 256.
+static int BuildPatternMatcher(PatternMatcher *matcher, const Rule *rules, int ruleCount, RuleMatch match)
+{
+    *matcher = (PatternMatcher){0};
+
+    // Byte classes
+    //----------------------------------------------------------------------------------
+    int patternBytes = 0;
+
+    for (int r = 0; r < ruleCount; r++)
+    {
+        if (rules[r].match != match) continue;
+
+        for (const unsigned char *p = (const unsigned char *)rules[r].pattern; *p; p++)
+        {
+            if (matcher->byteClass[*p] == 0) matcher->byteClass[*p] = 1;
+            patternBytes += 1;
+        }
+    }
+
+    if (patternBytes == 0) return 0; // No rule of this kind
+
+    matcher->classCount = 1;
+    for (int b = 0; b < 256; b++)
+        if (matcher->byteClass[b]) matcher->byteClass[b] = (unsigned char)(matcher->classCount++);
+    //----------------------------------------------------------------------------------
+
+    // Trie. At most one state per pattern byte, plus the root.
+    //----------------------------------------------------------------------------------
+    int maxStates = patternBytes + 1;
+    int classes   = matcher->classCount;
+
+    matcher->delta  = MH_MALLOC(maxStates * classes * sizeof(int));
+    matcher->output = MH_MALLOC(maxStates * sizeof(int));
+
+    int *fail  = MH_MALLOC(maxStates * sizeof(int));
+    int *queue = MH_MALLOC(maxStates * sizeof(int));
+
+    if (!matcher->delta || !matcher->output || !fail || !queue)
+    {
+        MH_FREE(fail);
+        MH_FREE(queue);
+        return -1;
+    }
+
+    for (int i = 0; i < maxStates * classes; i++)
+        matcher->delta[i] = -1;
+    for (int i = 0; i < maxStates; i++)
+        matcher->output[i] = INT_MAX;
+
+    matcher->stateCount = 1;
+
+    for (int r = 0; r < ruleCount; r++)
+    {
+        if (rules[r].match != match) continue;
+
+        int state = 0;
+
+        for (const unsigned char *p = (const unsigned char *)rules[r].pattern; *p; p++)
+        {
+            int *next = &matcher->delta[(state * classes) + matcher->byteClass[*p]];
+            if (*next < 0) *next = matcher->stateCount++;
+            state = *next;
+        }
+
+        if (r < matcher->output[state]) matcher->output[state] = r;
+    }
+    //----------------------------------------------------------------------------------
+
+    // Failure links, folded into the DFA in BFS order
+    //----------------------------------------------------------------------------------
+    int queueHead = 0, queueTail = 0;
+
+    for (int c = 0; c < classes; c++)
+    {
+        int child = matcher->delta[c];
+
+        if (child < 0) matcher->delta[c] = 0;
+        else
+        {
+            fail[child]        = 0;
+            queue[queueTail++] = child;
+        }
+    }
+
+    while (queueHead < queueTail)
+    {
+        int state = queue[queueHead++];
+
+        for (int c = 0; c < classes; c++)
+        {
+            int *next     = &matcher->delta[(state * classes) + c];
+            int  fallback = matcher->delta[(fail[state] * classes) + c];
+
+            if (*next < 0) *next = fallback;
+            else
+            {
+                fail[*next] = fallback;
+
+                // Lowest rule index of any pattern that ends here (suffixes included)
+                if (matcher->output[fallback] < matcher->output[*next]) matcher->output[*next] = matcher->output[fallback];
+
+                queue[queueTail++] = *next;
+            }
+        }
+    }
+    //----------------------------------------------------------------------------------
+
+    MH_FREE(fail);
+    MH_FREE(queue);
+
+    return 0;
+}
+
+
+// Lowest rule index whose pattern occurs in `text`, or INT_MAX.
+static int RunPatternMatcher(const PatternMatcher *matcher, const char *text, int textLen)
+{
+    if (matcher->stateCount == 0) return INT_MAX;
+
+    int best  = INT_MAX;
+    int state = 0;
+
+    for (int i = 0; i < textLen; i++)
+    {
+        state = matcher->delta[(state * matcher->classCount) + matcher->byteClass[(unsigned char)text[i]]];
+        if (matcher->output[state] < best) best = matcher->output[state];
+    }
+
+    return best;
+}
+
+
+// Compile the exact comm hash table and the exe/cmdline matchers.
+static int CompileRules(RuleSet *ruleSet)
+{
+    int commRuleCount = 0;
+
+    for (int r = 0; r < ruleSet->ruleCount; r++)
+        if (ruleSet->rules[r].match == RULE_MATCH_COMM) commRuleCount += 1;
+
+    int capacity = 16;
+    while (capacity < (2 * commRuleCount))
+        capacity *= 2;
+
+    ruleSet->commTable     = MH_CALLOC(capacity, sizeof(int));
+    ruleSet->commTableMask = capacity - 1;
+
+    if (!ruleSet->commTable) return -1;
+
+    for (int r = 0; r < ruleSet->ruleCount; r++)
+    {
+        if (ruleSet->rules[r].match != RULE_MATCH_COMM) continue;
+
+        unsigned int i = HashString(ruleSet->rules[r].pattern) & ruleSet->commTableMask;
+
+        // Linear probing. Entries hold rule index + 1; a duplicate keeps the earlier rule.
+        while ((ruleSet->commTable[i] != 0) && (strcmp(ruleSet->rules[ruleSet->commTable[i] - 1].pattern, ruleSet->rules[r].pattern) != 0))
+            i = (i + 1) & ruleSet->commTableMask;
+
+        if (ruleSet->commTable[i] == 0) ruleSet->commTable[i] = r + 1;
+    }
+
+    if (BuildPatternMatcher(&ruleSet->exeMatcher, ruleSet->rules, ruleSet->ruleCount, RULE_MATCH_EXE) != 0) return -1;
+    if (BuildPatternMatcher(&ruleSet->cmdlineMatcher, ruleSet->rules, ruleSet->ruleCount, RULE_MATCH_CMDLINE) != 0) return -1;
+
+    return 0;
+}
+
+
+// Parse and compile a rules file. On error nothing is kept and -1 is returned.
+MHAPI int LoadRules(const char *fileName, RuleSet *ruleSet)
+{
+    *ruleSet = (RuleSet){0};
+
+    FILE *fp = fopen(fileName, "r");
+
+    if (!fp)
+    {
+        fprintf(stderr, "[ ERR! ]  failed to open rules file: %s\n", fileName);
+        return -1;
+    }
+
+    int  capacity   = 0;
+    int  lineNumber = 0;
+    char line[1024];
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineNumber += 1;
+
+        char *tokens[16];
+        int   tokenCount = TokenizeRuleLine(line, tokens, (int)ARRAY_SIZE(tokens));
+
+        if (tokenCount == 0) continue; // Blank or comment
+
+        Rule rule = {.line = lineNumber};
+
+        if (strcmp(tokens[0], "comm") == 0) rule.match = RULE_MATCH_COMM;
+        else if (strcmp(tokens[0], "exe") == 0) rule.match = RULE_MATCH_EXE;
+        else if (strcmp(tokens[0], "cmdline") == 0) rule.match = RULE_MATCH_CMDLINE;
+        else if (strcmp(tokens[0], "default") == 0) rule.match = RULE_MATCH_DEFAULT;
+        else
+        {
+            fprintf(stderr, "[ ERR! ]  %s:%d: unknown match '%s' (comm, exe, cmdline, default)\n", fileName, lineNumber, tokens[0]);
+            goto parseError;
+        }
+
+        int firstSetting = 1; // `default` has no pattern
+
+        if (rule.match != RULE_MATCH_DEFAULT)
+        {
+            if ((tokenCount < 2) || (tokens[1][0] == '\0'))
+            {
+                fprintf(stderr, "[ ERR! ]  %s:%d: expected a pattern\n", fileName, lineNumber);
+                goto parseError;
+            }
+
+            if (strlen(tokens[1]) >= sizeof(rule.pattern))
+            {
+                fprintf(stderr, "[ ERR! ]  %s:%d: pattern longer than %zu bytes\n", fileName, lineNumber, sizeof(rule.pattern) - 1);
+                goto parseError;
+            }
+
+            strcpy(rule.pattern, tokens[1]);
+            firstSetting = 2;
+        }
+
+        for (int t = firstSetting; t < tokenCount; t++)
+        {
+            char *value = strchr(tokens[t], '=');
+            int   error = -1;
+
+            if (value)
+            {
+                *value++ = '\0';
+
+                if (strcmp(tokens[t], "mem") == 0)
+                {
+                    error = ParseRuleSize(value, &rule.memThreshold);
+                    rule.setMask |= RULE_SET_MEM;
+                }
+                else if (strcmp(tokens[t], "cpu") == 0)
+                {
+                    error = ParseRulePercent(value, &rule.cpuThreshold);
+                    rule.setMask |= RULE_SET_CPU;
+                }
+                else if (strcmp(tokens[t], "action") == 0)
+                {
+                    error = 0;
+                    if (strcmp(value, "none") == 0) rule.holdAction = HOLD_ACTION_NONE;
+                    else if (strcmp(value, "cold") == 0) rule.holdAction = HOLD_ACTION_COLD;
+                    else if (strcmp(value, "pageout") == 0) rule.holdAction = HOLD_ACTION_PAGEOUT;
+                    else error = -1;
+                    rule.setMask |= RULE_SET_ACTION;
+                }
+                else if (strcmp(tokens[t], "reclaim") == 0)
+                {
+                    error = ParseRuleSize(value, &rule.reclaimLimit);
+                    if (rule.reclaimLimit == 0) error = -1; // Would never advance
+                    rule.setMask |= RULE_SET_RECLAIM;
+                }
+                else if (strcmp(tokens[t], "trigger") == 0)
+                {
+                    error = ParseRuleTriggers(value, &rule.holdTriggers);
+                    rule.setMask |= RULE_SET_TRIGGER;
+                }
+                else if (strcmp(tokens[t], "oom") == 0)
+                {
+                    error = 0;
+                    if (strcmp(value, "none") == 0) rule.oomPolicy = OOM_POLICY_NONE;
+                    else if (strcmp(value, "steer") == 0) rule.oomPolicy = OOM_POLICY_STEER;
+                    else if (strcmp(value, "protect") == 0) rule.oomPolicy = OOM_POLICY_PROTECT;
+                    else error = -1;
+                    rule.setMask |= RULE_SET_OOM;
+                }
+                else if (strcmp(tokens[t], "as") == 0)
+                {
+                    error = ParseRuleSize(value, &rule.limitCaps.values[LIMIT_CAP_AS]);
+                    rule.setMask |= RULE_SET_LIMIT_AS;
+                }
+                else if (strcmp(tokens[t], "data") == 0)
+                {
+                    error = ParseRuleSize(value, &rule.limitCaps.values[LIMIT_CAP_DATA]);
+                    rule.setMask |= RULE_SET_LIMIT_DATA;
+                }
+                else if (strcmp(tokens[t], "cputime") == 0)
+                {
+                    error = ParseRuleSeconds(value, &rule.limitCaps.values[LIMIT_CAP_CPU]);
+                    rule.setMask |= RULE_SET_LIMIT_CPU;
+                }
+            }
+
+            if (error != 0)
+            {
+                fprintf(stderr, "[ ERR! ]  %s:%d: bad setting '%s'\n", fileName, lineNumber, tokens[t]);
+                goto parseError;
+            }
+        }
+
+        if (rule.match == RULE_MATCH_DEFAULT)
+        {
+            if (rule.setMask & RULE_SET_MEM) ruleSet->defaults.memThreshold = rule.memThreshold;
+            if (rule.setMask & RULE_SET_CPU) ruleSet->defaults.cpuThreshold = rule.cpuThreshold;
+            if (rule.setMask & RULE_SET_ACTION) ruleSet->defaults.holdAction = rule.holdAction;
+            if (rule.setMask & RULE_SET_RECLAIM) ruleSet->defaults.reclaimLimit = rule.reclaimLimit;
+            if (rule.setMask & RULE_SET_TRIGGER) ruleSet->defaults.holdTriggers = rule.holdTriggers;
+            if (rule.setMask & RULE_SET_OOM) ruleSet->defaults.oomPolicy = rule.oomPolicy;
+            MergeLimitCaps(&ruleSet->defaults.limitCaps, &rule.limitCaps, rule.setMask);
+            ruleSet->defaults.setMask |= rule.setMask;
+            continue;
+        }
+
+        if (ruleSet->ruleCount == capacity)
+        {
+            capacity    = (capacity == 0) ? 32 : (capacity * 2);
+            Rule *rules = MH_REALLOC(ruleSet->rules, capacity * sizeof(Rule));
+
+            if (!rules) goto parseError;
+            ruleSet->rules = rules;
+        }
+
+        ruleSet->rules[ruleSet->ruleCount++] = rule;
+    }
+
+    fclose(fp);
+
+    if (CompileRules(ruleSet) != 0)
+    {
+        fprintf(stderr, "[ ERR! ]  failed to compile rules: %s\n", fileName);
+        UnloadRules(ruleSet);
+        return -1;
+    }
+
+    return 0;
+
+parseError:
+
+    fclose(fp);
+    UnloadRules(ruleSet);
+
+    return -1;
+}
+
+
+// Index of the first rule matching the process, or -1 for none.
+// `exe` and `cmdline` may be NULL when the rule set has no such patterns.
+MHAPI int MatchRules(const RuleSet *ruleSet, const char *comm, const char *exe, const char *cmdline, int cmdlineLen)
+{
+    int best = INT_MAX;
+
+    if (ruleSet->commTable && comm)
+    {
+        unsigned int i = HashString(comm) & ruleSet->commTableMask;
+
+        while (ruleSet->commTable[i] != 0)
+        {
+            int r = ruleSet->commTable[i] - 1;
+
+            if (strcmp(ruleSet->rules[r].pattern, comm) == 0)
+            {
+                best = r;
+                break;
+            }
+
+            i = (i + 1) & ruleSet->commTableMask;
+        }
+    }
+
+    if (exe)
+    {
+        int r = RunPatternMatcher(&ruleSet->exeMatcher, exe, (int)strlen(exe));
+        if (r < best) best = r;
+    }
+
+    if (cmdline)
+    {
+        int r = RunPatternMatcher(&ruleSet->cmdlineMatcher, cmdline, cmdlineLen);
+        if (r < best) best = r;
+    }
+
+    return (best == INT_MAX) ? -1 : best;
+}
+
+
+MHAPI void UnloadRules(RuleSet *ruleSet)
+{
+    MH_FREE(ruleSet->rules);
+    MH_FREE(ruleSet->commTable);
+    MH_FREE(ruleSet->exeMatcher.delta);
+    MH_FREE(ruleSet->exeMatcher.output);
+    MH_FREE(ruleSet->cmdlineMatcher.delta);
+    MH_FREE(ruleSet->cmdlineMatcher.output);
+
+    *ruleSet = (RuleSet){0};
+}
+
+
+//-----------------------------------------------------------------------------
+// Config reload
+//-----------------------------------------------------------------------------
+//
+// The rules file is watched with inotify by a thread of its own. On a change
+// it is parsed and compiled there, off the sampling path, into a new Config.
+// A broken file is reported and the running Config is kept.
+//
+// Publication is RCU style: ~
+//   - Readers call AcquireConfig() (one atomic load) and never lock.
+//   - The reloader swaps the snapshot pointer, bumps gConfigEpoch, then waits
+//     for a grace period: every registered reader has announced the new epoch
+//     with ConfigQuiescentState(), or is offline. Only then is the old
+//     snapshot freed.
+//   - A reader must not keep a snapshot across ConfigQuiescentState() or
+//     ConfigReaderOffline(). The main loop is offline while it sleeps, so a
+//     reload never waits for a whole refresh period.
+
+
+// Parse and compile `fileName` (NULL for the built-in thresholds only).
+// Returns NULL on error.
+MHAPI Config *LoadConfig(const char *fileName)
+{
+    Config *config = MH_CALLOC(1, sizeof(Config));
+
+    if (!config) return NULL;
+
+    config->memThreshold = memhold.memThreshold;
+    config->cpuThreshold = memhold.cpuThreshold;
+    config->holdAction   = memhold.holdAction;
+    config->reclaimLimit = memhold.reclaimLimit;
+    config->holdTriggers = memhold.holdTriggers;
+    config->oomPolicy    = memhold.oomPolicy;
+    config->limitCaps    = memhold.limitCaps;
+
+    if (fileName)
+    {
+        if (LoadRules(fileName, &config->rules) != 0)
+        {
+            MH_FREE(config);
+            return NULL;
+        }
+
+        // `default` lines replace the built-in thresholds
+        if (config->rules.defaults.setMask & RULE_SET_MEM) config->memThreshold = config->rules.defaults.memThreshold;
+        if (config->rules.defaults.setMask & RULE_SET_CPU) config->cpuThreshold = config->rules.defaults.cpuThreshold;
+        if (config->rules.defaults.setMask & RULE_SET_ACTION) config->holdAction = config->rules.defaults.holdAction;
+        if (config->rules.defaults.setMask & RULE_SET_RECLAIM) config->reclaimLimit = config->rules.defaults.reclaimLimit;
+        if (config->rules.defaults.setMask & RULE_SET_TRIGGER) config->holdTriggers = config->rules.defaults.holdTriggers;
+        if (config->rules.defaults.setMask & RULE_SET_OOM) config->oomPolicy = config->rules.defaults.oomPolicy;
+        MergeLimitCaps(&config->limitCaps, &config->rules.defaults.limitCaps, config->rules.defaults.setMask);
+    }
+
+    return config;
+}
+
+
+MHAPI void UnloadConfig(Config *config)
+{
+    if (!config) return;
+
+    UnloadRules(&config->rules);
+    MH_FREE(config);
+}
+
+
+// Make `config` current and free the previous snapshot once no reader can
+// hold it. Publishing NULL retires the last snapshot on shutdown.
+// NOTE: Only one thread may publish at a time (Init(), then the reloader).
+MHAPI void PublishConfig(Config *config)
+{
+    Config *previous = atomic_load(&gConfig);
+
+    if (config && previous) config->generation = previous->generation + 1;
+
+    previous = atomic_exchange(&gConfig, config);
+
+    if (!previous) return;
+
+    // Grace period: wait for every online reader to pass a quiescent state
+    unsigned long epoch       = atomic_fetch_add(&gConfigEpoch, 1) + 1;
+    int           readerCount = atomic_load(&gConfigReaderCount);
+
+    for (int reader = 0; reader < readerCount; reader++)
+    {
+        unsigned long readerEpoch;
+
+        while (((readerEpoch = atomic_load(&gConfigReaderEpochs[reader])) != 0) && (readerEpoch < epoch))
+            usleep(1000);
+    }
+
+    UnloadConfig(previous);
+}
+
+
+// Current snapshot. Valid until the caller's next ConfigQuiescentState() or
+// ConfigReaderOffline().
+MHAPI const Config *AcquireConfig(void) { return atomic_load(&gConfig); }
+
+
+// Register the calling thread as a Config reader. It starts online.
+// Returns the reader id or -1 when MAX_CONFIG_READERS are registered.
+MHAPI int RegisterConfigReader(void)
+{
+    int reader = atomic_fetch_add(&gConfigReaderCount, 1);
+
+    if (reader >= MAX_CONFIG_READERS)
+    {
+        atomic_fetch_sub(&gConfigReaderCount, 1);
+        return -1;
+    }
+
+    ConfigQuiescentState(reader);
+
+    return reader;
+}
+
+
+// Announce that `reader` holds no snapshot acquired before this call, and go
+// online if it was offline.
+MHAPI void ConfigQuiescentState(int reader) { atomic_store(&gConfigReaderEpochs[reader], atomic_load(&gConfigEpoch)); }
+
+
+// `reader` holds no snapshot until its next ConfigQuiescentState().
+MHAPI void ConfigReaderOffline(int reader) { atomic_store(&gConfigReaderEpochs[reader], 0); }
+
+
+static void *ConfigReloaderThread(void *arg)
+{
+    ConfigReloader *reloader = arg;
+
+    // SIGINT, SIGTERM and SIGUSR1 wake the main loop, not this thread
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct pollfd pollFds[2] = {
+        {.fd = reloader->inotifyFd, .events = POLLIN},
+        {.fd = reloader->stopFd, .events = POLLIN},
+    };
+
+    // Aligned for struct inotify_event, see inotify(7)
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1)
+    {
+        if (poll(pollFds, 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pollFds[1].revents) break;
+
+        bool    changed   = false;
+        ssize_t bytesRead = read(reloader->inotifyFd, events, sizeof(events));
+
+        for (char *cursor = events; cursor < events + bytesRead;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)cursor;
+
+            if ((event->len > 0) && (strcmp(event->name, reloader->baseName) == 0)) changed = true;
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+
+        if (!changed) continue;
+
+        // Editors save in bursts (truncate, write, rename). Let it settle.
+        if (poll(&pollFds[1], 1, CONFIG_RELOAD_SETTLE_MS) > 0) break;
+        while (read(reloader->inotifyFd, events, sizeof(events)) > 0) {}
+
+        Config *config = LoadConfig(reloader->fileName);
+
+        if (!config)
+        {
+            fprintf(stderr, "[ WARN ]  failed to reload %s, keeping the previous rules\n", reloader->fileName);
+            continue;
+        }
+
+        PublishConfig(config);
+    }
+
+    return NULL;
+}
+
+
+// Watch `fileName` and publish a new Config each time it is written or
+// replaced. Returns 0 on success, -1 on error.
+MHAPI int StartConfigReloader(ConfigReloader *reloader, const char *fileName)
+{
+    *reloader = (ConfigReloader){.fileName = fileName, .inotifyFd = -1, .stopFd = -1};
+
+    const char *slash = strrchr(fileName, '/');
+
+    if (slash)
+    {
+        int dirLen = (slash == fileName) ? 1 : (int)(slash - fileName);
+        if (dirLen >= (int)sizeof(reloader->dirName)) return -1;
+
+        memcpy(reloader->dirName, fileName, dirLen);
+        reloader->dirName[dirLen] = '\0';
+        reloader->baseName        = slash + 1;
+    }
+    else
+    {
+        strcpy(reloader->dirName, ".");
+        reloader->baseName = fileName;
+    }
+
+    reloader->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (reloader->inotifyFd < 0) goto ioError;
+
+    if (inotify_add_watch(reloader->inotifyFd, reloader->dirName, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) goto ioError;
+
+    reloader->stopFd = eventfd(0, EFD_CLOEXEC);
+    if (reloader->stopFd < 0) goto ioError;
+
+    if (pthread_create(&reloader->thread, NULL, ConfigReloaderThread, reloader) != 0) goto ioError;
+
+    reloader->running = true;
+
+    return 0;
+
+ioError:
+
+    fprintf(stderr, "[ ERR! ]  failed to watch %s: %s\n", reloader->dirName, strerror(errno));
+
+    if (reloader->inotifyFd >= 0) close(reloader->inotifyFd);
+    if (reloader->stopFd >= 0) close(reloader->stopFd);
+    reloader->inotifyFd = reloader->stopFd = -1;
+
+    return -1;
+}
+
+
+// NOTE: Take every reader of this thread offline first, a reload in flight
+// waits for them.
+MHAPI void StopConfigReloader(ConfigReloader *reloader)
+{
+    if (!reloader->running) return;
+
+    unsigned long long one = 1;
+    if (write(reloader->stopFd, &one, sizeof(one)) != sizeof(one)) fprintf(stderr, "[ ERR! ]  failed to stop config reloader\n");
+
+    pthread_join(reloader->thread, NULL);
+
+    close(reloader->inotifyFd);
+    close(reloader->stopFd);
+    reloader->running = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Rankings
+//-----------------------------------------------------------------------------
+
+static void SwapRanked(Ranking *ranking, int i, int j)
+{
+    int slotI = ranking->heap[i];
+    int slotJ = ranking->heap[j];
+
+    ranking->heap[i]         = slotJ;
+    ranking->heap[j]         = slotI;
+    ranking->position[slotJ] = i;
+    ranking->position[slotI] = j;
+}
+
+
+static void SiftRankedUp(Ranking *ranking, int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+
+        if (ranking->keys[ranking->heap[parent]] >= ranking->keys[ranking->heap[i]]) break;
+
+        SwapRanked(ranking, i, parent);
+        i = parent;
+    }
+}
+
+
+static void SiftRankedDown(Ranking *ranking, int i)
+{
+    while (1)
+    {
+        int largest = i;
+        int left    = (2 * i) + 1;
+        int right   = left + 1;
+
+        if ((left < ranking->count) && (ranking->keys[ranking->heap[left]] > ranking->keys[ranking->heap[largest]])) largest = left;
+        if ((right < ranking->count) && (ranking->keys[ranking->heap[right]] > ranking->keys[ranking->heap[largest]])) largest = right;
+
+        if (largest == i) break;
+
+        SwapRanked(ranking, i, largest);
+        i = largest;
+    }
+}
+
+
+// Grow to `capacity` slots. Returns 0, or -1 when out of memory.
+static int ReserveRanking(Ranking *ranking, int capacity)
+{
+    if (capacity <= ranking->capacity) return 0;
+
+    int    *heap     = MH_REALLOC(ranking->heap, capacity * sizeof(int));
+    if (heap) ranking->heap = heap;
+    int    *position = MH_REALLOC(ranking->position, capacity * sizeof(int));
+    if (position) ranking->position = position;
+    double *keys     = MH_REALLOC(ranking->keys, capacity * sizeof(double));
+    if (keys) ranking->keys = keys;
+
+    if (!heap || !position || !keys) return -1;
+
+    for (int slot = ranking->capacity; slot < capacity; slot++)
+        ranking->position[slot] = -1;
+
+    ranking->capacity = capacity;
+
+    return 0;
+}
+
+
+// Rank `slot` by `key`. O(1) when the key did not change, O(log n) otherwise.
+static void UpdateRanking(Ranking *ranking, int slot, double key)
+{
+    int i = ranking->position[slot];
+
+    if (i < 0)
+    {
+        i                       = ranking->count++;
+        ranking->heap[i]        = slot;
+        ranking->position[slot] = i;
+        ranking->keys[slot]     = key;
+        SiftRankedUp(ranking, i);
+        return;
+    }
+
+    double previous = ranking->keys[slot];
+
+    if (key == previous) return;
+
+    ranking->keys[slot] = key;
+
+    if (key > previous) SiftRankedUp(ranking, i);
+    else SiftRankedDown(ranking, i);
+}
+
+
+static void RemoveRanked(Ranking *ranking, int slot)
+{
+    if (slot >= ranking->capacity) return;
+
+    int i = ranking->position[slot];
+
+    if (i < 0) return;
+
+    int last = --ranking->count;
+
+    if (i != last)
+    {
+        int moved = ranking->heap[last];
+
+        SwapRanked(ranking, i, last);
+        SiftRankedUp(ranking, i);
+        SiftRankedDown(ranking, ranking->position[moved]);
+    }
+
+    ranking->position[slot] = -1;
+}
+
+
+// Copy the `n` first ranked slots, in order. Walks the heap best-first from
+// the root, so it touches O(n) entries whatever the number of processes.
+static int GetTopRanked(const Ranking *ranking, int *slots, int n)
+{
+    int candidates[MAX_RANK_TOP_N + 1]; // Heap indices. Each pop adds at most two
+    int candidateCount = 0;
+    int foundCount     = 0;
+
+    if (n > MAX_RANK_TOP_N) n = MAX_RANK_TOP_N;
+    if (ranking->count > 0) candidates[candidateCount++] = 0;
+
+    while ((foundCount < n) && (candidateCount > 0))
+    {
+        int best = 0;
+
+        for (int c = 1; c < candidateCount; c++)
+            if (ranking->keys[ranking->heap[candidates[c]]] > ranking->keys[ranking->heap[candidates[best]]]) best = c;
+
+        int i               = candidates[best];
+        candidates[best]    = candidates[--candidateCount];
+        slots[foundCount++] = ranking->heap[i];
+
+        if ((2 * i) + 1 < ranking->count) candidates[candidateCount++] = (2 * i) + 1;
+        if ((2 * i) + 2 < ranking->count) candidates[candidateCount++] = (2 * i) + 2;
+    }
+
+    return foundCount;
+}
+
+
+static void UnloadRanking(Ranking *ranking)
+{
+    MH_FREE(ranking->heap);
+    MH_FREE(ranking->position);
+    MH_FREE(ranking->keys);
+
+    *ranking = (Ranking){0};
+}
+
+
+//-----------------------------------------------------------------------------
+// Process table
+//-----------------------------------------------------------------------------
+//
+// Monitored processes live in stable slots (freed slots are reused), found by
+// PID through an open addressing index with linear probing.
+
+static unsigned int HashPid(pid_t pid) { return (unsigned int)pid * 2654435761u; }
+
+
+MHAPI int FindProcess(const ProcessTable *table, pid_t pid)
+{
+    if (table->indexMask == 0) return -1;
+
+    for (unsigned int i = HashPid(pid) & table->indexMask; table->index[i] >= 0; i = (i + 1) & table->indexMask)
+    {
+        if (table->slots[table->index[i]].pid == pid) return table->index[i];
+    }
+
+    return -1;
+}
+
+
+// Grow slots and index so one more process fits at <= 50% index load.
+static int ReserveProcessSlot(ProcessTable *table)
+{
+    if ((table->count + 1) * 2 > (int)(table->indexMask + 1))
+    {
+        unsigned int capacity = (table->indexMask == 0) ? 64 : (2 * (table->indexMask + 1));
+        int         *index    = MH_MALLOC(capacity * sizeof(int));
+
+        if (!index) return -1;
+
+        for (unsigned int i = 0; i < capacity; i++)
+            index[i] = -1;
+
+        for (int slot = 0; slot < table->slotCount; slot++)
+        {
+            if (!table->slots[slot].used) continue;
+
+            unsigned int i = HashPid(table->slots[slot].pid) & (capacity - 1);
+            while (index[i] >= 0)
+                i = (i + 1) & (capacity - 1);
+            index[i] = slot;
+        }
+
+        MH_FREE(table->index);
+        table->index     = index;
+        table->indexMask = capacity - 1;
+    }
+
+    if ((table->freeCount == 0) && (table->slotCount == table->slotCapacity))
+    {
+        int      capacity  = (table->slotCapacity == 0) ? 64 : (2 * table->slotCapacity);
+        Process *slots     = MH_REALLOC(table->slots, capacity * sizeof(Process));
+        int     *freeSlots = MH_REALLOC(table->freeSlots, capacity * sizeof(int));
+
+        if (slots) table->slots = slots;
+        if (freeSlots) table->freeSlots = freeSlots;
+        if (!slots || !freeSlots) return -1;
+
+        for (int key = 0; key < RANK_COUNT; key++)
+            if (ReserveRanking(&table->rankings[key], capacity) != 0) return -1;
+
+        table->slotCapacity = capacity;
+    }
+
+    return 0;
+}
+
+
+// Read what the rules match on and resolve the process thresholds.
+static void ApplyRules(Process *process, const Config *config)
+{
+    const RuleSet *ruleSet = &config->rules;
+
+    process->ruleIndex    = -1;
+    process->memThreshold = config->memThreshold;
+    process->cpuThreshold = config->cpuThreshold;
+    process->holdAction   = config->holdAction;
+    process->reclaimLimit = config->reclaimLimit;
+    process->holdTriggers = config->holdTriggers;
+    process->oomPolicy    = config->oomPolicy;
+    process->limitCaps    = config->limitCaps;
+
+    if (ruleSet->ruleCount == 0) return;
+
+    char  path[256];
+    char  exe[PATH_MAX];
+    char  cmdline[MAX_CMDLINE_LEN];
+    char *exeArg     = NULL;
+    char *cmdlineArg = NULL;
+    int   cmdlineLen = 0;
+
+    // Only pay for the reads some rule can use
+    if (ruleSet->exeMatcher.stateCount > 0)
+    {
+        snprintf(path, sizeof(path), "/proc/%d/exe", process->pid);
+
+        ssize_t exeLen = readlink(path, exe, sizeof(exe) - 1);
+        if (exeLen > 0)
+        {
+            exe[exeLen] = '\0';
+            exeArg      = exe;
+        }
+    }
+
+    if (ruleSet->cmdlineMatcher.stateCount > 0)
+    {
+        snprintf(path, sizeof(path), "/proc/%d/cmdline", process->pid);
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            ssize_t bytesRead = read(fd, cmdline, sizeof(cmdline));
+            close(fd);
+
+            if (bytesRead > 0)
+            {
+                for (ssize_t i = 0; i < bytesRead; i++)
+                    if (cmdline[i] == '\0') cmdline[i] = ' ';
+
+                cmdlineArg = cmdline;
+                cmdlineLen = (int)bytesRead;
+            }
+        }
+    }
+
+    process->ruleIndex = MatchRules(ruleSet, process->comm, exeArg, cmdlineArg, cmdlineLen);
+
+    if (process->ruleIndex >= 0)
+    {
+        const Rule *rule = &ruleSet->rules[process->ruleIndex];
+
+        if (rule->setMask & RULE_SET_MEM) process->memThreshold = rule->memThreshold;
+        if (rule->setMask & RULE_SET_CPU) process->cpuThreshold = rule->cpuThreshold;
+        if (rule->setMask & RULE_SET_ACTION) process->holdAction = rule->holdAction;
+        if (rule->setMask & RULE_SET_RECLAIM) process->reclaimLimit = rule->reclaimLimit;
+        if (rule->setMask & RULE_SET_TRIGGER) process->holdTriggers = rule->holdTriggers;
+        if (rule->setMask & RULE_SET_OOM) process->oomPolicy = rule->oomPolicy;
+        MergeLimitCaps(&process->limitCaps, &rule->limitCaps, rule->setMask);
+    }
+}
+
+
+// Start tracking PID. Returns its slot, or -1 if it is gone or already tracked.
+MHAPI int AttachProcess(ProcessTable *table, const Config *config, pid_t pid)
+{
+    ProcessSample sample;
+
+    if (FindProcess(table, pid) >= 0) return -1;
+    if (SampleProcess(memhold.context, pid, &sample) != 0) return -1;
+    if (ReserveProcessSlot(table) != 0) return -1;
+
+    int slot = (table->freeCount > 0) ? table->freeSlots[--table->freeCount] : table->slotCount++;
+
+    Process *process = &table->slots[slot];
+
+    *process = (Process){
+        .used       = true,
+        .pid        = pid,
+        .starttime  = sample.starttime,
+        .lastMajflt = sample.majflt,
+        .reclaimer  = {.pidfd = -1},
+        .oomScore   = {.fd = -1},
+        .workingSet = {.pagemapFd = -1, .bitmapFd = -1},
+
+        .vmSizeKB    = sample.vsizeKB,
+        .appliedCaps = {{MH_NO_LIMIT, MH_NO_LIMIT, MH_NO_LIMIT}},
+    };
+    memcpy(process->comm, sample.comm, sizeof(process->comm));
+
+    GetProcLimits(pid, &process->limits); // Without them (`found` is 0) no cap is applied
+
+    ApplyRules(process, config);
+
+    if (table->reader) AttachProcReader(table->reader, slot, pid); // On error the slot is read by path
+
+    unsigned int i = HashPid(pid) & table->indexMask;
+    while (table->index[i] >= 0)
+        i = (i + 1) & table->indexMask;
+    table->index[i] = slot;
+
+    table->count += 1;
+
+    return slot;
+}
+
+
+// Put back the soft limits ApplyLimitCaps() lowered, on memhold exit. prlimit(2)
+// goes by bare PID, so only while (pid, starttime) still is the process we
+// capped: once it is gone its caps are gone with it, and a reused PID is a
+// stranger's.
+static void RestoreLimitCaps(Process *process)
+{
+    unsigned int capped = 0;
+
+    for (int kind = 0; kind < LIMIT_CAP_COUNT; kind++)
+        if (process->appliedCaps.values[kind] != MH_NO_LIMIT) capped += 1;
+
+    if (capped == 0) return;
+
+    ProcessSample sample;
+    bool          alive = (SampleProcess(memhold.context, process->pid, &sample) == 0) && (sample.starttime == process->starttime);
+
+    for (int kind = 0; kind < LIMIT_CAP_COUNT; kind++)
+    {
+        if (process->appliedCaps.values[kind] == MH_NO_LIMIT) continue;
+
+        if (alive && (SetProcSoftLimit(process->pid, gLimitCapResources[kind], process->replacedSoft[kind], NULL) == 0)) gLoopStats.limitWrites += 1;
+        process->appliedCaps.values[kind] = MH_NO_LIMIT;
+    }
+}
+
+
+// Close what enforcement opened for a process: thread fds, the pidfd, and
+// oom_score_adj and the working set. Limits are put back only when
+// `alive`, not when the process is gone or its PID reused.
+static void ReleaseProcess(Process *process, bool alive)
+{
+    if (alive) RestoreLimitCaps(process);
+    if (process->threadSampler.active) UnloadThreadSampler(&process->threadSampler);
+    CloseReclaimer(&process->reclaimer);
+    CloseOomScore(&process->oomScore, true);
+    if (process->workingSet.pagemapFd >= 0) CloseWorkingSet(&process->workingSet);
+}
+
+
+MHAPI void DetachProcess(ProcessTable *table, int slot)
+{
+    Process *process = &table->slots[slot];
+
+    if (!process->used) return;
+
+    ReleaseProcess(process, false); // Gone, or PID reused: nothing of ours to put back
+    if (table->reader) DetachProcReader(table->reader, slot);
+
+    for (int key = 0; key < RANK_COUNT; key++)
+        RemoveRanked(&table->rankings[key], slot);
+
+    // Backward shift deletion keeps probe chains intact without tombstones
+    unsigned int i = HashPid(process->pid) & table->indexMask;
+    while (table->index[i] != slot)
+        i = (i + 1) & table->indexMask;
+
+    table->index[i] = -1;
+
+    for (unsigned int j = (i + 1) & table->indexMask; table->index[j] >= 0; j = (j + 1) & table->indexMask)
+    {
+        unsigned int home = HashPid(table->slots[table->index[j]].pid) & table->indexMask;
+
+        // Move the entry back if its home is not in the cyclic range (i, j]
+        bool inRange = (i <= j) ? ((home > i) && (home <= j)) : ((home > i) || (home <= j));
+
+        if (!inRange)
+        {
+            table->index[i] = table->index[j];
+            table->index[j] = -1;
+            i               = j;
+        }
+    }
+
+    process->used                          = false;
+    table->freeSlots[table->freeCount++] = slot;
+    table->count -= 1;
+}
+
+
+// Attach every process in /proc not tracked yet (`--all`). Returns how many
+// were attached.
+MHAPI int DiscoverProcesses(ProcessTable *table, const Config *config)
+{
+    if (!table->procDir) table->procDir = opendir("/proc");
+    if (!table->procDir) return -1;
+
+    rewinddir(table->procDir);
+
+    struct dirent *entry         = NULL;
+    int            attachedCount = 0;
+
+    while ((entry = readdir(table->procDir)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+
+        pid_t pid = (pid_t)atoi(entry->d_name);
+
+        if ((pid == memhold.memholdMainProcessPID) || (FindProcess(table, pid) >= 0)) continue;
+        if (AttachProcess(table, config, pid) >= 0) attachedCount += 1;
+    }
+
+    return attachedCount;
+}
+
+
+MHAPI void UnloadProcessTable(ProcessTable *table)
+{
+    for (int slot = 0; slot < table->slotCount; slot++)
+    {
+        if (!table->slots[slot].used) continue;
+
+        RestoreLimitCaps(&table->slots[slot]); // On exit, if it is still there
+        DetachProcess(table, slot);
+    }
+
+    if (table->procDir) closedir(table->procDir);
+    DestroyProcReader(table->reader);
+
+    for (int key = 0; key < RANK_COUNT; key++)
+        UnloadRanking(&table->rankings[key]);
+
+    MH_FREE(table->slots);
+    MH_FREE(table->freeSlots);
+    MH_FREE(table->index);
+
+    *table = (ProcessTable){0};
+}
+
+
+#if MEMHOLD_YAGNI
+MHAPI void PanicUnimplemented(void) { UNIMPLEMENTED; }
+#endif /* if MEMHOLD_YAGNI */
+
+//-----------------------------------------------------------------------------
+// Records (`--format=jsonl|csv`)
+//-----------------------------------------------------------------------------
+//
+// Field names are stable: add new ones at the end, never rename. In CSV,
+// `none` thresholds are empty cells. In JSON Lines, they are null.
+
+static const char *gRecordCsvHeader = "time_ms,frame,pid,comm,rss_kb,growth_kb_s,cpu_pct,majflt,mem_threshold_kb,cpu_threshold_pct,over_mem,over_cpu,"
+                                      "hold,thrashing,oom_score_adj,wss_kb\n";
+
+static void AppendRecordBytes(RecordWriter *writer, const char *bytes, size_t length)
+{
+    memcpy(writer->buffer + writer->length, bytes, length);
+    writer->length += length;
+}
+
+
+static void AppendRecordString(RecordWriter *writer, const char *text) { AppendRecordBytes(writer, text, strlen(text)); }
+
+
+static void AppendRecordUnsigned(RecordWriter *writer, unsigned long long value)
+{
+    char digits[20];
+    int  count = 0;
+
+    do
+    {
+        digits[count++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0)
+        writer->buffer[writer->length++] = digits[--count];
+}
+
+
+static void AppendRecordSigned(RecordWriter *writer, long long value)
+{
+    if (value < 0) writer->buffer[writer->length++] = '-';
+
+    AppendRecordUnsigned(writer, (value < 0) ? (0ULL - (unsigned long long)value) : (unsigned long long)value);
+}
+
+
+// Fixed point with two decimals, rounded half away from zero
+static void AppendRecordFixed(RecordWriter *writer, double value)
+{
+    if (!(value == value) || (value > 1e15) || (value < -1e15)) value = 0.0; // NaN and absurd values
+
+    if (value < 0)
+    {
+        writer->buffer[writer->length++] = '-';
+        value                             = -value;
+    }
+
+    unsigned long long hundredths = (unsigned long long)((value * 100.0) + 0.5);
+
+    AppendRecordUnsigned(writer, hundredths / 100);
+    writer->buffer[writer->length++] = '.';
+    writer->buffer[writer->length++] = (char)('0' + ((hundredths / 10) % 10));
+    writer->buffer[writer->length++] = (char)('0' + (hundredths % 10));
+}
+
+
+// `comm` as a JSON string or a CSV cell. Up to 6 bytes per input byte.
+static void AppendRecordText(RecordWriter *writer, const char *text)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    writer->buffer[writer->length++] = '"';
+
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        if (writer->format == OUTPUT_FORMAT_CSV)
+        {
+            if (*p == '"') writer->buffer[writer->length++] = '"';
+            writer->buffer[writer->length++] = (char)*p;
+        }
+        else if ((*p == '"') || (*p == '\\'))
+        {
+            writer->buffer[writer->length++] = '\\';
+            writer->buffer[writer->length++] = (char)*p;
+        }
+        else if (*p < 0x20)
+        {
+            AppendRecordString(writer, "\\u00");
+            writer->buffer[writer->length++] = hex[*p >> 4];
+            writer->buffer[writer->length++] = hex[*p & 0xf];
+        }
+        else writer->buffer[writer->length++] = (char)*p;
+    }
+
+    writer->buffer[writer->length++] = '"';
+}
+
+
+// Take over stdout for records. `[ INFO ]` lines go to stderr from now on.
+static int OpenRecordWriter(RecordWriter *writer, OutputFormat format)
+{
+    *writer = (RecordWriter){.fd = -1, .format = format};
+
+    if (format == OUTPUT_FORMAT_TEXT) return 0;
+
+    fflush(stdout);
+
+    writer->fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+    if (writer->fd < 0) return -1;
+
+    // The dup shares the open file description (the shell's tty, a pipe),
+    // so O_NONBLOCK is undone in CloseRecordWriter()
+    writer->fileFlags = fcntl(writer->fd, F_GETFL);
+
+    if ((writer->fileFlags < 0) || (dup2(STDERR_FILENO, STDOUT_FILENO) < 0) || (fcntl(writer->fd, F_SETFL, writer->fileFlags | O_NONBLOCK) < 0))
+    {
+        close(writer->fd);
+        writer->fd = -1;
+        return -1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A reader that went away is EPIPE, not death
+
+    if (format == OUTPUT_FORMAT_CSV) write(writer->fd, gRecordCsvHeader, strlen(gRecordCsvHeader)); // Before any frame, so it fits the pipe
+
+    return 0;
+}
+
+
+// Write what the pipe takes of the pending frame, which counts as written
+// once its last byte is out. Any error but EAGAIN ends the records.
+static void WriteRecordFrame(RecordWriter *writer)
+{
+    ssize_t bytesWritten = write(writer->fd, writer->buffer + writer->flushed, writer->length - writer->flushed);
+
+    if (bytesWritten > 0)
+    {
+        writer->flushed += (size_t)bytesWritten;
+        if (writer->flushed == writer->length) writer->writtenFrames += 1;
+        return;
+    }
+
+    if ((bytesWritten < 0) && (errno != EAGAIN) && (errno != EINTR))
+    {
+        if (errno == EPIPE) fprintf(stdout, "[ WARN ]  record reader went away, no more records\n");
+        else fprintf(stdout, "[ WARN ]  record output failed (%s), no more records\n", strerror(errno));
+
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
+
+
+// Finish writing the previous frame. Returns false when it is still
+// pending, and this frame is dropped.
+static bool BeginRecordFrame(RecordWriter *writer)
+{
+    if (writer->fd < 0) return false;
+
+    if (writer->flushed < writer->length)
+    {
+        WriteRecordFrame(writer);
+
+        if (writer->fd < 0) return false;
+
+        if (writer->flushed < writer->length)
+        {
+            writer->droppedFrames += 1;
+            return false;
+        }
+    }
+
+    writer->length  = 0;
+    writer->flushed = 0;
+
+    return true;
+}
+
+
+// Append one process. Returns -1 when out of memory (the record is skipped).
+static int AppendProcessRecord(RecordWriter *writer, const Process *process, int frame, unsigned long long timeMs)
+{
+    static const char *holdNames[] = {"none", "cold", "pageout"}; // By HoldAction
+
+    if (writer->capacity - writer->length < 1024) // Longest record, with every comm byte escaped
+    {
+        size_t capacity = (writer->capacity == 0) ? (1 << 16) : (2 * writer->capacity);
+        char  *buffer   = MH_REALLOC(writer->buffer, capacity);
+
+        if (!buffer) return -1;
+
+        writer->buffer   = buffer;
+        writer->capacity = capacity;
+    }
+
+    bool        csv   = (writer->format == OUTPUT_FORMAT_CSV);
+    const char *none  = csv ? "" : "null";
+    const char *yes   = csv ? "1" : "true";
+    const char *no    = csv ? "0" : "false";
+    const char *comma = ",";
+
+    if (!csv) AppendRecordString(writer, "{\"time_ms\":");
+    AppendRecordUnsigned(writer, timeMs);
+    AppendRecordString(writer, csv ? comma : ",\"frame\":");
+    AppendRecordUnsigned(writer, (unsigned long long)frame);
+    AppendRecordString(writer, csv ? comma : ",\"pid\":");
+    AppendRecordUnsigned(writer, (unsigned long long)process->pid);
+    AppendRecordString(writer, csv ? comma : ",\"comm\":");
+    AppendRecordText(writer, process->comm);
+    AppendRecordString(writer, csv ? comma : ",\"rss_kb\":");
+    AppendRecordUnsigned(writer, process->memUsage);
+    AppendRecordString(writer, csv ? comma : ",\"growth_kb_s\":");
+    AppendRecordFixed(writer, process->memGrowth);
+    AppendRecordString(writer, csv ? comma : ",\"cpu_pct\":");
+    AppendRecordFixed(writer, process->cpuPercent);
+    AppendRecordString(writer, csv ? comma : ",\"majflt\":");
+    AppendRecordUnsigned(writer, (process->majfltDelta > 0) ? (unsigned long long)process->majfltDelta : 0);
+    AppendRecordString(writer, csv ? comma : ",\"mem_threshold_kb\":");
+    if (process->memThreshold == MH_NO_LIMIT) AppendRecordString(writer, none);
+    else AppendRecordUnsigned(writer, process->memThreshold);
+    AppendRecordString(writer, csv ? comma : ",\"cpu_threshold_pct\":");
+    if (process->cpuThreshold == MH_NO_LIMIT_CPU) AppendRecordString(writer, none);
+    else AppendRecordFixed(writer, process->cpuThreshold);
+    AppendRecordString(writer, csv ? comma : ",\"over_mem\":");
+    AppendRecordString(writer, process->overMem ? yes : no);
+    AppendRecordString(writer, csv ? comma : ",\"over_cpu\":");
+    AppendRecordString(writer, process->overCpu ? yes : no);
+    AppendRecordString(writer, csv ? ",\"" : ",\"hold\":\"");
+    AppendRecordString(writer, holdNames[process->holdAction]);
+    AppendRecordString(writer, csv ? "\"," : "\",\"thrashing\":");
+    AppendRecordString(writer, process->thrashing ? yes : no);
+    AppendRecordString(writer, csv ? comma : ",\"oom_score_adj\":");
+    if (process->oomScore.fd < 0) AppendRecordString(writer, none);
+    else AppendRecordSigned(writer, process->oomScore.current);
+    AppendRecordString(writer, csv ? comma : ",\"wss_kb\":");
+    if (!process->hasWorkingSet) AppendRecordString(writer, none);
+    else AppendRecordUnsigned(writer, process->workingSetKB);
+    AppendRecordString(writer, csv ? "\n" : "}\n");
+
+    return 0;
+}
+
+
+// One write() for the whole frame. Whatever the pipe does not take now is
+// retried by the next BeginRecordFrame().
+static void FlushRecordFrame(RecordWriter *writer)
+{
+    if ((writer->fd < 0) || (writer->length == 0)) return;
+
+    WriteRecordFrame(writer);
+}
+
+
+static void CloseRecordWriter(RecordWriter *writer)
+{
+    if (writer->fd >= 0)
+    {
+        // Last chance for a pending frame, giving a stalled reader 1s
+        struct pollfd pollFd = {.fd = writer->fd, .events = POLLOUT};
+
+        while ((writer->flushed < writer->length) && (poll(&pollFd, 1, 1000) > 0))
+        {
+            ssize_t bytesWritten = write(writer->fd, writer->buffer + writer->flushed, writer->length - writer->flushed);
+            if ((bytesWritten < 0) && (errno != EAGAIN)) break;
+            if (bytesWritten > 0) writer->flushed += (size_t)bytesWritten;
+        }
+
+        fcntl(writer->fd, F_SETFL, writer->fileFlags);
+        close(writer->fd);
+    }
+
+    MH_FREE(writer->buffer);
+
+    *writer = (RecordWriter){.fd = -1};
+}
+
+
+//-----------------------------------------------------------------------------
+// IT'S SHOWTIME                                                       ^_^
+//-----------------------------------------------------------------------------
+
+// Log output of a frame. Straight to stdout, or in `--pipeline` mode down
+// this thread's ring to the emit stage, so no stage but that one writes.
+// Longer lines than a StageRecord holds are cut.
+static void EmitLog(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    if (!tStageRing)
+    {
+        vfprintf(stdout, format, args);
+        va_end(args);
+        return;
+    }
+
+    StageRecord record = {.type = STAGE_RECORD_LOG};
+
+    int length = vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+
+    if ((length >= (int)sizeof(record.text)) && (format[strlen(format) - 1] == '\n')) record.text[sizeof(record.text) - 2] = '\n';
+
+    PushRecord(tStageRing, &record, tStageRingWaits);
+}
+
+
+// SampleField bits the frames sample: all of them with taskstats, the
+// plan's with procfs (see SelectFramePlan())
+static unsigned int GetSampledFields(void)
+{
+    if (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS) return SAMPLE_FIELD_ALL;
+
+    return GetSamplePlanFields(GetSamplePlan(memhold.context));
+}
+
+
+// Whether `config` sets cap `kind` for anyone, by default or in a rule
+static bool HasLimitCap(const Config *config, LimitCapKind kind)
+{
+    if (config->limitCaps.values[kind] != MH_NO_LIMIT) return true;
+
+    for (int i = 0; i < config->rules.ruleCount; i++)
+    {
+        const Rule *rule = &config->rules.rules[i];
+
+        if ((rule->setMask & (RULE_SET_LIMIT_AS << kind)) && (rule->limitCaps.values[kind] != MH_NO_LIMIT)) return true;
+    }
+
+    return false;
+}
+
+
+// Pick the cheapest sample plan for what the policy in `config` and the
+// flags use, e.g. statm alone for RSS-only policies read through kept-open
+// fds. Runs at startup and on every rules reload, before the frame samples.
+static void SelectFramePlan(const ProcessTable *table, const Config *config)
+{
+    static const char *fieldNames[] = {"identity", "cpu", "faults", "threads", "vsize", "rss"}; // By SampleField bit
+
+    unsigned int fields  = SAMPLE_FIELD_RSS;
+    bool         usesCpu = (config->cpuThreshold != MH_NO_LIMIT_CPU) || HasLimitCap(config, LIMIT_CAP_CPU);
+
+    for (int i = 0; (i < config->rules.ruleCount) && !usesCpu; i++)
+        if ((config->rules.rules[i].setMask & RULE_SET_CPU) && (config->rules.rules[i].cpuThreshold != MH_NO_LIMIT_CPU)) usesCpu = true;
+
+    if (!table->reader) fields |= SAMPLE_FIELD_IDENTITY; // By path only starttime tells a reused PID apart
+    if (usesCpu || memhold.flagThreads || (gRecordWriter.fd >= 0)) fields |= SAMPLE_FIELD_CPU;
+    if ((memhold.thrashThreshold != MH_NO_LIMIT_CPU) || memhold.flagThreads || (gRecordWriter.fd >= 0)) fields |= SAMPLE_FIELD_FAULTS;
+    if (HasLimitCap(config, LIMIT_CAP_AS)) fields |= SAMPLE_FIELD_VSIZE;
+
+    SamplePlan previous = GetSamplePlan(memhold.context);
+    SamplePlan plan     = SelectSamplePlan(fields);
+
+    SetSamplePlan(memhold.context, plan);
+
+    if (!memhold.flagVerbose || (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS)) return;
+    if ((plan == previous) && (config->generation > 0)) return;
+
+    char text[128] = "";
+    int  length    = 0;
+
+    for (int bit = 0; bit < (int)(sizeof(fieldNames) / sizeof(fieldNames[0])); bit++)
+    {
+        if (!(GetSamplePlanFields(plan) & (1u << bit))) continue;
+        length += snprintf(text + length, sizeof(text) - length, "%s%s", (length > 0) ? ", " : "", fieldNames[bit]);
+    }
+
+    EmitLog("[ INFO ]  Sample plan: /proc/<pid>/%s (%s)%s\n", GetSamplePlanFile(plan), text, table->reader ? ", kept-open fds" : "");
+}
+
+
+// Sample CPU, memory and faults of every tracked process and detach the ones
+// that are gone. `frameSeconds` is the time since the previous frame (0 on
+// the first one, which only primes the CPU deltas).
+static void SampleProcessTable(ProcessTable *table, TaskstatsBackend *taskstats, double frameSeconds)
+{
+    // taskstats: the whole table in one batch
+    //----------------------------------------------------------------------------------
+    if (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS)
+    {
+        pid_t      *pids    = MH_MALLOC(table->count * sizeof(pid_t));
+        int        *slots   = MH_MALLOC(table->count * sizeof(int));
+        int        *results = MH_MALLOC(table->count * sizeof(int));
+        TaskSample *samples = MH_MALLOC(table->count * sizeof(TaskSample));
+        int         count   = 0;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        unsigned long long nowUs = (unsigned long long)now.tv_sec * 1000000 + (unsigned long long)now.tv_nsec / 1000;
+
+        if (pids && slots && results && samples)
+        {
+            for (int slot = 0; slot < table->slotCount; slot++)
+            {
+                if (!table->slots[slot].used) continue;
+
+                pids[count]    = table->slots[slot].pid;
+                slots[count++] = slot;
+            }
+
+            GetTaskstatsBatch(taskstats, pids, count, samples, results);
+
+            for (int i = 0; i < count; i++)
+            {
+                Process *process = &table->slots[slots[i]];
+
+                if (results[i] == -ESRCH)
+                {
+                    if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  %s is gone\n", process->pid, process->comm);
+                    DetachProcess(table, slots[i]);
+                    continue;
+                }
+
+                if (results[i] != 0)
+                {
+                    EmitLog("[ WARN ]  taskstats query failed (%s), falling back to procfs\n", strerror(-results[i]));
+                    memhold.sampleBackend = SAMPLE_BACKEND_PROCFS;
+                    break;
+                }
+
+                // taskstats has no starttime. A task that started after our
+                // previous sample cannot be the process we sampled then.
+                if (process->sampledUs && (samples[i].elapsedUs < nowUs) && (nowUs - samples[i].elapsedUs > process->sampledUs))
+                {
+                    if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  %s is gone, PID reused\n", process->pid, process->comm);
+                    DetachProcess(table, slots[i]);
+                    continue;
+                }
+
+                process->sampledUs = nowUs;
+
+                if (process->primed && (frameSeconds > 0))
+                    process->cpuPercent = (100.0 * (samples[i].cpuRunRealNs - process->cpuTimeNs)) / 1e9 / frameSeconds;
+
+                long   memUsageKB = GetMemUsageStatm(memhold.context, process->pid); // taskstats has no current RSS
+                size_t memUsage   = (memUsageKB > 0) ? (size_t)memUsageKB : 0;
+
+                if (process->primed && (frameSeconds > 0)) process->memGrowth = ((double)memUsage - (double)process->memUsage) / frameSeconds;
+
+                process->majfltDelta = (long)(samples[i].majflt - process->lastMajflt);
+                process->lastMajflt  = (unsigned long)samples[i].majflt;
+                process->cpuTimeNs   = samples[i].cpuRunRealNs; // Scheduler clock, no clock tick rounding
+                process->taskSample  = samples[i];
+                process->memUsage    = memUsage;
+                process->vmSizeKB    = (size_t)samples[i].hiwaterVmKB; // No current VmSize in taskstats
+                process->primed      = true;
+            }
+        }
+
+        MH_FREE(pids);
+        MH_FREE(slots);
+        MH_FREE(results);
+        MH_FREE(samples);
+
+        if (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS) return;
+    }
+    //----------------------------------------------------------------------------------
+
+    // procfs: one stat read per process, through libmemhold (one io_uring batch with a reader)
+    //----------------------------------------------------------------------------------
+    pid_t         *pids    = MH_MALLOC(table->count * sizeof(pid_t));
+    int           *slots   = MH_MALLOC(table->count * sizeof(int));
+    int           *results = MH_MALLOC(table->count * sizeof(int));
+    ProcessSample *samples = MH_MALLOC(table->count * sizeof(ProcessSample));
+    int            count   = 0;
+
+    if (pids && slots && results && samples)
+    {
+        for (int slot = 0; slot < table->slotCount; slot++)
+        {
+            if (!table->slots[slot].used) continue;
+
+            pids[count]    = table->slots[slot].pid;
+            slots[count++] = slot;
+        }
+
+        if (table->reader) ReadProcStats(table->reader, slots, count, samples, results);
+        else if (memhold.samplerPool) SampleProcessesParallel(memhold.samplerPool, pids, count, samples, results);
+        else SampleProcessesTimed(memhold.context, pids, count, samples, results, &gLoopStats.sampleTimings);
+
+        unsigned int fields       = GetSamplePlanFields(GetSamplePlan(memhold.context));
+        unsigned int primedFields = fields & table->sampledFields; // A plan switch primes the fields it adds
+
+        table->sampledFields = fields;
+
+        for (int i = 0; i < count; i++)
+        {
+            Process             *process = &table->slots[slots[i]];
+            const ProcessSample *sample  = &samples[i];
+
+            if (results[i] != 0)
+            {
+                if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  %s is gone\n", process->pid, process->comm);
+                DetachProcess(table, slots[i]);
+                continue;
+            }
+
+            // `state` is only filled with the identity fields (always, for slots read by path)
+            if (sample->state && (sample->starttime != process->starttime))
+            {
+                if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  %s is gone, PID reused by %s\n", process->pid, process->comm, sample->comm);
+                DetachProcess(table, slots[i]);
+                continue;
+            }
+
+            if (process->primed && (frameSeconds > 0))
+            {
+                if (primedFields & SAMPLE_FIELD_CPU) process->cpuPercent = (100.0 * (sample->cpuTimeNs - process->cpuTimeNs)) / 1e9 / frameSeconds;
+                process->memGrowth = ((double)sample->rssKB - (double)process->memUsage) / frameSeconds;
+            }
+
+            // Fields the plan leaves out are 0 and keep their previous value
+            if (fields & SAMPLE_FIELD_FAULTS)
+            {
+                process->majfltDelta = (primedFields & SAMPLE_FIELD_FAULTS) ? (long)(sample->majflt - process->lastMajflt) : 0;
+                process->lastMajflt  = sample->majflt;
+            }
+            if (fields & SAMPLE_FIELD_CPU) process->cpuTimeNs = sample->cpuTimeNs;
+            if (fields & SAMPLE_FIELD_VSIZE) process->vmSizeKB = sample->vsizeKB;
+            process->memUsage = sample->rssKB; // Same counters as VmRSS, kernel threads have none
+            process->primed   = true;
+        }
+    }
+
+    MH_FREE(pids);
+    MH_FREE(slots);
+    MH_FREE(results);
+    MH_FREE(samples);
+    //----------------------------------------------------------------------------------
+}
+
+
+// Rank every process by RSS, growth and CPU. Returns the time it took, in seconds.
+static double RankProcessTable(ProcessTable *table)
+{
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (int slot = 0; slot < table->slotCount; slot++)
+    {
+        const Process *process = &table->slots[slot];
+
+        if (!process->used) continue;
+
+        UpdateRanking(&table->rankings[RANK_RSS], slot, (double)process->memUsage);
+        UpdateRanking(&table->rankings[RANK_GROWTH], slot, process->memGrowth);
+        UpdateRanking(&table->rankings[RANK_CPU], slot, process->cpuPercent);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - begin.tv_sec) + ((double)(end.tv_nsec - begin.tv_nsec) / 1e9);
+}
+
+
+// One `[ INFO ]  Top ...` line per ranking (`--verbose`)
+static void LogRankings(const ProcessTable *table, double rankSeconds)
+{
+    static const char *names[RANK_COUNT] = {"RSS", "growth", "CPU"};
+
+    int slots[MAX_RANK_TOP_N];
+
+    for (int key = 0; key < RANK_COUNT; key++)
+    {
+        if ((key == RANK_CPU) && !(GetSampledFields() & SAMPLE_FIELD_CPU)) continue; // All 0% under the plan
+
+        int count = GetTopRanked(&table->rankings[key], slots, memhold.topN);
+
+        EmitLog("[ INFO ]  Top %-6s:", names[key]);
+
+        for (int i = 0; i < count; i++)
+        {
+            const Process *process = &table->slots[slots[i]];
+
+            if (key == RANK_RSS) EmitLog("  %d %s %zuK", process->pid, process->comm, process->memUsage);
+            else if (key == RANK_GROWTH) EmitLog("  %d %s %+.0fK/s", process->pid, process->comm, process->memGrowth);
+            else EmitLog("  %d %s %.2f%%", process->pid, process->comm, process->cpuPercent);
+        }
+
+        EmitLog("\n");
+    }
+
+    EmitLog("[ INFO ]  Ranked %d processes in %.1fus\n", table->count, rankSeconds * 1e6);
+}
+
+
+static void LogHistogram(const char *name, const Histogram *histogram)
+{
+    fprintf(stdout, "[ INFO ]  %-9s n: %8llu  p50: %10.1fus  p99: %10.1fus  p999: %10.1fus  max: %10.1fus\n", name, histogram->totalCount,
+            GetHistogramPercentile(histogram, 50.0) / 1e3, GetHistogramPercentile(histogram, 99.0) / 1e3,
+            GetHistogramPercentile(histogram, 99.9) / 1e3, histogram->maxValue / 1e3);
+}
+
+
+// Depth and stall times of one pipeline ring (`--pipeline`)
+static void LogRecordRingStats(const char *name, RecordRing *ring)
+{
+    RecordRingStats stats;
+    GetRecordRingStats(ring, &stats);
+
+    fprintf(stdout, "[ INFO ]  %-17s depth: %4d/%d  max: %4d  producer stalled: %9.1fms  consumer waited: %9.1fms  dropped: %llu\n", name, stats.depth,
+            stats.capacity, stats.maxDepth, stats.pushStallNs / 1e6, stats.popWaitNs / 1e6, stats.dropCount);
+}
+
+
+// Tail latencies so far (on exit, and on SIGUSR1). Per-thread histograms are
+// merged here, between frames. Mid-run in `--pipeline` mode `table` is NULL:
+// the sample and emit stages are still writing their counters then, so those
+// wait for exit.
+static void LogStats(const ProcessTable *table, Pipeline *pipeline)
+{
+    const Process *slots     = pipeline ? pipeline->slots : (table ? table->slots : NULL);
+    int            slotCount = pipeline ? pipeline->slotCapacity : (table ? table->slotCount : 0);
+
+    SampleTimings *timings = MH_CALLOC(1, sizeof(SampleTimings));
+
+    if (!timings) return;
+
+    fprintf(stdout, "[ INFO ]  Stats: latency\n");
+
+    if (table)
+    {
+        MergeHistogram(&timings->readNs, &gLoopStats.sampleTimings.readNs);
+        MergeHistogram(&timings->parseNs, &gLoopStats.sampleTimings.parseNs);
+        if (memhold.samplerPool) GetSamplerPoolTimings(memhold.samplerPool, timings);
+        if (table->reader) GetProcReaderTimings(table->reader, timings);
+
+        LogHistogram("read", &timings->readNs);
+        LogHistogram("parse", &timings->parseNs);
+    }
+
+    LogHistogram("frame", &gLoopStats.frameNs);
+    if (table) LogHistogram("lateness", &gLoopStats.latenessNs);
+    LogHistogram("action", &gLoopStats.actionNs);
+
+    if ((gLoopStats.oomWrites + gLoopStats.oomSkipped) > 0)
+        fprintf(stdout, "[ INFO ]  oom_score_adj: %llu writes, %llu changes under hysteresis skipped\n", gLoopStats.oomWrites, gLoopStats.oomSkipped);
+
+    if (gLoopStats.limitWrites > 0)
+    {
+        fprintf(stdout, "[ INFO ]  Stats: limits (%llu prlimit writes)\n", gLoopStats.limitWrites);
+
+        for (int slot = 0; slot < slotCount; slot++)
+        {
+            const Process *process = &slots[slot];
+
+            if (!process->used) continue;
+
+            for (int kind = 0; kind < LIMIT_CAP_COUNT; kind++)
+            {
+                int  resource = gLimitCapResources[kind];
+                char current[32], applied[32];
+
+                if (process->appliedCaps.values[kind] == MH_NO_LIMIT) continue;
+
+                FormatProcLimit(process->replacedSoft[kind], current, sizeof(current));
+                FormatProcLimit(process->appliedSoft[kind], applied, sizeof(applied));
+
+                fprintf(stdout, "[ INFO ]  PID: %d  %s  %-21s %s -> %s\n", process->pid, process->comm, GetProcLimitName(resource), current, applied);
+            }
+        }
+    }
+
+    if (table && (gRecordWriter.format != OUTPUT_FORMAT_TEXT))
+        fprintf(stdout, "[ INFO ]  Records: %llu frames written, %llu dropped\n", gRecordWriter.writtenFrames, gRecordWriter.droppedFrames);
+
+    if (pipeline && pipeline->sampleRing)
+    {
+        fprintf(stdout, "[ INFO ]  Stats: pipeline\n");
+        LogRecordRingStats("sample -> enforce", pipeline->sampleRing);
+        LogRecordRingStats("enforce -> emit", pipeline->emitRing);
+        fprintf(stdout, "[ INFO ]  emit busy: %.1fms\n", atomic_load(&pipeline->emitBusyNs) / 1e6);
+    }
+
+    MH_FREE(timings);
+}
+
+
+static void HandleStopSignal(int signum) { gStopRequested = 1; }
+
+
+static void HandleStatsSignal(int signum) { gStatsRequested = 1; }
+
+
+// Thresholds and holds of one process for this frame, from its sampled
+// state alone: no I/O, no logging. RunMain() and `memhold simulate` both
+// decide through here, so a simulated policy is the live one.
+static Decision DecideProcess(const Process *process)
+{
+    size_t memKB = process->hasWorkingSet ? process->workingSetKB : process->memUsage;
+
+    Decision decision = {
+        .overMem = (process->memThreshold != MH_NO_LIMIT) && (memKB > process->memThreshold),
+        .overCpu = (process->cpuThreshold != MH_NO_LIMIT_CPU) && (process->cpuPercent > process->cpuThreshold),
+    };
+
+    // Over by RSS with a working set estimate pending: the hold waits for what it actually uses
+    bool memTriggered = decision.overMem && !process->workingSetPending;
+
+    bool triggered = ((process->holdTriggers & HOLD_TRIGGER_MEM) && memTriggered) ||
+                     ((process->holdTriggers & HOLD_TRIGGER_THRASH) && process->thrashing);
+
+    decision.hold = triggered && (process->holdAction != HOLD_ACTION_NONE);
+
+    return decision;
+}
+
+
+// Warn once when a process crosses its thresholds, and once when it is back under.
+static Decision CheckThresholds(Process *process)
+{
+    Decision decision = DecideProcess(process);
+    bool     overMem  = decision.overMem;
+    bool     overCpu  = decision.overCpu;
+
+    const char *memName = process->hasWorkingSet ? "WSS" : "MEM";
+    size_t      memKB   = process->hasWorkingSet ? process->workingSetKB : process->memUsage;
+
+    if (overMem && !process->overMem)
+        EmitLog("[ WARN ]  PID: %d  %s  %s: %zuK over threshold %zuK\n", process->pid, process->comm, memName, memKB, process->memThreshold);
+    else if (!overMem && process->overMem && memhold.flagVerbose)
+        EmitLog("[ INFO ]  PID: %d  %s  %s: %zuK back under threshold\n", process->pid, process->comm, memName, memKB);
+
+    if (overCpu && !process->overCpu)
+        EmitLog("[ WARN ]  PID: %d  %s  CPU: %.2f%% over threshold %.2f%%\n", process->pid, process->comm, process->cpuPercent, process->cpuThreshold);
+    else if (!overCpu && process->overCpu && memhold.flagVerbose)
+        EmitLog("[ INFO ]  PID: %d  %s  CPU: %.2f%% back under threshold\n", process->pid, process->comm, process->cpuPercent);
+
+    process->overMem = overMem;
+    process->overCpu = overCpu;
+
+    return decision;
+}
+
+
+// Estimate the working set of a process over its memory threshold by RSS
+// (`--wss`), so the threshold applies to what it uses rather than to what
+// it still has resident. Its pages are marked idle, and counted one
+// interval later. Anything under the threshold by RSS costs nothing.
+// Returns -1 when idle page tracking fails in a way that fails for every
+// process (e.g. no CAP_SYS_ADMIN), 0 otherwise.
+static int UpdateWorkingSet(Process *process)
+{
+    WorkingSet *workingSet = &process->workingSet;
+
+    if ((process->memThreshold == MH_NO_LIMIT) || (process->memUsage <= process->memThreshold))
+    {
+        if (workingSet->pagemapFd >= 0) CloseWorkingSet(workingSet);
+        process->hasWorkingSet     = false;
+        process->workingSetPending = false;
+        return 0;
+    }
+
+    unsigned long long nowNs = GetMonotonicNs();
+
+    if (workingSet->pagemapFd < 0)
+    {
+        if (OpenWorkingSet(workingSet, process->pid) != 0) return 0; // Gone
+    }
+    else if ((nowNs - process->workingSetNs) < (unsigned long long)(memhold.workingSetSeconds * 1e9)) return 0;
+
+    WorkingSetStats stats;
+    int             status = SampleWorkingSet(workingSet, process->pid, &stats);
+
+    if (status < 0)
+    {
+        CloseWorkingSet(workingSet);
+        process->hasWorkingSet     = false;
+        process->workingSetPending = false;
+
+        if ((status == -ENOENT) || (status == -ESRCH)) return 0;
+
+        EmitLog("[ WARN ]  PID: %d  %s  working set: %s, thresholds stay on RSS\n", process->pid, process->comm, strerror(-status));
+        return -1;
+    }
+
+    process->workingSetPending = (status == 0) && !process->hasWorkingSet; // First pass only marks pages idle
+
+    if (status == 1)
+    {
+        process->workingSetKB  = stats.activeKB;
+        process->hasWorkingSet = true;
+
+        if (memhold.flagVerbose)
+            EmitLog("[ INFO ]  PID: %d  %s  working set: %zuK of %zuK resident over %.1fs (%d runs, %d syscalls, %.2fms)\n", process->pid,
+                    process->comm, stats.activeKB, stats.residentKB, (nowNs - process->workingSetNs) / 1e9, stats.runCount, stats.syscallCount,
+                    stats.seconds * 1e3);
+    }
+
+    process->workingSetNs = nowNs;
+
+    return 0;
+}
+
+
+// Blame host thrashing (`--thrash`) on the processes taking major faults
+// through it. Their RSS can look flat while they page back in what the host
+// keeps evicting. Warns once per episode, like CheckThresholds().
+static void CheckThrashing(Process *process, bool hostThrashing, unsigned long long hostMajfaults)
+{
+    bool thrashing = hostThrashing && (process->majfltDelta >= memhold.faultThreshold);
+
+    if (thrashing && !process->thrashing)
+        EmitLog("[ WARN ]  PID: %d  %s  thrashing: majflt +%ld (%.0f%% of host)\n", process->pid, process->comm, process->majfltDelta,
+                (hostMajfaults > 0) ? (100.0 * (double)process->majfltDelta / (double)hostMajfaults) : 0.0);
+    else if (!thrashing && process->thrashing && memhold.flagVerbose)
+        EmitLog("[ INFO ]  PID: %d  %s  no longer thrashing\n", process->pid, process->comm);
+
+    process->thrashing = thrashing;
+}
+
+
+// oom_score_adj `process` should have under its policy. A steered process
+// goes up while it is over its memory threshold and growing (200 above its
+// own value at the threshold, the most at twice it), keeps it while flat, and
+// gets its own value back once under.
+static int GetOomTarget(const Process *process)
+{
+    const OomScore *score = &process->oomScore;
+
+    if (process->oomPolicy == OOM_POLICY_PROTECT) return (score->original < MH_OOM_PROTECT_ADJ) ? score->original : MH_OOM_PROTECT_ADJ;
+    if ((process->oomPolicy != OOM_POLICY_STEER) || !process->overMem) return score->original;
+    if (process->memGrowth <= 0) return score->current;
+
+    double excess = ((double)process->memUsage - (double)process->memThreshold) / (double)process->memThreshold;
+    int    target = score->original + 200 + (int)(800.0 * ((excess < 1.0) ? excess : 1.0));
+
+    if (target > 1000) target = 1000;
+
+    return (target > score->current) ? target : score->current;
+}
+
+
+// Move the oom_score_adj of `process` toward its target, so when memhold is
+// too slow the OOM killer takes the hog and spares protected processes. The
+// fd stays open, so a change is one pwrite(). Changes under MH_OOM_HYSTERESIS
+// are skipped, except the one back to the original value.
+static void SteerOomScore(Process *process)
+{
+    OomScore *score = &process->oomScore;
+
+    if (process->oomPolicy == OOM_POLICY_NONE)
+    {
+        if (score->fd >= 0) CloseOomScore(score, true); // Rules changed
+        return;
+    }
+
+    if (score->fd < 0)
+    {
+        if ((process->oomPolicy == OOM_POLICY_STEER) && !process->overMem) return; // Nothing to change yet
+
+        int status = OpenOomScore(score, process->pid);
+        if (status != 0)
+        {
+            if (status != -ENOENT) EmitLog("[ WARN ]  PID: %d  %s  oom_score_adj unavailable: %s\n", process->pid, process->comm, strerror(-status));
+            process->oomPolicy = OOM_POLICY_NONE; // Until rules are reloaded
+            return;
+        }
+    }
+
+    int target = GetOomTarget(process);
+    int change = abs(target - score->current);
+
+    if (change == 0) return;
+
+    if ((change < MH_OOM_HYSTERESIS) && (target != score->original))
+    {
+        gLoopStats.oomSkipped += 1;
+        return;
+    }
+
+    int previous = score->current;
+    int status   = SetOomScore(score, target);
+
+    if (status != 0)
+    {
+        // Lowering it takes CAP_SYS_RESOURCE
+        if (status != -ESRCH)
+            EmitLog("[ WARN ]  PID: %d  %s  oom_score_adj: %d -> %d failed: %s\n", process->pid, process->comm, previous, target, strerror(-status));
+        process->oomPolicy = OOM_POLICY_NONE;
+        return;
+    }
+
+    gLoopStats.oomWrites += 1;
+
+    if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  %s  oom_score_adj: %d -> %d\n", process->pid, process->comm, previous, target);
+}
+
+
+// Cap limits of `process` with prlimit(2) (`as=`, `data=`, `cputime=`), so the
+// kernel refuses the runaway allocation itself and memhold only watches. One
+// call per change, never per frame. Only the soft limit is lowered, under the
+// process's own, with the hard limit as the process has it now. `none` in
+// rules puts the replaced one back, and RestoreLimitCaps() on memhold exit.
+static void ApplyLimitCaps(Process *process)
+{
+    for (int kind = 0; kind < LIMIT_CAP_COUNT; kind++)
+    {
+        int    resource = gLimitCapResources[kind];
+        size_t cap      = process->limitCaps.values[kind];
+
+        if (!(process->limits.found & (1u << resource))) continue;
+
+        if (cap != process->appliedCaps.values[kind])
+        {
+            // Never above the soft limit the process had before its first cap, which `none` puts back
+            bool               capped = (process->appliedCaps.values[kind] != MH_NO_LIMIT);
+            unsigned long long base   = capped ? process->replacedSoft[kind] : MH_LIMIT_UNLIMITED;
+            unsigned long long soft   = base;
+            unsigned long long replaced;
+
+            if (!capped)
+            {
+                struct rlimit current;
+
+                if ((prlimit(process->pid, resource, NULL, &current) == 0) && (current.rlim_cur != RLIM_INFINITY)) base = (unsigned long long)current.rlim_cur;
+            }
+
+            if (cap != MH_NO_LIMIT) soft = ((unsigned long long)cap * gLimitCapScales[kind] < base) ? (unsigned long long)cap * gLimitCapScales[kind] : base;
+
+            int status = SetProcSoftLimit(process->pid, resource, soft, &replaced);
+            if (status != 0)
+            {
+                // Raising it back past a lowered soft limit never fails, so this is a first cap
+                if (status != -ESRCH)
+                    EmitLog("[ WARN ]  PID: %d  %s  %s=%zu%s failed: %s\n", process->pid, process->comm, gLimitCapNames[kind], cap, (kind == LIMIT_CAP_CPU) ? "s" : "K", strerror(-status));
+                process->limitCaps.values[kind] = MH_NO_LIMIT; // Until rules are reloaded
+                continue;
+            }
+
+            if (!capped) process->replacedSoft[kind] = replaced;
+
+            gLoopStats.limitWrites             += 1;
+            process->appliedCaps.values[kind]   = cap;
+            process->appliedSoft[kind]          = soft;
+            process->capsNear                  &= ~(1u << kind);
+
+            if (memhold.flagVerbose)
+            {
+                char text[32];
+                FormatProcLimit(soft, text, sizeof(text));
+                EmitLog("[ INFO ]  PID: %d  %s  %s: soft limit %s\n", process->pid, process->comm, GetProcLimitName(resource), text);
+            }
+        }
+
+        if (cap == MH_NO_LIMIT) continue;
+
+        // The kernel enforces RLIMIT_DATA without a cheap usage to compare against, so it is not watched
+        unsigned long long usage = 0;
+        if (kind == LIMIT_CAP_AS) usage = process->vmSizeKB;
+        else if (kind == LIMIT_CAP_CPU) usage = process->cpuTimeNs / 1000000000ULL;
+        else continue;
+
+        bool near = (usage * 100) >= ((unsigned long long)cap * LIMIT_CAP_NEAR_PERCENT);
+
+        if (near && !(process->capsNear & (1u << kind)))
+            EmitLog("[ WARN ]  PID: %d  %s  near its %s cap: %llu%s of %zu%s\n", process->pid, process->comm, gLimitCapNames[kind], usage,
+                    (kind == LIMIT_CAP_CPU) ? "s" : "K", cap, (kind == LIMIT_CAP_CPU) ? "s" : "K");
+
+        if (near) process->capsNear |= (1u << kind);
+        else process->capsNear &= ~(1u << kind);
+    }
+}
+
+
+// Soft hold a process over its memory threshold (`action=cold|pageout`).
+// Runs every frame it stays over, `reclaimLimit` at a time.
+static void SoftHoldProcess(Process *process)
+{
+    ReclaimStats stats;
+
+    int    advice     = (process->holdAction == HOLD_ACTION_PAGEOUT) ? MADV_PAGEOUT : MADV_COLD;
+    size_t limitBytes = (process->reclaimLimit == MH_NO_LIMIT) ? MH_NO_LIMIT : (process->reclaimLimit * 1024);
+
+    if (ReclaimProcessMemory(&process->reclaimer, process->pid, advice, limitBytes, &stats) != 0)
+    {
+        EmitLog("[ WARN ]  PID: %d  %s  soft hold failed: %s\n", process->pid, process->comm, strerror(errno));
+        process->holdAction = HOLD_ACTION_NONE; // Until rules are reloaded
+        return;
+    }
+
+    const unsigned int fieldMask = STATUS_VM_RSS | STATUS_RSS_ANON | STATUS_VM_SWAP;
+    ProcStatus         status    = {0};
+
+    char after[128] = ""; // Gone since the madvise, or no such lines (no swap): the advice alone
+
+    if ((GetProcStatus(process->pid, fieldMask, &status) > 0) && ((status.found & fieldMask) == fieldMask))
+        snprintf(after, sizeof(after), " -> %zuK (anon: %zuK, swap: %zuK)", status.vmRssKB, status.rssAnonKB, status.vmSwapKB);
+
+    EmitLog("[ INFO ]  PID: %d  %s  %s: %zuK advised in %d regions (%d calls, %.2fms%s)  MEM: %zuK%s\n", process->pid, process->comm,
+            (advice == MADV_PAGEOUT) ? "pageout" : "cold", stats.bytesAdvised / 1024, stats.regionCount, stats.callCount, stats.seconds * 1e3,
+            stats.passDone ? "" : ", capped", process->memUsage, after);
+}
+
+
+// Find the hot thread (`--threads`)
+// NOTE: Per-thread fds are only held while the process is over the CPU or
+// fault threshold, so a quiet process costs nothing extra.
+static void SampleHotThreads(Process *process)
+{
+    ThreadSample   topThreads[MAX_THREAD_TOP_K];
+    ThreadSampler *threadSampler = &process->threadSampler;
+
+    bool isHot = (process->cpuPercent >= process->cpuThreshold) || (process->majfltDelta >= memhold.faultThreshold);
+
+    if (isHot && !threadSampler->active)
+    {
+        if (InitThreadSampler(threadSampler, process->pid) == 0 && memhold.flagVerbose)
+            EmitLog("[ INFO ]  PID: %d  hot (majflt: +%ld), sampling threads\n", process->pid, process->majfltDelta);
+    }
+    else if (!isHot && threadSampler->active)
+    {
+        UnloadThreadSampler(threadSampler);
+        if (memhold.flagVerbose) EmitLog("[ INFO ]  PID: %d  cooled down, stopped sampling threads\n", process->pid);
+    }
+
+    if (threadSampler->active && (SampleThreads(threadSampler) > 0) && (threadSampler->sampleSeconds > 0))
+    {
+        int topCount = GetTopThreads(threadSampler, topThreads, memhold.threadTopK);
+
+        for (int i = 0; i < topCount; i++)
+        {
+            const ThreadSample *thread    = &topThreads[i];
+            double              threadCpu = (100.0 * thread->cpuDelta) / memhold.clockTicks / threadSampler->sampleSeconds;
+
+            EmitLog("[ INFO ]  PID: %d  TID: %-7d %-16s CPU: %6.2f%%  minflt: +%lu  majflt: +%lu\n", process->pid, thread->tid, thread->comm,
+                    threadCpu, thread->minfltDelta, thread->majfltDelta);
+        }
+    }
+}
+
+
+// Drain taskstats exit records, log the final accounting of tracked processes
+// and detach them.
+static void ReportTaskstatsExits(TaskstatsBackend *ts, ProcessTable *table)
+{
+    TaskSample exitSamples[MH_TASKSTATS_BATCH];
+
+    int exitCount = PollTaskstatsExit(ts, exitSamples, MH_TASKSTATS_BATCH);
+
+    for (int i = 0; i < exitCount; i++)
+    {
+        int slot = FindProcess(table, exitSamples[i].pid);
+        if (slot < 0) continue;
+
+        EmitLog("[ INFO ]  PID: %d  %s exited. cpu: %.2fs  HWM: %lluK  swapin delay: %llums  reclaim delay: %llums\n", exitSamples[i].pid,
+                table->slots[slot].comm, exitSamples[i].cpuRunRealNs / 1e9, exitSamples[i].hiwaterRssKB, exitSamples[i].swapinDelayNs / 1000000,
+                exitSamples[i].reclaimDelayNs / 1000000);
+
+        DetachProcess(table, slot);
+    }
+}
+
+// The sample stage of one frame: pick up a reloaded Config, attach new
+// processes (`--all`), sample, rank and log. Returns false when monitoring
+// is over.
+static bool SampleFrame(FrameSampler *sampler, FrameInfo *info, unsigned long long *timeMs)
+{
+    ProcessTable *table = &sampler->table;
+
+    // Pick up a reloaded Config. Snapshots from the previous frame are dead.
+    ConfigQuiescentState(sampler->configReader);
+    const Config *config = AcquireConfig();
+
+    if (config->generation != sampler->appliedGeneration)
+    {
+        for (int slot = 0; slot < table->slotCount; slot++)
+            if (table->slots[slot].used) ApplyRules(&table->slots[slot], config);
+
+        sampler->appliedGeneration = config->generation;
+
+        if (memhold.flagLog)
+            EmitLog("[ INFO ]  Rules: %s reloaded (%d rules, generation %u)\n", memhold.rulesFileName, config->rules.ruleCount, config->generation);
+
+        SelectFramePlan(table, config);
+    }
+
+#if 1 /* <<<<<<<<<<< Remove this after prototyping >>>>>>>>>> */
+
+    if (sampler->frame >= MAX_HOT_LOOP_COUNT)
+    {
+        EmitLog("[ WARN ]  *break* main loop on iteration: %d\n", sampler->frame);
+        return false;
+    };
+
+    sampler->frame += 1;
+
+#endif
+
+    if (memhold.flagAll)
+    {
+        int attachedCount = DiscoverProcesses(table, config);
+        if (memhold.flagVerbose && (attachedCount > 0)) EmitLog("[ INFO ]  attached %d new processes\n", attachedCount);
+    }
+
+    struct timespec frameTime;
+    clock_gettime(CLOCK_MONOTONIC, &frameTime);
+
+    info->frameSeconds = (sampler->lastFrameTime.tv_sec == 0) ? 0.0
+                                                               : (double)(frameTime.tv_sec - sampler->lastFrameTime.tv_sec) +
+                                                                     ((double)(frameTime.tv_nsec - sampler->lastFrameTime.tv_nsec) / 1e9);
+    sampler->lastFrameTime = frameTime;
+
+    info->frameBeginNs = GetMonotonicNs();
+
+    SampleProcessTable(table, &sampler->taskstats, info->frameSeconds);
+
+    // Exit records arrive in batch for every task on the listened CPUs
+    if (sampler->taskstats.exitFd >= 0) ReportTaskstatsExits(&sampler->taskstats, table);
+
+    if (!memhold.flagAll && (table->count == 0))
+    {
+        EmitLog("[ INFO ]  no processes left to monitor\n");
+        return false;
+    }
+
+    double rankSeconds = RankProcessTable(table);
+
+    if (memhold.flagVerbose)
+    {
+        long systemUptime = GetSystemUptimeSec(memhold.memholdMainProcessPID);
+        EmitLog("[ INFO ]  Uptime: %lds  Processes: %d\n", systemUptime, table->count);
+
+        if (info->frameSeconds > 0) LogRankings(table, rankSeconds);
+    }
+
+    info->slotCount   = table->slotCount;
+    info->topRssCount = (memhold.pressureThreshold != MH_NO_LIMIT_CPU) ? GetTopRanked(&table->rankings[RANK_RSS], info->topRss, MAX_RANK_TOP_N) : 0;
+
+    struct timespec wallTime;
+    clock_gettime(CLOCK_REALTIME, &wallTime);
+
+    *timeMs = ((unsigned long long)wallTime.tv_sec * 1000) + ((unsigned long long)wallTime.tv_nsec / 1000000);
+
+    return true;
+}
+
+
+// One record of the current frame: into gRecordWriter, or in `--pipeline`
+// mode to the emit stage (dropped when its ring is full).
+static void EmitProcessRecord(const Process *process, int frame, unsigned long long timeMs)
+{
+    if (!tStageRing)
+    {
+        AppendProcessRecord(&gRecordWriter, process, frame, timeMs);
+        return;
+    }
+
+    StageRecord record = {.type = STAGE_RECORD_PROCESS, .frame = frame, .timeMs = timeMs, .process = *process};
+
+    PushRecord(tStageRing, &record, false);
+}
+
+
+// The evaluate/enforce stage of one frame: host thrashing and holds under
+// pressure, then thresholds, holds, oom_score_adj and records per process.
+// `slots` are the sample stage's own, or with `--pipeline` this stage's
+// copies of them. The first frame only primes CPU deltas.
+static void EnforceFrame(Enforcer *enforcer, Process *slots, const FrameInfo *info, int frame, unsigned long long timeMs, bool emitRecords)
+{
+    double frameSeconds = info->frameSeconds;
+
+    // Host thrashing: pages swapped in, or faulted back in soon after
+    // eviction, faster than `--thrash` per second
+    //----------------------------------------------------------------------------------
+    unsigned long long hostMajfaults = 0; // This frame
+    VmStat             vmStat;
+
+    if ((enforcer->vmStatFd >= 0) && (GetVmStat(enforcer->vmStatFd, &vmStat) == 0))
+    {
+        if (enforcer->vmStatPrimed && (frameSeconds > 0))
+        {
+            unsigned long long swapIns   = vmStat.pswpin - enforcer->lastVmStat.pswpin;
+            unsigned long long swapOuts  = vmStat.pswpout - enforcer->lastVmStat.pswpout;
+            unsigned long long refaults  = vmStat.workingsetRefault - enforcer->lastVmStat.workingsetRefault;
+            double             pageRate  = (double)(swapIns + refaults) / frameSeconds;
+            bool               thrashing = (pageRate >= memhold.thrashThreshold);
+
+            hostMajfaults = vmStat.pgmajfault - enforcer->lastVmStat.pgmajfault;
+
+            if (thrashing && !enforcer->hostThrashing)
+                EmitLog("[ WARN ]  Thrashing: %.0f pages/s in (swap in: %llu  out: %llu  refault: %llu  majflt: %llu)\n", pageRate, swapIns, swapOuts,
+                        refaults, hostMajfaults);
+            else if (!thrashing && enforcer->hostThrashing && memhold.flagVerbose)
+                EmitLog("[ INFO ]  Thrashing stopped: %.0f pages/s in\n", pageRate);
+
+            enforcer->hostThrashing = thrashing;
+        }
+
+        enforcer->lastVmStat   = vmStat;
+        enforcer->vmStatPrimed = true;
+    }
+    //----------------------------------------------------------------------------------
+
+    // Under host memory pressure, hold first the process with the most RSS
+    // among those due a hold anyway. Pressure orders holds, it adds none.
+    //----------------------------------------------------------------------------------
+    float pressure  = 0.0f;
+    int   firstHeld = -1;
+
+    if ((enforcer->pressureFd >= 0) && (frameSeconds > 0) && (GetMemoryPressure(enforcer->pressureFd, &pressure) == 0) &&
+        (pressure >= memhold.pressureThreshold))
+    {
+        for (int i = 0; (i < info->topRssCount) && (firstHeld < 0); i++)
+            if (slots[info->topRss[i]].used && DecideProcess(&slots[info->topRss[i]]).hold) firstHeld = info->topRss[i];
+
+        if (firstHeld >= 0)
+        {
+            Process *process = &slots[firstHeld];
+
+            EmitLog("[ WARN ]  Memory pressure: %.2f%%  holding PID: %d  %s (%zuK) first\n", pressure, process->pid, process->comm, process->memUsage);
+            SoftHoldProcess(process);
+            RecordHistogram(&gLoopStats.actionNs, GetMonotonicNs() - info->frameBeginNs);
+        }
+    }
+    //----------------------------------------------------------------------------------
+
+    // Check thresholds
+    //----------------------------------------------------------------------------------
+    for (int slot = 0; (slot < info->slotCount) && (frameSeconds > 0); slot++)
+    {
+        Process *process = &slots[slot];
+
+        if (!process->used) continue;
+
+        if ((memhold.workingSetSeconds > 0) && (UpdateWorkingSet(process) != 0))
+        {
+            // Off for every process: none may keep a frozen estimate or its fds
+            for (int other = 0; other < info->slotCount; other++)
+            {
+                Process *stale = &slots[other];
+
+                if (stale->used && (stale->workingSet.pagemapFd >= 0)) CloseWorkingSet(&stale->workingSet);
+                stale->hasWorkingSet     = false;
+                stale->workingSetPending = false;
+            }
+
+            memhold.workingSetSeconds = 0;
+        }
+        if (enforcer->vmStatFd >= 0) CheckThrashing(process, enforcer->hostThrashing, hostMajfaults);
+
+        Decision decision = CheckThresholds(process);
+
+        if (decision.hold && (slot != firstHeld))
+        {
+            SoftHoldProcess(process);
+            RecordHistogram(&gLoopStats.actionNs, GetMonotonicNs() - info->frameBeginNs);
+        }
+
+        // With `--all` only processes over a threshold are worth a line
+        if (memhold.flagVerbose && (!memhold.flagAll || process->overMem || process->overCpu))
+        {
+            EmitLog("[ INFO ]  PID: %d  CPU: %6.2f%%  \t%ld\n", process->pid, process->cpuPercent, clock());
+            EmitLog("[ INFO ]  PID: %d  MEM: %8zuK  \t%ld\n", process->pid, process->memUsage, clock());
+
+            if (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS)
+            {
+                const TaskSample *taskSample = &process->taskSample;
+
+                EmitLog("[ INFO ]  PID: %d  HWM: %8lluK  delay (ms) cpu: %llu  blkio: %llu  swapin: %llu  reclaim: %llu  thrashing: %llu\n", process->pid,
+                        taskSample->hiwaterRssKB, taskSample->cpuDelayNs / 1000000, taskSample->blkioDelayNs / 1000000, taskSample->swapinDelayNs / 1000000,
+                        taskSample->reclaimDelayNs / 1000000, taskSample->thrashingDelayNs / 1000000);
+            }
+        }
+
+        if (memhold.flagThreads) SampleHotThreads(process);
+
+        SteerOomScore(process);
+        ApplyLimitCaps(process);
+
+        if (emitRecords) EmitProcessRecord(process, frame, timeMs);
+    }
+    //----------------------------------------------------------------------------------
+}
+
+
+// Pause between frames (2s by default), recording how late the sleep ended.
+// Reloads need not wait for it.
+static void PaceFrame(FrameSampler *sampler)
+{
+    ConfigReaderOffline(sampler->configReader);
+
+    unsigned long long sleepNs      = (unsigned long long)(memhold.refreshSeconds * 1e9);
+    unsigned long long sleepBeginNs = GetMonotonicNs();
+
+    if (usleep((useconds_t)(sleepNs / 1000)) == 0)
+    {
+        unsigned long long sleptNs = GetMonotonicNs() - sleepBeginNs;
+        RecordHistogram(&gLoopStats.latenessNs, (sleptNs > sleepNs) ? (sleptNs - sleepNs) : 0);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+// Pipelined frames (`--pipeline`)
+//-----------------------------------------------------------------------------
+//
+// The sample stage owns the ProcessTable and sends a copy of every process
+// down the sample ring each frame. Evaluate/enforce keeps its own copies by
+// slot: sampled fields are taken every frame, resolved rules only when the
+// Config generation changed, and what enforcement opened (pidfd, oom_score_adj,
+// working set, thread fds) and its edge states stay with it. A slot not sent
+// in a frame, or sent with another (pid, starttime), is released.
+
+// Grow the evaluate stage's copies to `count` slots. Returns -1 when out of memory.
+static int ReservePipelineSlots(Pipeline *pipeline, int count)
+{
+    if (count <= pipeline->slotCapacity) return 0;
+
+    int capacity = (pipeline->slotCapacity > 0) ? pipeline->slotCapacity : 64;
+    while (capacity < count) capacity *= 2;
+
+    Process *slots      = MH_REALLOC(pipeline->slots, capacity * sizeof(Process));
+    if (slots) pipeline->slots = slots;
+    int     *slotFrames = MH_REALLOC(pipeline->slotFrames, capacity * sizeof(int));
+    if (slotFrames) pipeline->slotFrames = slotFrames;
+
+    if (!slots || !slotFrames) return -1;
+
+    memset(&pipeline->slots[pipeline->slotCapacity], 0, (capacity - pipeline->slotCapacity) * sizeof(Process));
+    memset(&pipeline->slotFrames[pipeline->slotCapacity], 0, (capacity - pipeline->slotCapacity) * sizeof(int));
+    pipeline->slotCapacity = capacity;
+
+    return 0;
+}
+
+
+// Take the sample stage's copy of a process into this stage's slot.
+static void MergeSampledProcess(Process *process, const Process *sampled, bool applyRules)
+{
+    if (!process->used || (process->pid != sampled->pid) || (process->starttime != sampled->starttime))
+    {
+        if (process->used) ReleaseProcess(process, false); // PID reused
+
+        *process = *sampled; // Holds nothing open: the sample stage never enforces
+        return;
+    }
+
+    memcpy(process->comm, sampled->comm, sizeof(process->comm));
+    process->sampledUs   = sampled->sampledUs;
+    process->primed      = sampled->primed;
+    process->cpuTimeNs   = sampled->cpuTimeNs;
+    process->cpuPercent  = sampled->cpuPercent;
+    process->memUsage    = sampled->memUsage;
+    process->vmSizeKB    = sampled->vmSizeKB;
+    process->memGrowth   = sampled->memGrowth;
+    process->lastMajflt  = sampled->lastMajflt;
+    process->majfltDelta = sampled->majfltDelta;
+    process->taskSample  = sampled->taskSample;
+
+    // Otherwise keep what enforcement turned off "until rules are reloaded"
+    if (applyRules)
+    {
+        process->ruleIndex    = sampled->ruleIndex;
+        process->memThreshold = sampled->memThreshold;
+        process->cpuThreshold = sampled->cpuThreshold;
+        process->holdAction   = sampled->holdAction;
+        process->reclaimLimit = sampled->reclaimLimit;
+        process->holdTriggers = sampled->holdTriggers;
+        process->oomPolicy    = sampled->oomPolicy;
+        process->limitCaps    = sampled->limitCaps;
+    }
+}
+
+
+// BeginRecordFrame() that waits out a stalled reader instead of dropping the
+// frame. Only the emit stage may wait, and not once a stop was requested.
+static bool WaitRecordFrame(RecordWriter *writer)
+{
+    struct pollfd pollFd = {.fd = writer->fd, .events = POLLOUT};
+
+    while ((writer->fd >= 0) && (writer->flushed < writer->length) && !gStopRequested)
+    {
+        if (poll(&pollFd, 1, EMIT_POLL_MS) <= 0) continue;
+
+        WriteRecordFrame(writer);
+    }
+
+    return BeginRecordFrame(writer);
+}
+
+
+// Sample stage: frames go down the sample ring, one record per process and
+// a STAGE_RECORD_FRAME after them, waiting for room. The only thread that
+// takes SIGINT, SIGTERM and SIGUSR1, so they cut its sleep short.
+static void *SampleStageThread(void *arg)
+{
+    Pipeline     *pipeline = arg;
+    FrameSampler *sampler  = pipeline->sampler;
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+
+    tStageRing      = pipeline->sampleRing;
+    tStageRingWaits = true;
+
+    StageRecord *record = MH_MALLOC(sizeof(StageRecord));
+
+    while (record && !gStopRequested)
+    {
+        FrameInfo          info   = {0};
+        unsigned long long timeMs = 0;
+
+        if (!SampleFrame(sampler, &info, &timeMs)) break;
+
+        for (int slot = 0; slot < sampler->table.slotCount; slot++)
+        {
+            if (!sampler->table.slots[slot].used) continue;
+
+            record->type       = STAGE_RECORD_PROCESS;
+            record->slot       = slot;
+            record->frame      = sampler->frame;
+            record->generation = sampler->appliedGeneration;
+            record->timeMs     = timeMs;
+            record->process    = sampler->table.slots[slot];
+
+            PushRecord(pipeline->sampleRing, record, true);
+        }
+
+        record->type       = STAGE_RECORD_FRAME;
+        record->slot       = -1;
+        record->frame      = sampler->frame;
+        record->generation = sampler->appliedGeneration;
+        record->timeMs     = timeMs;
+        record->info       = info;
+
+        PushRecord(pipeline->sampleRing, record, true);
+
+        PaceFrame(sampler);
+    }
+
+    ConfigReaderOffline(sampler->configReader);
+    CloseRecordRing(pipeline->sampleRing);
+
+    tStageRing = NULL;
+    MH_FREE(record);
+
+    return NULL;
+}
+
+
+// Emit stage: log text to stdout and records to gRecordWriter. The only
+// stage that waits on a slow reader.
+static void *EmitStageThread(void *arg)
+{
+    Pipeline    *pipeline = arg;
+    StageRecord *record   = MH_MALLOC(sizeof(StageRecord));
+
+    int  recordFrame = -1;    // Frame gRecordWriter has begun
+    bool frameOpen   = false; // Its records are taken
+
+    while (record && PopRecord(pipeline->emitRing, record))
+    {
+        unsigned long long beginNs = GetMonotonicNs();
+
+        if (record->type == STAGE_RECORD_LOG) fputs(record->text, stdout);
+        else if (record->type == STAGE_RECORD_PROCESS)
+        {
+            if (record->frame != recordFrame)
+            {
+                recordFrame = record->frame;
+                frameOpen   = WaitRecordFrame(&gRecordWriter);
+            }
+
+            if (frameOpen) AppendProcessRecord(&gRecordWriter, &record->process, record->frame, record->timeMs);
+        }
+        else if (frameOpen && (record->frame == recordFrame))
+        {
+            FlushRecordFrame(&gRecordWriter);
+            frameOpen = false;
+        }
+
+        atomic_fetch_add_explicit(&pipeline->emitBusyNs, GetMonotonicNs() - beginNs, memory_order_relaxed);
+    }
+
+    MH_FREE(record);
+
+    return NULL;
+}
+
+
+// Evaluate/enforce on this thread, sample and emit on their own, until the
+// sample stage stops. Returns 0, or -1 when the pipeline could not start.
+static int RunPipeline(Pipeline *pipeline, Enforcer *enforcer)
+{
+    int status = -1;
+
+    StageRecord *record = MH_MALLOC(sizeof(StageRecord));
+
+    pipeline->sampleRing = CreateRecordRing(sizeof(StageRecord), STAGE_RING_CAPACITY);
+    pipeline->emitRing   = CreateRecordRing(sizeof(StageRecord), STAGE_RING_CAPACITY);
+
+    if (!record || !pipeline->sampleRing || !pipeline->emitRing) goto ioError;
+
+    // Only the sample stage takes signals (see SampleStageThread())
+    sigset_t signals, previousSignals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+
+    unsigned int generation = pipeline->sampler->appliedGeneration;
+
+    ConfigReaderOffline(pipeline->sampler->configReader); // The sample stage takes it over
+
+    if (pthread_create(&pipeline->emitThread, NULL, EmitStageThread, pipeline) != 0)
+    {
+        pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+        goto ioError;
+    }
+
+    if (pthread_create(&pipeline->sampleThread, NULL, SampleStageThread, pipeline) != 0)
+    {
+        CloseRecordRing(pipeline->emitRing);
+        pthread_join(pipeline->emitThread, NULL);
+        pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+        goto ioError;
+    }
+
+    tStageRing      = pipeline->emitRing;
+    tStageRingWaits = false;
+
+    while (PopRecord(pipeline->sampleRing, record))
+    {
+        if (record->type == STAGE_RECORD_LOG)
+        {
+            PushRecord(pipeline->emitRing, record, false);
+            continue;
+        }
+
+        int slotCount = (record->type == STAGE_RECORD_PROCESS) ? (record->slot + 1) : record->info.slotCount;
+
+        if (ReservePipelineSlots(pipeline, slotCount) != 0) continue; // This frame goes without the process
+
+        if (record->type == STAGE_RECORD_PROCESS)
+        {
+            MergeSampledProcess(&pipeline->slots[record->slot], &record->process, record->generation != generation);
+            pipeline->slotFrames[record->slot] = record->frame;
+            continue;
+        }
+
+        // STAGE_RECORD_FRAME: the frame is complete
+        for (int slot = 0; slot < pipeline->slotCapacity; slot++)
+        {
+            Process *process = &pipeline->slots[slot];
+
+            if (process->used && (pipeline->slotFrames[slot] != record->frame))
+            {
+                ReleaseProcess(process, false); // Gone
+                process->used = false;
+            }
+        }
+
+        generation = record->generation;
+
+        EnforceFrame(enforcer, pipeline->slots, &record->info, record->frame, record->timeMs,
+                     (gRecordWriter.fd >= 0) && (record->info.frameSeconds > 0));
+
+        RecordHistogram(&gLoopStats.frameNs, GetMonotonicNs() - record->info.frameBeginNs);
+
+        PushRecord(pipeline->emitRing, record, false);
+
+        if (gStatsRequested)
+        {
+            gStatsRequested = 0;
+            LogStats(NULL, pipeline);
+        }
+    }
+
+    tStageRing = NULL;
+
+    CloseRecordRing(pipeline->emitRing);
+    pthread_join(pipeline->sampleThread, NULL);
+    pthread_join(pipeline->emitThread, NULL);
+    pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+
+    status = 0;
+
+ioError:
+
+    MH_FREE(record);
+
+    return status;
+}
+
+
+// Release the evaluate stage's copies and the rings, after LogStats()
+static void ClosePipeline(Pipeline *pipeline)
+{
+    for (int slot = 0; slot < pipeline->slotCapacity; slot++)
+        if (pipeline->slots[slot].used) ReleaseProcess(&pipeline->slots[slot], true);
+
+    DestroyRecordRing(pipeline->sampleRing);
+    DestroyRecordRing(pipeline->emitRing);
+    MH_FREE(pipeline->slots);
+    MH_FREE(pipeline->slotFrames);
+
+    *pipeline = (Pipeline){0};
+}
+
+
+int RunMain(void)
+{
+    int status = 0; // EXIT_SUCCESS
+
+    int           configReader = RegisterConfigReader();
+    const Config *config       = AcquireConfig();
+
+    // Log module information to stdout
+    //----------------------------------------------------------------------------------
+    if (memhold.flagVerbose)
+    {
+        for (int i = 0; i < memhold.userProcessCount; i++)
+        {
+            fprintf(stdout, "[  OK  ]  <PID> %d\n", memhold.userProcessPIDs[i]);
+        }
+    }
+
+    if (memhold.flagLog)
+    {
+        // Log user stats
+        fprintf(stdout, "[ INFO ]  [ user ]\n");
+        if (memhold.flagAll) fprintf(stdout, "[ INFO ]  PID: all\n");
+        for (int i = 0; i < memhold.userProcessCount; i++)
+            fprintf(stdout, "[ INFO ]  PID: %d\n", memhold.userProcessPIDs[i]);
+        if (memhold.rulesFileName) fprintf(stdout, "[ INFO ]  Rules: %s (%d rules)\n", memhold.rulesFileName, config->rules.ruleCount);
+        // Opts: constants like
+        fprintf(stdout, "[ INFO ]  Threshold CPU: %f\n", config->cpuThreshold);
+        fprintf(stdout, "[ INFO ]  Threshold MEM: %zu\n", config->memThreshold);
+        // Opts: loop stats
+        fprintf(stdout, "[ INFO ]  Refresh: %.2fs (%s)\n", memhold.refreshSeconds, memhold.apiID);
+
+        // Log memhold stats
+        fprintf(stdout, "[ INFO ]  [ %s ]\n", memhold.apiID);
+        fprintf(stdout, "[ INFO ]  PID: %d\n", memhold.memholdMainProcessPID);
+        // Memhold: stats
+        fprintf(stdout, "[ INFO ]  Version: %d.%d.%d\n", MEMHOLD_VERSION_MAJOR, MEMHOLD_VERSION_MINOR, MEMHOLD_VERSION_PATCH);
+    }
+    //----------------------------------------------------------------------------------
+
+    // Prepare main loop
+    //----------------------------------------------------------------------------------
+    if (memhold.flagVerbose) fprintf(stdout, "\n[ INFO ]  <<< Stage 2: Monitor processes >>>\n\n");
+
+    char cmdGetProcName[256];
+
+    char   cmdCPU[256];
+    char   cmdMEM[256];
+    size_t cpuUsage[64];
+    size_t memUsage[64];
+
+    int    cpuUsageCounter   = 0;
+    int    memUsageCounter   = 0;
+    size_t cpuUsageThisFrame = 0;
+    size_t memUsageThisFrame = 0;
+
+#if 0 && MEMHOLD_YAGNI
+    //
+    // Prepare command statements
+    //
+
+    int stackAllocCmd = (sizeof(cmdCPU) + sizeof(cmdMEM) + sizeof(cmdGetProcName)); //> 768
+    int bytesSoFar    = 0;
+
+    bytesSoFar += snprintf(cmdCPU, sizeof(cmdCPU), "ps -p %d -o %%cpu --no-headers", memhold.userProcessPID);
+    bytesSoFar += snprintf(cmdMEM, sizeof(cmdMEM), "ps -p %d -o rss --no-headers", memhold.userProcessPID);
+    bytesSoFar += snprintf(cmdGetProcName, sizeof(cmdGetProcName), "ps aux | grep %d", memhold.userProcessPID);
+    assert(bytesSoFar >= 64 && bytesSoFar <= stackAllocCmd); //> 79 >= 64
+
+    #if 0            // TEMP LOG to stdout Process Name
+        int ret = system(cmdGetProcName);
+        if (ret != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "[ ERR! ]  failed to execute command. system call returned: %d", ret);
+            perror(msg);
+            exit(1);
+        };
+    #endif           /* if 0 */
+
+    const int CMD_MAX = 1035;
+    int       pstatus;
+    FILE     *pipefp;
+    char      cmd[CMD_MAX];
+    pipefp = popen(cmdGetProcName, "r");
+    if (pipefp == NULL) {
+        perror("[ ERR! ]  failed to execute popen for getting process name via its PID");
+        exit(1);
+    }
+
+    int cntr = 0;
+    while (fgets(cmd, CMD_MAX, pipefp) != NULL) {
+        cntr++;
+        fprintf(stdout, "[  OK  ] [%d]: %s", cntr, cmd);
+    }
+
+    pstatus = pclose(pipefp);
+    if (pstatus == -1) perror("[ ERR! ] pclose"); // todo
+    #if MEMHOLD_SLOW // TODO: use macros (From examples in popen() are marvelous articles?)
+    else fprintf(stdout, "[ INFO ] pclose returned status for: %s\n", cmdGetProcName);
+    #endif           /* if MEMHOLD_SLOW */
+
+#endif /* if MEMHOLD_YAGNI */
+       //----------------------------------------------------------------------------------
+
+    // Run main loop
+    //----------------------------------------------------------------------------------
+    FrameSampler   sampler        = {.taskstats = {.fd = -1, .exitFd = -1}, .configReader = configReader};
+    Enforcer       enforcer       = {.pressureFd = -1, .vmStatFd = -1};
+    Pipeline       pipeline       = {.sampler = &sampler};
+    ConfigReloader configReloader = {0};
+
+    if (memhold.rulesFileName && (StartConfigReloader(&configReloader, memhold.rulesFileName) != 0))
+        fprintf(stdout, "[ WARN ]  %s will not be reloaded on change\n", memhold.rulesFileName);
+
+    if (memhold.sampleBackend == SAMPLE_BACKEND_TASKSTATS)
+    {
+        if (InitTaskstats(&sampler.taskstats) != 0)
+        {
+            fprintf(stdout, "[ WARN ]  taskstats unavailable (%s), falling back to procfs\n", strerror(errno));
+            memhold.sampleBackend = SAMPLE_BACKEND_PROCFS;
+        }
+        else if (ListenTaskstatsExit(&sampler.taskstats, NULL) != 0)
+        {
+            fprintf(stdout, "[ WARN ]  taskstats exit listener unavailable\n");
+        }
+
+        if (memhold.flagVerbose) fprintf(stdout, "[ INFO ]  Backend: %s\n", sampler.taskstats.available ? "taskstats" : "procfs");
+    }
+
+    if (memhold.sampleBackend == SAMPLE_BACKEND_URING)
+    {
+        sampler.table.reader = CreateProcReader(memhold.context, MAX_USER_PIDS, true);
+
+        if (!sampler.table.reader)
+        {
+            fprintf(stdout, "[ WARN ]  stat reader unavailable, falling back to procfs\n");
+            memhold.sampleBackend = SAMPLE_BACKEND_PROCFS;
+        }
+        else if (GetProcReaderMode(sampler.table.reader) == PROC_READER_PREAD)
+        {
+            fprintf(stdout, "[ WARN ]  io_uring unavailable, reading kept-open stat fds with pread\n");
+        }
+
+        if (memhold.flagVerbose && sampler.table.reader)
+            fprintf(stdout, "[ INFO ]  Backend: %s\n", gProcReaderModeNames[GetProcReaderMode(sampler.table.reader)]);
+    }
+
+    SelectFramePlan(&sampler.table, config); // Before the reader opens any fd
+
+    for (int i = 0; i < memhold.userProcessCount; i++)
+    {
+        int slot = AttachProcess(&sampler.table, config, memhold.userProcessPIDs[i]);
+
+        if (slot < 0) fprintf(stderr, "[ ERR! ]  PID: %d  no such process\n", memhold.userProcessPIDs[i]);
+        else if (memhold.flagVerbose)
+        {
+            const Process *process = &sampler.table.slots[slot];
+
+            fprintf(stdout, "[ INFO ]  PID: %d  %s  age: %.0fs\n", process->pid, process->comm, GetProcessAgeSec(memhold.context, process->starttime));
+            if (process->ruleIndex >= 0) fprintf(stdout, "[ INFO ]  PID: %d  %s  rule: line %d\n", process->pid, process->comm, config->rules.rules[process->ruleIndex].line);
+            LogProcLimits(process);
+        }
+    }
+
+    sampler.appliedGeneration = config->generation;
+
+    // No SA_RESTART: a signal cuts the sleep between frames short
+    struct sigaction stopAction  = {.sa_handler = HandleStopSignal};
+    struct sigaction statsAction = {.sa_handler = HandleStatsSignal};
+
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+    sigaction(SIGUSR1, &statsAction, NULL);
+
+    unsigned long long loopBeginNs = GetMonotonicNs();
+
+    if (memhold.pressureThreshold != MH_NO_LIMIT_CPU)
+    {
+        enforcer.pressureFd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+        if ((enforcer.pressureFd < 0) && memhold.flagVerbose) fprintf(stdout, "[ INFO ]  PSI unavailable (%s), holds ignore host pressure\n", strerror(errno));
+    }
+
+    // Idle page tracking needs CONFIG_IDLE_PAGE_TRACKING
+    if ((memhold.workingSetSeconds > 0) && (access("/sys/kernel/mm/page_idle/bitmap", R_OK | W_OK) != 0))
+    {
+        fprintf(stdout, "[ WARN ]  page_idle unavailable (%s), thresholds stay on RSS\n", strerror(errno));
+        memhold.workingSetSeconds = 0;
+    }
+
+    if (memhold.thrashThreshold != MH_NO_LIMIT_CPU)
+    {
+        enforcer.vmStatFd = open("/proc/vmstat", O_RDONLY | O_CLOEXEC);
+        if (enforcer.vmStatFd < 0) fprintf(stdout, "[ WARN ]  /proc/vmstat unavailable (%s), thrashing is not detected\n", strerror(errno));
+    }
+
+    if (memhold.flagPipeline && (RunPipeline(&pipeline, &enforcer) != 0))
+    {
+        fprintf(stdout, "[ WARN ]  pipeline unavailable, running every stage on one thread\n");
+        ClosePipeline(&pipeline);
+        pipeline.sampler     = &sampler;
+        memhold.flagPipeline = false;
+    }
+
+    while (!memhold.flagPipeline && !gStopRequested)
+    {
+        FrameInfo          info   = {0};
+        unsigned long long timeMs = 0;
+
+        if (!SampleFrame(&sampler, &info, &timeMs)) break;
+
+        bool emitRecords = (info.frameSeconds > 0) && BeginRecordFrame(&gRecordWriter);
+
+        EnforceFrame(&enforcer, sampler.table.slots, &info, sampler.frame, timeMs, emitRecords);
+
+        if (emitRecords) FlushRecordFrame(&gRecordWriter);
+
+        RecordHistogram(&gLoopStats.frameNs, GetMonotonicNs() - info.frameBeginNs);
+
+        PaceFrame(&sampler);
+
+        if (gStatsRequested)
+        {
+            gStatsRequested = 0;
+            LogStats(&sampler.table, NULL);
+        }
+    }
+    // end while (1)
+    //----------------------------------------------------------------------------------
+
+    double loopSeconds = (GetMonotonicNs() - loopBeginNs) / 1e9;
+
+    if (memhold.flagLog) LogStats(&sampler.table, memhold.flagPipeline ? &pipeline : NULL);
+
+    ClosePipeline(&pipeline);
+
+    ConfigReaderOffline(configReader);
+    StopConfigReloader(&configReloader);
+
+    if (enforcer.pressureFd >= 0) close(enforcer.pressureFd);
+    if (enforcer.vmStatFd >= 0) close(enforcer.vmStatFd);
+
+    UnloadProcessTable(&sampler.table);
+    if (sampler.taskstats.available) CloseTaskstats(&sampler.taskstats);
+
+    // Unload program
+    //----------------------------------------------------------------------------------
+    // NOTE(Lloyd): Unload more data or free memory here... (e.g. ML_FREE(...))
+    PublishConfig(NULL);
+    DestroySamplerPool(memhold.samplerPool);
+    DestroyMemholdContext(memhold.context);
+
+    if (memhold.flagVerbose)
+    {
+        fprintf(stdout, "\n[ INFO ]  <<< Stage 3: Cleanup and Exit >>>\n\n");
+        fprintf(stdout, "[ INFO ]  took %.2fs (%d frames)\n", loopSeconds, sampler.frame);
+    }
+    //----------------------------------------------------------------------------------
+
+    return status;
+};
+
+//-----------------------------------------------------------------------------
+// Benchmarks: `memhold bench <name> ...`
+//-----------------------------------------------------------------------------
+
+static double BenchNowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+
+// Cost per sample of each CPU time source for one PID
+static int RunBenchBackends(pid_t pid, int sampleCount)
+{
+    double   begin, elapsed;
+    ProcStat procStat;
+
+    fprintf(stdout, "[ INFO ]  PID: %d  samples: %d\n", pid, sampleCount);
+
+    // procfs: open() + read() + close() + ParseProcStat()
+    //----------------------------------------------------------------------------------
+    begin = BenchNowSeconds();
+    for (int i = 0; i < sampleCount; i++)
+        GetProcStat(pid, &procStat);
+    elapsed = BenchNowSeconds() - begin;
+
+    fprintf(stdout, "[ INFO ]  %-28s %10.0f ns/sample\n", "procfs open+read", (elapsed * 1e9) / sampleCount);
+    //----------------------------------------------------------------------------------
+
+    // procfs: kept-open fd, pread() + ParseProcStat()
+    //----------------------------------------------------------------------------------
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "[ ERR! ]  failed to open stat file. path: %s\n", path);
+        return 1;
+    }
+
+    begin = BenchNowSeconds();
+    for (int i = 0; i < sampleCount; i++)
+    {
+        char    buf[1024];
+        ssize_t bytesRead = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (bytesRead > 0) ParseProcStat(buf, (int)bytesRead, &procStat);
+    }
+    elapsed = BenchNowSeconds() - begin;
+    close(fd);
+
+    fprintf(stdout, "[ INFO ]  %-28s %10.0f ns/sample\n", "procfs kept-open pread", (elapsed * 1e9) / sampleCount);
+    //----------------------------------------------------------------------------------
+
+    // taskstats: one PID per round trip, then full batches
+    //----------------------------------------------------------------------------------
+    TaskstatsBackend taskstats;
+
+    if (InitTaskstats(&taskstats) != 0)
+    {
+        fprintf(stdout, "[ WARN ]  taskstats unavailable (%s), skipped\n", strerror(errno));
+        return 0;
+    }
+
+    TaskSample taskSample;
+
+    begin = BenchNowSeconds();
+    for (int i = 0; i < sampleCount; i++)
+        GetTaskstats(&taskstats, pid, &taskSample);
+    elapsed = BenchNowSeconds() - begin;
+
+    fprintf(stdout, "[ INFO ]  %-28s %10.0f ns/sample\n", "taskstats single", (elapsed * 1e9) / sampleCount);
+
+    pid_t      batchPids[MH_TASKSTATS_BATCH];
+    TaskSample batchSamples[MH_TASKSTATS_BATCH];
+    int        batchResults[MH_TASKSTATS_BATCH];
+
+    for (int i = 0; i < MH_TASKSTATS_BATCH; i++)
+        batchPids[i] = pid;
+
+    int batchCount = (sampleCount + MH_TASKSTATS_BATCH - 1) / MH_TASKSTATS_BATCH;
+
+    begin = BenchNowSeconds();
+    for (int i = 0; i < batchCount; i++)
+        GetTaskstatsBatch(&taskstats, batchPids, MH_TASKSTATS_BATCH, batchSamples, batchResults);
+    elapsed = BenchNowSeconds() - begin;
+
+    fprintf(stdout, "[ INFO ]  %-28s %10.0f ns/sample\n", "taskstats batch", (elapsed * 1e9) / (batchCount * MH_TASKSTATS_BATCH));
+
+    CloseTaskstats(&taskstats);
+    //----------------------------------------------------------------------------------
+
+    return 0;
+}
+
+
+static void *BenchThreadsWorker(void *arg)
+{
+    BenchThreadsWork *work = arg;
+
+    ProcessSample *samples = MH_MALLOC(work->count * sizeof(ProcessSample));
+    int           *results = MH_MALLOC(work->count * sizeof(int));
+
+    for (int round = 0; (round < work->roundCount) && samples && results; round++)
+        work->sampledCount += SampleProcesses(work->context, work->pids, work->count, samples, results);
+
+    MH_FREE(samples);
+    MH_FREE(results);
+
+    return NULL;
+}
+
+
+// Every PID in /proc, repeated until there are at least `minCount` of them
+// (stands in for a host with that many processes). NULL on error.
+static pid_t *BenchListPids(int minCount, int *pidCount)
+{
+    pid_t *pids     = NULL;
+    int    count    = 0;
+    int    capacity = 0;
+
+    DIR           *procDir = opendir("/proc");
+    struct dirent *entry   = NULL;
+
+    while (procDir && (entry = readdir(procDir)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+
+        if (count == capacity)
+        {
+            capacity      = (capacity == 0) ? 256 : (2 * capacity);
+            pid_t *resize = MH_REALLOC(pids, capacity * sizeof(pid_t));
+
+            if (!resize) break;
+            pids = resize;
+        }
+
+        pids[count++] = (pid_t)atoi(entry->d_name);
+    }
+
+    if (procDir) closedir(procDir);
+
+    for (int i = 0; (count > 0) && (count < minCount); i++)
+    {
+        if (count == capacity)
+        {
+            capacity      = 2 * capacity;
+            pid_t *resize = MH_REALLOC(pids, capacity * sizeof(pid_t));
+
+            if (!resize) break;
+            pids = resize;
+        }
+
+        pids[count++] = pids[i];
+    }
+
+    *pidCount = count;
+
+    return pids;
+}
+
+
+// Throughput of SampleProcesses() over every PID in /proc, with 1, 2, 4, ...
+// up to `maxThreads` threads sharing one context. Each thread samples the
+// whole list `roundCount` times, so linear scaling keeps ns/sample per thread flat.
+static int RunBenchThreads(int maxThreads, int roundCount)
+{
+    int    count   = 0;
+    pid_t *pids    = BenchListPids(0, &count);
+
+    MemholdContext *context = CreateMemholdContext();
+
+    if (!context || (count == 0))
+    {
+        fprintf(stderr, "[ ERR! ]  nothing to sample\n");
+        MH_FREE(pids);
+        DestroyMemholdContext(context);
+        return 1;
+    }
+
+    fprintf(stdout, "[ INFO ]  PIDs: %d  rounds: %d  CPUs: %ld\n", count, roundCount, sysconf(_SC_NPROCESSORS_ONLN));
+
+    pthread_t        threads[64];
+    BenchThreadsWork work[64];
+    double           baseRate = 0.0;
+
+    if (maxThreads > (int)ARRAY_SIZE(threads)) maxThreads = (int)ARRAY_SIZE(threads);
+
+    for (int threadCount = 1;; threadCount *= 2)
+    {
+        if (threadCount > maxThreads) threadCount = maxThreads;
+
+        double begin = BenchNowSeconds();
+
+        for (int t = 0; t < threadCount; t++)
+        {
+            work[t] = (BenchThreadsWork){.context = context, .pids = pids, .count = count, .roundCount = roundCount};
+            pthread_create(&threads[t], NULL, BenchThreadsWorker, &work[t]);
+        }
+
+        long sampledCount = 0;
+
+        for (int t = 0; t < threadCount; t++)
+        {
+            pthread_join(threads[t], NULL);
+            sampledCount += work[t].sampledCount;
+        }
+
+        double elapsed = BenchNowSeconds() - begin;
+        double rate    = sampledCount / elapsed;
+
+        if (threadCount == 1) baseRate = rate;
+
+        fprintf(stdout, "[ INFO ]  threads: %2d  %10.0f samples/s  %8.0f ns/sample/thread  scaling: %5.2fx\n", threadCount, rate,
+                (elapsed * 1e9 * threadCount) / sampledCount, rate / baseRate);
+
+        if (threadCount == maxThreads) break;
+    }
+
+    MH_FREE(pids);
+    DestroyMemholdContext(context);
+
+    return 0;
+}
+
+
+// Frame time of SampleProcessesParallel() over `pidCount` PIDs with 1, 2, 4,
+// ... up to `maxWorkers` workers.
+static int RunBenchWorkers(int maxWorkers, int pidCount, int frameCount)
+{
+    int             count   = 0;
+    pid_t          *pids    = BenchListPids(pidCount, &count);
+    ProcessSample  *samples = MH_MALLOC(count * sizeof(ProcessSample));
+    int            *results = MH_MALLOC(count * sizeof(int));
+    MemholdContext *context = CreateMemholdContext();
+
+    if (!pids || !samples || !results || !context || (count == 0))
+    {
+        fprintf(stderr, "[ ERR! ]  nothing to sample\n");
+        goto benchError;
+    }
+
+    fprintf(stdout, "[ INFO ]  PIDs: %d  frames: %d  CPUs: %ld\n", count, frameCount, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (int workerCount = 1;; workerCount *= 2)
+    {
+        if (workerCount > maxWorkers) workerCount = maxWorkers;
+
+        SamplerPool *pool = CreateSamplerPool(context, workerCount);
+
+        if (!pool)
+        {
+            fprintf(stderr, "[ ERR! ]  failed to start %d workers\n", workerCount);
+            break;
+        }
+
+        SampleProcessesParallel(pool, pids, count, samples, results); // Warm up
+
+        int    stolenCount = 0;
+        double begin       = BenchNowSeconds();
+
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            SampleProcessesParallel(pool, pids, count, samples, results);
+            stolenCount += GetSamplerPoolSteals(pool);
+        }
+
+        double frameMs = (BenchNowSeconds() - begin) * 1e3 / frameCount;
+
+        fprintf(stdout, "[ INFO ]  workers: %2d  %8.2f ms/frame  steals: %6.1f/frame\n", workerCount, frameMs, (double)stolenCount / frameCount);
+
+        DestroySamplerPool(pool);
+
+        if (workerCount == maxWorkers) break;
+    }
+
+benchError:
+
+    MH_FREE(pids);
+    MH_FREE(samples);
+    MH_FREE(results);
+    DestroyMemholdContext(context);
+
+    return 0;
+}
+
+
+// Frame time and syscalls per frame of the stat read paths over `pidCount`
+// PIDs: open/read/close per PID, pread on kept-open fds, one io_uring batch.
+static int RunBenchUring(int pidCount, int frameCount)
+{
+    int             count   = 0;
+    pid_t          *pids    = BenchListPids(pidCount, &count);
+    int            *slots   = MH_MALLOC(count * sizeof(int));
+    ProcessSample  *samples = MH_MALLOC(count * sizeof(ProcessSample));
+    int            *results = MH_MALLOC(count * sizeof(int));
+    MemholdContext *context = CreateMemholdContext();
+
+    if (!pids || !slots || !samples || !results || !context || (count == 0))
+    {
+        fprintf(stderr, "[ ERR! ]  nothing to sample\n");
+        goto benchError;
+    }
+
+    fprintf(stdout, "[ INFO ]  PIDs: %d  frames: %d\n", count, frameCount);
+
+    double begin = BenchNowSeconds();
+
+    for (int frame = 0; frame < frameCount; frame++)
+        SampleProcesses(context, pids, count, samples, results);
+
+    fprintf(stdout, "[ INFO ]  %-30s %8.2f ms/frame  %8d syscalls/frame\n", "open/read/close",
+            (BenchNowSeconds() - begin) * 1e3 / frameCount, 3 * count);
+
+    for (int useUring = 0; useUring <= 1; useUring++)
+    {
+        ProcReader *reader = CreateProcReader(context, count, useUring);
+
+        if (!reader) break;
+
+        int attachedCount = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            slots[i] = i;
+            if (AttachProcReader(reader, i, pids[i]) == 0) attachedCount += 1;
+        }
+
+        ReadProcStats(reader, slots, count, samples, results); // Warm up
+
+        begin = BenchNowSeconds();
+
+        for (int frame = 0; frame < frameCount; frame++)
+            ReadProcStats(reader, slots, count, samples, results);
+
+        fprintf(stdout, "[ INFO ]  %-30s %8.2f ms/frame  %8d syscalls/frame  (%d fds open)\n", gProcReaderModeNames[GetProcReaderMode(reader)],
+                (BenchNowSeconds() - begin) * 1e3 / frameCount, GetProcReaderSyscalls(reader), attachedCount);
+
+        bool uringDone = useUring && (GetProcReaderMode(reader) != PROC_READER_PREAD);
+
+        DestroyProcReader(reader);
+
+        if (useUring && !uringDone) fprintf(stdout, "[ WARN ]  io_uring unavailable, the last run used pread\n");
+    }
+
+benchError:
+
+    MH_FREE(pids);
+    MH_FREE(slots);
+    MH_FREE(samples);
+    MH_FREE(results);
+    DestroyMemholdContext(context);
+
+    return 0;
+}
+
+
+// The fgets() + strncmp() loop GetMemUsage() had, asked for every field
+// ParseProcStatus() knows. `buf` is read through fmemopen(), like a file.
+static int BenchStatusLineByLine(char *buf, int bufLen, bool allFields, ProcStatus *status)
+{
+    static const char *keys[] = {"VmRSS:", "VmHWM:", "VmSwap:", "RssAnon:", "RssFile:", "RssShmem:", "Threads:", "voluntary_ctxt_switches:",
+                                 "nonvoluntary_ctxt_switches:"};
+
+    FILE *fp = fmemopen(buf, bufLen, "r");
+    if (!fp) return -1;
+
+    char line[256];
+    int  foundCount = 0;
+
+    *status = (ProcStatus){0};
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        for (int k = 0; k < (allFields ? (int)ARRAY_SIZE(keys) : 1); k++)
+        {
+            int keyLen = (int)strlen(keys[k]);
+
+            if (strncmp(line, keys[k], keyLen) != 0) continue;
+
+            unsigned long value = strtoul(line + keyLen, NULL, 10);
+
+            switch (k)
+            {
+            case 0: status->vmRssKB = value; break;
+            case 1: status->vmHwmKB = value; break;
+            case 2: status->vmSwapKB = value; break;
+            case 3: status->rssAnonKB = value; break;
+            case 4: status->rssFileKB = value; break;
+            case 5: status->rssShmemKB = value; break;
+            case 6: status->threads = (long)value; break;
+            case 7: status->voluntaryCtxtSwitches = value; break;
+            case 8: status->nonvoluntaryCtxtSwitches = value; break;
+            }
+            foundCount += 1;
+        }
+
+        if (!allFields && foundCount) break;
+    }
+
+    fclose(fp);
+
+    return foundCount;
+}
+
+
+// Parse time of /proc/<pid>/status: the fgets() line loop against the
+// single-pass ParseProcStatus(), for VmRSS alone and for every field.
+// Files are read once up front, so only parsing is timed.
+static int RunBenchStatus(int roundCount)
+{
+    int    count     = 0;
+    pid_t *pids      = BenchListPids(0, &count);
+    char  *buffers   = MH_MALLOC((size_t)count * 4096);
+    int   *lengths   = MH_MALLOC(count * sizeof(int));
+    int    fileCount = 0;
+
+    for (int i = 0; pids && buffers && lengths && (i < count); i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/status", pids[i]);
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+
+        ssize_t bytesRead = read(fd, buffers + ((size_t)fileCount * 4096), 4096);
+        close(fd);
+
+        if (bytesRead > 0) lengths[fileCount++] = (int)bytesRead;
+    }
+
+    if (fileCount == 0)
+    {
+        fprintf(stderr, "[ ERR! ]  nothing to parse\n");
+        goto benchError;
+    }
+
+    fprintf(stdout, "[ INFO ]  files: %d  rounds: %d\n", fileCount, roundCount);
+
+    for (int allFields = 0; allFields <= 1; allFields++)
+    {
+        unsigned int fieldMask = allFields ? STATUS_ALL : STATUS_VM_RSS;
+        ProcStatus   status;
+        long         checksum[2] = {0};
+        double       seconds[2]  = {0};
+
+        for (int method = 0; method < 2; method++)
+        {
+            double begin = BenchNowSeconds();
+
+            for (int round = 0; round < roundCount; round++)
+            {
+                for (int i = 0; i < fileCount; i++)
+                {
+                    char *buf = buffers + ((size_t)i * 4096);
+
+                    if (method == 0) BenchStatusLineByLine(buf, lengths[i], allFields, &status);
+                    else ParseProcStatus(buf, lengths[i], fieldMask, &status);
+
+                    checksum[method] += (long)(status.vmRssKB + status.threads + status.nonvoluntaryCtxtSwitches);
+                }
+            }
+
+            seconds[method] = BenchNowSeconds() - begin;
+        }
+
+        double lineNs = seconds[0] * 1e9 / ((double)roundCount * fileCount);
+        double passNs = seconds[1] * 1e9 / ((double)roundCount * fileCount);
+
+        fprintf(stdout, "[ INFO ]  %-11s fgets loop: %7.1f ns/file  single pass: %7.1f ns/file  speedup: %5.1fx%s\n", allFields ? "all fields" : "VmRSS",
+                lineNs, passNs, lineNs / passNs, (checksum[0] == checksum[1]) ? "" : "  (results differ!)");
+    }
+
+benchError:
+
+    MH_FREE(pids);
+    MH_FREE(buffers);
+    MH_FREE(lengths);
+
+    return 0;
+}
+
+
+static int BenchCompareKeysDescending(const void *a, const void *b)
+{
+    double keyA = *(const double *)a;
+    double keyB = *(const double *)b;
+
+    return (keyA < keyB) - (keyA > keyB);
+}
+
+
+// Per-frame cost of keeping the three rankings at 1k, 10k and 50k processes
+// when 1%, 10% and all of them change, against sorting all keys every frame.
+static int RunBenchRank(int frameCount)
+{
+    static const int processCounts[]   = {1000, 10000, 50000};
+    static const int changedPercents[] = {1, 10, 100};
+
+    for (int c = 0; c < (int)ARRAY_SIZE(processCounts); c++)
+    {
+        int     count                = processCounts[c];
+        Ranking rankings[RANK_COUNT] = {0};
+        double *keys                 = MH_MALLOC(RANK_COUNT * count * sizeof(double));
+        double *sorted               = MH_MALLOC(count * sizeof(double));
+        bool    reserved             = true;
+
+        for (int key = 0; key < RANK_COUNT; key++)
+            if (ReserveRanking(&rankings[key], count) != 0) reserved = false;
+
+        if (!keys || !sorted || !reserved)
+        {
+            fprintf(stderr, "[ ERR! ]  out of memory\n");
+            MH_FREE(keys);
+            MH_FREE(sorted);
+            for (int key = 0; key < RANK_COUNT; key++)
+                UnloadRanking(&rankings[key]);
+            return 1;
+        }
+
+        for (int i = 0; i < RANK_COUNT * count; i++)
+            keys[i] = rand() % (1 << 20);
+
+        for (int key = 0; key < RANK_COUNT; key++)
+            for (int slot = 0; slot < count; slot++)
+                UpdateRanking(&rankings[key], slot, keys[(key * count) + slot]);
+
+        for (int p = 0; p < (int)ARRAY_SIZE(changedPercents); p++)
+        {
+            int    changedCount = (count * changedPercents[p]) / 100;
+            int    top[MAX_RANK_TOP_N];
+            bool   agrees  = true;
+            double rankSum = 0.0;
+            double sortSum = 0.0;
+
+            for (int frame = 0; frame < frameCount; frame++)
+            {
+                for (int i = 0; i < changedCount; i++)
+                {
+                    int slot = rand() % count;
+                    for (int key = 0; key < RANK_COUNT; key++)
+                        keys[(key * count) + slot] = rand() % (1 << 20);
+                }
+
+                // Incremental: what RankProcessTable() and LogRankings() do
+                double begin = BenchNowSeconds();
+
+                for (int key = 0; key < RANK_COUNT; key++)
+                {
+                    for (int slot = 0; slot < count; slot++)
+                        UpdateRanking(&rankings[key], slot, keys[(key * count) + slot]);
+
+                    GetTopRanked(&rankings[key], top, 10);
+                }
+
+                rankSum += BenchNowSeconds() - begin;
+
+                // Full sort of every key
+                begin = BenchNowSeconds();
+
+                for (int key = 0; key < RANK_COUNT; key++)
+                {
+                    memcpy(sorted, keys + (key * count), count * sizeof(double));
+                    qsort(sorted, count, sizeof(double), BenchCompareKeysDescending);
+                }
+
+                sortSum += BenchNowSeconds() - begin;
+
+                for (int i = 0; i < 10; i++)
+                    if (keys[((RANK_COUNT - 1) * count) + top[i]] != sorted[i]) agrees = false;
+            }
+
+            fprintf(stdout, "[ INFO ]  processes: %6d  changed: %3d%%  ranked: %9.1f us/frame  sorted: %9.1f us/frame%s\n", count, changedPercents[p],
+                    rankSum * 1e6 / frameCount, sortSum * 1e6 / frameCount, agrees ? "" : "  (top 10 differs!)");
+        }
+
+        MH_FREE(keys);
+        MH_FREE(sorted);
+        for (int key = 0; key < RANK_COUNT; key++)
+            UnloadRanking(&rankings[key]);
+    }
+
+    return 0;
+}
+
+
+int RunBench(int argc, char *argv[])
+{
+    if ((argc >= 2) && (strcmp(argv[0], "backends") == 0))
+    {
+        int sampleCount = (argc >= 3) ? atoi(argv[2]) : 10000;
+        return RunBenchBackends((pid_t)atoi(argv[1]), (sampleCount > 0) ? sampleCount : 10000);
+    }
+
+    if ((argc >= 1) && (strcmp(argv[0], "threads") == 0))
+    {
+        int maxThreads = (argc >= 2) ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int roundCount = (argc >= 3) ? atoi(argv[2]) : 100;
+        return RunBenchThreads((maxThreads > 0) ? maxThreads : 1, (roundCount > 0) ? roundCount : 100);
+    }
+
+    if ((argc >= 1) && (strcmp(argv[0], "workers") == 0))
+    {
+        int maxWorkers = (argc >= 2) ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        int pidCount   = (argc >= 3) ? atoi(argv[2]) : 0;
+        int frameCount = (argc >= 4) ? atoi(argv[3]) : 20;
+        return RunBenchWorkers((maxWorkers > 0) ? maxWorkers : 1, pidCount, (frameCount > 0) ? frameCount : 20);
+    }
+
+    if ((argc >= 1) && (strcmp(argv[0], "uring") == 0))
+    {
+        int pidCount   = (argc >= 2) ? atoi(argv[1]) : 0;
+        int frameCount = (argc >= 3) ? atoi(argv[2]) : 20;
+        return RunBenchUring(pidCount, (frameCount > 0) ? frameCount : 20);
+    }
+
+    if ((argc >= 1) && (strcmp(argv[0], "status") == 0))
+    {
+        int roundCount = (argc >= 2) ? atoi(argv[1]) : 1000;
+        return RunBenchStatus((roundCount > 0) ? roundCount : 1000);
+    }
+
+    if ((argc >= 1) && (strcmp(argv[0], "rank") == 0))
+    {
+        int frameCount = (argc >= 2) ? atoi(argv[1]) : 100;
+        return RunBenchRank((frameCount > 0) ? frameCount : 100);
+    }
+
+    fprintf(stderr, "Usage: memhold bench backends <PID> [SAMPLES]\n");
+    fprintf(stderr, "       memhold bench threads [THREADS] [ROUNDS]\n");
+    fprintf(stderr, "       memhold bench workers [WORKERS] [PIDS] [FRAMES]\n");
+    fprintf(stderr, "       memhold bench uring [PIDS] [FRAMES]\n");
+    fprintf(stderr, "       memhold bench status [ROUNDS]\n");
+    fprintf(stderr, "       memhold bench rank [FRAMES]\n");
+
+    return 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Simulation: `memhold simulate ...`
+//-----------------------------------------------------------------------------
+//
+// Replays a trace of (time, pid, rss, cpu) samples through DecideProcess(),
+// once per policy of a sweep, with no sleeping and no /proc access. A frame
+// every `refreshSeconds` of trace time sees the latest sample of each live
+// process, as RunMain() would have. Holds do not feed back into the trace.
+//
+// A trace is the output of `memhold --format=csv` (any CSV with time_ms, pid,
+// rss_kb and cpu_pct columns will do), or generated with `--synthetic`.
+
+static void UnloadTrace(Trace *trace)
+{
+    MH_FREE(trace->samples);
+    MH_FREE(trace->pids);
+    MH_FREE(trace->lastMs);
+    MH_FREE(trace->processByPid);
+
+    *trace = (Trace){0};
+}
+
+
+// Append one sample. Returns -1 when out of memory or for a bogus PID.
+static int AddTraceSample(Trace *trace, unsigned long long timeMs, pid_t pid, unsigned int rssKB, float cpuPercent)
+{
+    if ((pid <= 0) || (pid > (1 << 22))) return -1; // PID_MAX_LIMIT
+
+    if (pid >= trace->pidCapacity)
+    {
+        int  capacity     = (trace->pidCapacity == 0) ? (1 << 15) : trace->pidCapacity;
+        while (capacity <= pid)
+            capacity *= 2;
+
+        int *processByPid = MH_REALLOC(trace->processByPid, capacity * sizeof(int));
+        if (!processByPid) return -1;
+
+        memset(processByPid + trace->pidCapacity, 0, (capacity - trace->pidCapacity) * sizeof(int));
+        trace->processByPid = processByPid;
+        trace->pidCapacity  = capacity;
+    }
+
+    int process = trace->processByPid[pid] - 1;
+
+    if (process < 0)
+    {
+        if (trace->processCount == trace->processCapacity)
+        {
+            int                 capacity = (trace->processCapacity == 0) ? 256 : (2 * trace->processCapacity);
+            pid_t              *pids     = MH_REALLOC(trace->pids, capacity * sizeof(pid_t));
+            unsigned long long *lastMs   = pids ? MH_REALLOC(trace->lastMs, capacity * sizeof(unsigned long long)) : NULL;
+
+            if (pids) trace->pids = pids;
+            if (!pids || !lastMs) return -1;
+
+            trace->lastMs          = lastMs;
+            trace->processCapacity = capacity;
+        }
+
+        process                    = trace->processCount++;
+        trace->pids[process]       = pid;
+        trace->processByPid[pid]   = process + 1;
+    }
+
+    if (trace->sampleCount == trace->sampleCapacity)
+    {
+        int          capacity = (trace->sampleCapacity == 0) ? (1 << 16) : (2 * trace->sampleCapacity);
+        TraceSample *samples  = MH_REALLOC(trace->samples, capacity * sizeof(TraceSample));
+
+        if (!samples) return -1;
+
+        trace->samples        = samples;
+        trace->sampleCapacity = capacity;
+    }
+
+    trace->samples[trace->sampleCount++] = (TraceSample){.timeMs = timeMs, .process = process, .rssKB = rssKB, .cpuPercent = cpuPercent};
+    trace->lastMs[process]               = timeMs;
+
+    return 0;
+}
+
+
+// Split one CSV line in place. Commas inside double quotes (a `comm`) do not
+// split. Returns the field count.
+static int SplitTraceLine(char *line, char **fields, int maxFields)
+{
+    int  fieldCount = 0;
+    bool quoted     = false;
+
+    fields[fieldCount++] = line;
+
+    for (char *p = line; *p != '\0'; p++)
+    {
+        if (*p == '"') quoted = !quoted;
+        else if ((*p == '\n') || (*p == '\r'))
+        {
+            *p = '\0';
+            break;
+        }
+        else if ((*p == ',') && !quoted)
+        {
+            *p = '\0';
+            if (fieldCount == maxFields) break;
+            fields[fieldCount++] = p + 1;
+        }
+    }
+
+    return fieldCount;
+}
+
+
+static int CompareTraceSamples(const void *a, const void *b)
+{
+    unsigned long long timeA = ((const TraceSample *)a)->timeMs;
+    unsigned long long timeB = ((const TraceSample *)b)->timeMs;
+
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+
+// Load a CSV trace, "-" for stdin. Rows that do not parse are skipped.
+// Returns 0, or -1 on error.
+static int LoadTrace(const char *fileName, Trace *trace)
+{
+    int     status   = -1;
+    char   *line     = NULL;
+    size_t  lineSize = 0;
+    char   *fields[32];
+    int     columns[4] = {-1, -1, -1, -1}; // time_ms, pid, rss_kb, cpu_pct
+    int     skipCount  = 0;
+    bool    sorted     = true;
+    FILE   *fp         = (strcmp(fileName, "-") == 0) ? stdin : fopen(fileName, "r");
+
+    static const char *columnNames[4] = {"time_ms", "pid", "rss_kb", "cpu_pct"};
+
+    if (!fp)
+    {
+        fprintf(stderr, "[ ERR! ]  %s: %s\n", fileName, strerror(errno));
+        return -1;
+    }
+
+    if (getline(&line, &lineSize, fp) <= 0) goto ioError;
+
+    int fieldCount = SplitTraceLine(line, fields, 32);
+
+    for (int f = 0; f < fieldCount; f++)
+        for (int c = 0; c < 4; c++)
+            if (strcmp(fields[f], columnNames[c]) == 0) columns[c] = f;
+
+    for (int c = 0; c < 4; c++)
+    {
+        if (columns[c] < 0)
+        {
+            fprintf(stderr, "[ ERR! ]  %s: no %s column\n", fileName, columnNames[c]);
+            goto ioError;
+        }
+    }
+
+    while (getline(&line, &lineSize, fp) > 0)
+    {
+        fieldCount = SplitTraceLine(line, fields, 32);
+
+        // A short row leaves fields[] pointing into the previous line
+        bool complete = true;
+        for (int c = 0; c < 4; c++)
+            complete = complete && (columns[c] < fieldCount);
+
+        if (!complete)
+        {
+            skipCount += 1;
+            continue;
+        }
+
+        char              *end[4];
+        unsigned long long timeMs     = strtoull(fields[columns[0]], &end[0], 10);
+        long               pid        = strtol(fields[columns[1]], &end[1], 10);
+        unsigned long long rssKB      = strtoull(fields[columns[2]], &end[2], 10);
+        float              cpuPercent = strtof(fields[columns[3]], &end[3]);
+
+        bool parsed = true;
+        for (int c = 0; c < 4; c++)
+            parsed = parsed && (end[c] != fields[columns[c]]);
+
+        if (!parsed || (rssKB > UINT_MAX))
+        {
+            skipCount += 1;
+            continue;
+        }
+
+        if ((trace->sampleCount > 0) && (timeMs < trace->samples[trace->sampleCount - 1].timeMs)) sorted = false;
+
+        if (AddTraceSample(trace, timeMs, (pid_t)pid, (unsigned int)rssKB, cpuPercent) != 0) skipCount += 1;
+    }
+
+    if (trace->sampleCount == 0)
+    {
+        fprintf(stderr, "[ ERR! ]  %s: no samples\n", fileName);
+        goto ioError;
+    }
+
+    if (!sorted) qsort(trace->samples, trace->sampleCount, sizeof(TraceSample), CompareTraceSamples);
+    if (skipCount > 0) fprintf(stdout, "[ WARN ]  %s: %d rows skipped\n", fileName, skipCount);
+
+    status = 0;
+
+ioError:
+
+    free(line); // From getline()
+    if (fp != stdin) fclose(fp);
+
+    return status;
+}
+
+
+// xorshift64*, so a seed always gives the same trace
+static unsigned long long NextTraceRandom(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+
+static double NextTraceUniform(unsigned long long *state) { return (double)(NextTraceRandom(state) >> 11) / (double)(1ULL << 53); }
+
+
+// A fleet in miniature: every process wanders around its own RSS, one in ten
+// leaks until it restarts, and CPU comes in bursts. Returns 0, or -1 when out
+// of memory.
+static int GenerateTrace(Trace *trace, int processCount, int seconds, int stepMs, unsigned long long seed)
+{
+    typedef struct SyntheticProcess
+    {
+        double baseKB;
+        double rssKB;
+        double leakKBs; // KB/s, 0 for no leak
+        double cpuBase;
+        int    burstSteps;
+
+    } SyntheticProcess;
+
+    SyntheticProcess  *processes = MH_CALLOC(processCount, sizeof(SyntheticProcess));
+    unsigned long long state     = seed ? seed : 1;
+
+    if (!processes) return -1;
+
+    for (int p = 0; p < processCount; p++)
+    {
+        SyntheticProcess *process = &processes[p];
+
+        process->baseKB  = 2048.0 + (NextTraceUniform(&state) * 200.0 * 1024.0);
+        process->rssKB   = process->baseKB;
+        process->leakKBs = (NextTraceUniform(&state) < 0.1) ? (50.0 + (NextTraceUniform(&state) * 2000.0)) : 0.0;
+        process->cpuBase = NextTraceUniform(&state) * 30.0;
+    }
+
+    int    stepCount   = (int)(((long long)seconds * 1000) / stepMs);
+    double stepSeconds = stepMs / 1000.0;
+
+    for (int step = 0; step < stepCount; step++)
+    {
+        for (int p = 0; p < processCount; p++)
+        {
+            SyntheticProcess *process = &processes[p];
+
+            process->rssKB += (process->leakKBs * stepSeconds) + ((NextTraceUniform(&state) - 0.5) * 0.02 * process->baseKB);
+            if (process->rssKB < (process->baseKB / 2)) process->rssKB = process->baseKB / 2;
+
+            // A leaker restarts somewhere past 4x its base
+            if ((process->leakKBs > 0) && (process->rssKB > (4 * process->baseKB)) && (NextTraceUniform(&state) < 0.05)) process->rssKB = process->baseKB;
+
+            if ((process->burstSteps == 0) && (NextTraceUniform(&state) < 0.01)) process->burstSteps = 1 + (int)(NextTraceUniform(&state) * 20);
+
+            float cpuPercent = (float)((process->burstSteps > 0) ? (80.0 + (NextTraceUniform(&state) * 20.0)) : (process->cpuBase * NextTraceUniform(&state)));
+            if (process->burstSteps > 0) process->burstSteps -= 1;
+
+            if (AddTraceSample(trace, (unsigned long long)step * stepMs, 1000 + p, (unsigned int)process->rssKB, cpuPercent) != 0)
+            {
+                MH_FREE(processes);
+                return -1;
+            }
+        }
+    }
+
+    MH_FREE(processes);
+
+    return 0;
+}
+
+
+// Run one policy over the whole trace. `processes`, `states` and `active`
+// are scratch of trace->processCount entries.
+static void SimulateTrace(const Trace *trace, const SimulatePolicy *policy, Process *processes, SimulateProcess *states, int *active, SimulateResult *result)
+{
+    unsigned long long stepMs      = (policy->refreshSeconds > 0.001f) ? (unsigned long long)(policy->refreshSeconds * 1000.0f) : 1;
+    double             stepSeconds = (double)stepMs / 1000.0;
+    unsigned long long endMs       = trace->samples[trace->sampleCount - 1].timeMs;
+    int                activeCount = 0;
+    int                next        = 0;
+
+    memset(states, 0, trace->processCount * sizeof(SimulateProcess));
+
+    for (int p = 0; p < trace->processCount; p++)
+    {
+        processes[p] = (Process){
+            .used         = true,
+            .pid          = trace->pids[p],
+            .memThreshold = policy->memThreshold,
+            .cpuThreshold = policy->cpuThreshold,
+            .holdAction   = HOLD_ACTION_COLD,
+            .holdTriggers = HOLD_TRIGGER_MEM,
+        };
+    }
+
+    // Past the end until the last samples are in, so every policy sees all of them
+    for (unsigned long long frameMs = trace->samples[0].timeMs; (frameMs <= endMs) || (next < trace->sampleCount); frameMs += stepMs)
+    {
+        // Everything sampled up to this frame: the ground truth
+        for (; (next < trace->sampleCount) && (trace->samples[next].timeMs <= frameMs); next++)
+        {
+            const TraceSample *sample = &trace->samples[next];
+            SimulateProcess   *state  = &states[sample->process];
+            bool               over   = (policy->memThreshold != MH_NO_LIMIT) && (sample->rssKB > policy->memThreshold);
+
+            if (!state->seen) active[activeCount++] = sample->process;
+            if (state->over) result->overMs += sample->timeMs - state->lastMs;
+
+            if (over && !state->over)
+            {
+                result->episodeCount += 1;
+                state->pending   = true;
+                state->episodeMs = sample->timeMs;
+            }
+            else if (!over && state->pending)
+            {
+                result->missedCount += 1;
+                state->pending = false;
+            }
+
+            state->seen       = true;
+            state->over       = over;
+            state->rssKB      = sample->rssKB;
+            state->cpuPercent = sample->cpuPercent;
+            state->lastMs     = sample->timeMs;
+        }
+
+        result->frameCount += 1;
+
+        // What RunMain() would have done with it
+        for (int a = 0; a < activeCount; a++)
+        {
+            int              p       = active[a];
+            Process         *process = &processes[p];
+            SimulateProcess *state   = &states[p];
+
+            if (frameMs > trace->lastMs[p]) // Exited
+            {
+                if (state->pending) result->missedCount += 1;
+                state->pending = false;
+                active[a--]    = active[--activeCount];
+                continue;
+            }
+
+            process->memGrowth  = process->primed ? (((double)state->rssKB - (double)process->memUsage) / stepSeconds) : 0.0;
+            process->memUsage   = state->rssKB;
+            process->cpuPercent = state->cpuPercent;
+            process->primed     = true;
+
+            Decision decision = DecideProcess(process);
+
+            process->overMem = decision.overMem;
+            process->overCpu = decision.overCpu;
+
+            if (!decision.hold) continue;
+
+            result->holdCount += 1;
+
+            if (state->pending)
+            {
+                RecordHistogram(&result->reactionMs, frameMs - state->episodeMs);
+                state->pending = false;
+            }
+        }
+    }
+
+    for (int a = 0; a < activeCount; a++)
+        if (states[active[a]].pending) result->missedCount += 1;
+}
+
+
+// Comma separated values of one swept parameter. Returns the count, or -1.
+static int ParseSimulateList(char *text, char kind, SimulatePolicy *values)
+{
+    char *savePtr = NULL;
+    int   count   = 0;
+
+    for (char *value = strtok_r(text, ",", &savePtr); value; value = strtok_r(NULL, ",", &savePtr))
+    {
+        if (count == MAX_SIMULATE_VALUES) return -1;
+
+        int error = 0;
+
+        if (kind == 'm') error = ParseRuleSize(value, &values[count].memThreshold);
+        else if (kind == 'c') error = ParseRulePercent(value, &values[count].cpuThreshold);
+        else error = ((values[count].refreshSeconds = strtof(value, NULL)) > 0) ? 0 : -1;
+
+        if (error != 0) return -1;
+        count += 1;
+    }
+
+    return (count > 0) ? count : -1;
+}
+
+
+static void LogSimulateResult(const SimulatePolicy *policy, const SimulateResult *result)
+{
+    char memText[32];
+    char cpuText[32];
+    char reactionText[96] = "reaction: -";
+
+    if (policy->memThreshold == MH_NO_LIMIT) snprintf(memText, sizeof(memText), "none");
+    else snprintf(memText, sizeof(memText), "%zuK", policy->memThreshold);
+
+    if (policy->cpuThreshold == MH_NO_LIMIT_CPU) snprintf(cpuText, sizeof(cpuText), "none");
+    else snprintf(cpuText, sizeof(cpuText), "%.2f%%", policy->cpuThreshold);
+
+    if (result->reactionMs.totalCount > 0)
+        snprintf(reactionText, sizeof(reactionText), "reaction p50: %.2fs  p99: %.2fs  max: %.2fs", GetHistogramPercentile(&result->reactionMs, 50.0) / 1e3,
+                 GetHistogramPercentile(&result->reactionMs, 99.0) / 1e3, result->reactionMs.maxValue / 1e3);
+
+    fprintf(stdout, "[ INFO ]  mem: %10s  cpu: %7s  refresh: %6.2fs  holds: %8llu  over: %10.1fs  episodes: %6llu  missed: %6llu  %s\n", memText, cpuText,
+            policy->refreshSeconds, result->holdCount, result->overMs / 1e3, result->episodeCount, result->missedCount, reactionText);
+}
+
+
+int RunSimulate(int argc, char *argv[])
+{
+    int                status        = 1;
+    const char        *traceFileName = NULL;
+    int                processCount  = 0;
+    int                seconds       = 0;
+    int                stepMs        = 1000;
+    unsigned long long seed          = 1;
+
+    SimulatePolicy mems[MAX_SIMULATE_VALUES]      = {{.memThreshold = MH_MEMORY_THRESHOLD}};
+    SimulatePolicy cpus[MAX_SIMULATE_VALUES]      = {{.cpuThreshold = 50.0f}};
+    SimulatePolicy refreshes[MAX_SIMULATE_VALUES] = {{.refreshSeconds = 2.0f}};
+    int            memCount                       = 1;
+    int            cpuCount                       = 1;
+    int            refreshCount                   = 1;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--synthetic=", 12) == 0)
+        {
+            if (sscanf(argv[i] + 12, "%d,%d,%d", &processCount, &seconds, &stepMs) < 2) processCount = 0;
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0) seed = strtoull(argv[i] + 7, NULL, 10);
+        else if (strncmp(argv[i], "--mem=", 6) == 0) memCount = ParseSimulateList(argv[i] + 6, 'm', mems);
+        else if (strncmp(argv[i], "--cpu=", 6) == 0) cpuCount = ParseSimulateList(argv[i] + 6, 'c', cpus);
+        else if (strncmp(argv[i], "--refresh=", 10) == 0) refreshCount = ParseSimulateList(argv[i] + 10, 'r', refreshes);
+        else if ((argv[i][0] != '-') || (strcmp(argv[i], "-") == 0)) traceFileName = argv[i];
+        else memCount = -1;
+    }
+
+    bool synthetic = (processCount > 0) && (seconds > 0) && (stepMs > 0);
+
+    if ((synthetic == (traceFileName != NULL)) || (memCount < 0) || (cpuCount < 0) || (refreshCount < 0))
+    {
+        fprintf(stderr, "Usage: memhold simulate <TRACE.csv|-> | --synthetic=PROCS,SECONDS[,STEP_MS] [--seed=N]\n");
+        fprintf(stderr, "                        [--mem=SIZE,...] [--cpu=PCT,...] [--refresh=SECONDS,...]\n");
+        return 1;
+    }
+
+    Trace            trace     = {0};
+    Process         *processes = NULL;
+    SimulateProcess *states    = NULL;
+    int             *active    = NULL;
+    SimulateResult  *result    = MH_MALLOC(sizeof(SimulateResult));
+
+    double loadBegin = BenchNowSeconds();
+
+    if (!result) goto simulateError;
+    if (synthetic ? (GenerateTrace(&trace, processCount, seconds, stepMs, seed) != 0) : (LoadTrace(traceFileName, &trace) != 0)) goto simulateError;
+
+    processes = MH_MALLOC(trace.processCount * sizeof(Process));
+    states    = MH_MALLOC(trace.processCount * sizeof(SimulateProcess));
+    active    = MH_MALLOC(trace.processCount * sizeof(int));
+
+    if (!processes || !states || !active) goto simulateError;
+
+    fprintf(stdout, "[ INFO ]  Trace: %d samples, %d processes, %.1fs (%s in %.2fs)\n", trace.sampleCount, trace.processCount,
+            (trace.samples[trace.sampleCount - 1].timeMs - trace.samples[0].timeMs) / 1e3, synthetic ? "generated" : "loaded", BenchNowSeconds() - loadBegin);
+
+    int    policyCount = memCount * cpuCount * refreshCount;
+    double runBegin    = BenchNowSeconds();
+
+    for (int m = 0; m < memCount; m++)
+    {
+        for (int c = 0; c < cpuCount; c++)
+        {
+            for (int r = 0; r < refreshCount; r++)
+            {
+                SimulatePolicy policy = {
+                    .memThreshold   = mems[m].memThreshold,
+                    .cpuThreshold   = cpus[c].cpuThreshold,
+                    .refreshSeconds = refreshes[r].refreshSeconds,
+                };
+
+                memset(result, 0, sizeof(SimulateResult));
+                SimulateTrace(&trace, &policy, processes, states, active, result);
+                LogSimulateResult(&policy, result);
+            }
+        }
+    }
+
+    double runSeconds = BenchNowSeconds() - runBegin;
+    double sampleRate = (double)trace.sampleCount * policyCount / ((runSeconds > 0) ? runSeconds : 1e-9);
+
+    fprintf(stdout, "[ INFO ]  Simulated %d policies in %.2fs (%.1fM samples/s)\n", policyCount, runSeconds, sampleRate / 1e6);
+
+    status = 0;
+
+simulateError:
+
+    if (status != 0) fprintf(stderr, "[ ERR! ]  simulate failed\n");
+
+    MH_FREE(active);
+    MH_FREE(states);
+    MH_FREE(processes);
+    MH_FREE(result);
+    UnloadTrace(&trace);
+
+    return status;
+}
+
+
+// Main entry point of the program.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <PID>... | --all [--rules=FILE] [--verbose] [--threads[=K]] [--backend=procfs|uring|taskstats] [--workers=N] [--top=N] [--pressure=PCT|none] [--thrash=PAGES|none] [--oom] [--wss[=SECONDS]] [--format=text|jsonl|csv] [--pipeline]\n", argv[0]);
+        fprintf(stderr, "       %s bench backends <PID> [SAMPLES]\n", argv[0]);
+        fprintf(stderr, "       %s bench threads [THREADS] [ROUNDS]\n", argv[0]);
+        fprintf(stderr, "       %s bench workers [WORKERS] [PIDS] [FRAMES]\n", argv[0]);
+        fprintf(stderr, "       %s bench uring [PIDS] [FRAMES]\n", argv[0]);
+        fprintf(stderr, "       %s bench status [ROUNDS]\n", argv[0]);
+        fprintf(stderr, "       %s bench rank [FRAMES]\n", argv[0]);
+        fprintf(stderr, "       %s simulate <TRACE.csv|-> | --synthetic=PROCS,SECONDS[,STEP_MS] [--mem=SIZE,...] [--cpu=PCT,...] [--refresh=SECONDS,...]\n", argv[0]);
+        exit(1);
+    }
+
+    // Subcommands
+    //----------------------------------------------------------------------------------
+    if (strcmp(argv[1], "bench") == 0) return RunBench(argc - 2, argv + 2);
+    if (strcmp(argv[1], "simulate") == 0) return RunSimulate(argc - 2, argv + 2);
+    //----------------------------------------------------------------------------------
+
+
+    // Declare main functions scoped variables
+    //----------------------------------------------------------------------------------
+    int status;
+    //----------------------------------------------------------------------------------
+
+
+    // Parse args and ensure a valid process PID is passed.
+    //----------------------------------------------------------------------------------
+    if (!(argc < 2))
+    {
+        int droppedPIDCount = 0;
+
+        for (int i = 1; i < argc; i++)
+        {
+            // Convert <PID> (stdout of `$ pgrep lua`) to pid_t i.e. alias of integer.
+            if ((argv[i][0] >= '0') && (argv[i][0] <= '9'))
+            {
+                if (gProcPIDCount < MAX_USER_PIDS) gProcPIDs[gProcPIDCount++] = (pid_t)(atoi(argv[i]));
+                else droppedPIDCount += 1;
+            }
+            else if (strcmp(argv[i], "--verbose") == 0) { gVerbose = true; }
+            else if (strcmp(argv[i], "--all") == 0) { gFlagAll = true; }
+            else if (strncmp(argv[i], "--rules=", 8) == 0) { gRulesFileName = argv[i] + 8; }
+            else if (strcmp(argv[i], "--threads") == 0) { gThreadTopK = MH_THREAD_TOP_K; }
+            else if (strncmp(argv[i], "--threads=", 10) == 0) { gThreadTopK = atoi(argv[i] + 10); }
+            else if (strcmp(argv[i], "--backend=taskstats") == 0) { gSampleBackend = SAMPLE_BACKEND_TASKSTATS; }
+            else if (strcmp(argv[i], "--backend=procfs") == 0) { gSampleBackend = SAMPLE_BACKEND_PROCFS; }
+            else if (strcmp(argv[i], "--backend=uring") == 0) { gSampleBackend = SAMPLE_BACKEND_URING; }
+            else if (strncmp(argv[i], "--workers=", 10) == 0) { gWorkerCount = atoi(argv[i] + 10); }
+            else if (strncmp(argv[i], "--top=", 6) == 0) { gTopN = atoi(argv[i] + 6); }
+            else if (strcmp(argv[i], "--format=text") == 0) { gOutputFormat = OUTPUT_FORMAT_TEXT; }
+            else if (strcmp(argv[i], "--format=jsonl") == 0) { gOutputFormat = OUTPUT_FORMAT_JSONL; }
+            else if (strcmp(argv[i], "--format=csv") == 0) { gOutputFormat = OUTPUT_FORMAT_CSV; }
+            else if (strcmp(argv[i], "--pressure=none") == 0) { gPressureThreshold = MH_NO_LIMIT_CPU; }
+            else if (strncmp(argv[i], "--pressure=", 11) == 0) { gPressureThreshold = strtof(argv[i] + 11, NULL); }
+            else if (strcmp(argv[i], "--oom") == 0) { gOomPolicy = OOM_POLICY_STEER; }
+            else if (strcmp(argv[i], "--pipeline") == 0) { gPipeline = true; }
+            else if (strcmp(argv[i], "--wss") == 0) { gWorkingSetSeconds = 10.0f; }
+            else if (strncmp(argv[i], "--wss=", 6) == 0) { gWorkingSetSeconds = strtof(argv[i] + 6, NULL); }
+            else if (strcmp(argv[i], "--thrash=none") == 0) { gThrashThreshold = MH_NO_LIMIT_CPU; }
+            else if (strncmp(argv[i], "--thrash=", 9) == 0) { gThrashThreshold = strtof(argv[i] + 9, NULL); }
+        }
+
+        if (gThreadTopK > MAX_THREAD_TOP_K) gThreadTopK = MAX_THREAD_TOP_K;
+        if (gWorkerCount < 1) gWorkerCount = 1;
+        if (gWorkerCount > MAX_SAMPLER_WORKERS) gWorkerCount = MAX_SAMPLER_WORKERS;
+        if (gTopN < 0) gTopN = 0;
+        if (gTopN > MAX_RANK_TOP_N) gTopN = MAX_RANK_TOP_N;
+
+        if (droppedPIDCount > 0) fprintf(stderr, "[ WARN ]  Only the first %d PIDs are monitored, %d ignored\n", MAX_USER_PIDS, droppedPIDCount);
+    }
+
+    gProcPID = (gProcPIDCount > 0) ? gProcPIDs[0] : -1;
+
+    // <<<<<<< HOW TO FIGURE OUT WHAT A VALID PID IS???? >>>>>>
+    // If is invalid (not a number or integer.) then
+    if (!(gProcPID > 0) && !gFlagAll)
+    {
+        fprintf(stderr, "Usage: %s <PID>... | --all\n", argv[0]);
+        fprintf(stderr, "expected valid PID. For example: 105815\n. got: %i", gProcPID);
+        status = 1;
+        goto cleanupError; // Bail out on invalid pid
+    }
+    //----------------------------------------------------------------------------------
+
+
+    // Records take stdout (`--format=jsonl|csv`), everything else goes to stderr
+    //----------------------------------------------------------------------------------
+    if (OpenRecordWriter(&gRecordWriter, gOutputFormat) != 0)
+    {
+        fprintf(stderr, "[ ERR! ]  failed to open stdout for records: %s\n", strerror(errno));
+        gOutputFormat = OUTPUT_FORMAT_TEXT;
+    }
+    //----------------------------------------------------------------------------------
+
+
+    // Write stdout program name and version
+    //----------------------------------------------------------------------------------
+    fprintf(stdout, "%s %s\n", MEMHOLD_ID, MEMHOLD_VERSION);
+
+    if (gVerbose)
+    {
+        fprintf(stdout, "\n[ INFO ]  <<< Stage 1: Initialize program >>>\n\n");
+        {
+            fprintf(stdout, "[ INFO ]  ");
+            for (int i = 0; i < argc; i++)
+                fprintf(stdout, "%s ", argv[i]);
+            fprintf(stdout, "\n");
+        }
+        fprintf(stdout, "[ INFO ]  Verbose: %s\n", gVerbose ? "true" : "false");
+    }
+    //----------------------------------------------------------------------------------
+
+
+    // Initialize module
+    //----------------------------------------------------------------------------------
+    status = Init();
+
+    if (status != 0)
+    {
+        fprintf(stderr, "[ ERR! ]  failed to initialize module\n");
+
+        goto cleanupError;
+    }
+    //----------------------------------------------------------------------------------
+
+    // Begin memhold hot loop.
+    //----------------------------------------------------------------------------------
+    status = RunMain();
+
+    CloseRecordWriter(&gRecordWriter);
+    //----------------------------------------------------------------------------------
+
+cleanupError:
+
+    return status; // EXIT_SUCCESS
+}
+
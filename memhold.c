@@ -1,158 +1,129 @@
 
-/*file: main.c*************************************************************************************
+/*file: memhold.c**********************************************************************************
  *
  *
- *  memhold 0.1
+ *  libmemhold 0.1
  *
  *
- *  20240704144247UTC
- *      ==48754== Command: ./memhold 2007
- *      [ INFO ]  took 8.00s
- *      ==48754== HEAP SUMMARY:
- *      ==48754==     in use at exit: 0 bytes in 0 blocks
- *      ==48754==   total heap usage: 9 allocs, 9 frees, 7,008 bytes allocated
- *      ==48754== All heap blocks were freed -- no leaks are possible
- *      ==48754== ERROR SUMMARY: 0 errors from 0 contexts (suppressed: 0 from 0)
+ *  Process sampling behind the memhold CLI (see main.c). Reads /proc, taskstats
+ *  and advises memory through pidfds. No global state and no stdout: errors are
+ *  returned (-1 or -errno) and every call fills caller-provided structs.
  *
- *      ==46954== Command: ./memhold 2007
- *      [ INFO ]  took 8.00s
- *      ==46954== I refs:        285,880
+ *  Build: ~
+ *    + make libmemhold.a
+ *    + make libmemhold.so
  *
  *
  *************************************************************************************************/
 
-#include "memhold.h" // Declares module functions
-
-
-#include <assert.h> // Required for: assert()
-#include <signal.h>
-#include <stdio.h>  // Required for: printf(), fprintf(), sprintf(), stderr, stdout, popen() [with compiler option `-pthread`]
-#include <stdlib.h> // Required for: atoi(), exit()
-#include <string.h> // Required for: strcmp(), NULL
-#include <sys/wait.h>
-#include <time.h>   // Required for: clock(), [time() ~ not used]
-#include <unistd.h> // Required for: fork(), getpid(), sleep(),... [UNIX only lib]
-
+#define _GNU_SOURCE // Required for: recvmmsg(), struct mmsghdr
 
-//-----------------------------------------------------------------------------
-// Debug Flags (set in build step)
-//-----------------------------------------------------------------------------
+#include "memhold.h" // Declares module functions
 
-// Debugging: ~ + MEMHOLD_SLOW = 0 --> fast code + MEMHOLD_SLOW = 1 --> slow code: See in "./Makefile": ~ + DFLAGS = -DMEMHOLD_SLOW=0
-#if defined(MEMHOLD_SLOW)
-    #define MEMHOLD_SLOW = 0
 
+#include <dirent.h> // Required for: opendir(), readdir(), rewinddir() - Only used by ThreadSampler
+#include <errno.h>  // Required for: errno, ENOENT, ESRCH
+#include <fcntl.h>  // Required for: open(), O_RDONLY, O_CLOEXEC
+#include <limits.h> // Required for: INT_MAX
+#include <pthread.h> // Required for: pthread_create(), pthread_barrier_wait() - Only used by SamplerPool
+#include <signal.h>    // Required for: sigfillset(), pthread_sigmask() - Only used by SamplerPool
+#include <stdatomic.h> // Required for: atomic_compare_exchange_weak() - Only used by SamplerPool, ProcReader and RecordRing
+#include <stdio.h>  // Required for: snprintf()
+#include <stdlib.h> // Required for: malloc(), free(), strtol(), strtof()
+#include <string.h> // Required for: memcpy(), memchr(), strstr()
+#include <sys/mman.h>    // Required for: MADV_COLD, MADV_PAGEOUT, mmap() - Only used by soft holds and ProcReader
+#include <sys/resource.h> // Required for: prlimit(), RLIMIT_AS, RLIM_INFINITY - Only used by SetProcLimit()
+#include <sys/socket.h>  // Required for: socket(), sendmsg(), recvmmsg() - Only used by taskstats backend
+#include <sys/syscall.h> // Required for: SYS_pidfd_open, SYS_process_madvise, SYS_io_uring_* - Only used by soft holds and ProcReader
+#include <sys/uio.h>     // Required for: struct iovec - Only used by soft holds and ProcReader
+#include <time.h>   // Required for: clock_gettime()
+#include <unistd.h> // Required for: read(), pread(), pwrite(), close(), sysconf()
+
+#if defined(__SSE2__)
+    #include <emmintrin.h> // Required for: _mm_cmpeq_epi8(), _mm_movemask_epi8() - Only used by ParseProcStatus()
 #endif
-
-// For when we want to enjoy dabbling with xy problems, code golfing, busy work, and procrastination.
-#if defined(MEMHOLD_YAGNI)
-    #define MEMHOLD_YAGNI = 0
-
+#if defined(__AVX2__)
+    #include <immintrin.h> // Required for: _mm256_shuffle_epi8(), _mm512_popcnt_epi64() - Only used by SampleWorkingSet()
 #endif
 
-
-//-----------------------------------------------------------------------------
-// Macros and Defines
-//-----------------------------------------------------------------------------
-
-// clang-format off
-#define COLOR_INFO    CLITERAL(Color) { 102, 191, 255, 255 }   // Sky Blue
-#define COLOR_WARN    CLITERAL(Color) { 255, 161, 0, 255 }     // Orange
-#define COLOR_ERROR   CLITERAL(Color) { 230, 41, 55, 255 }     // Red
-#define COLOR_SUCCESS CLITERAL(Color) { 0, 228, 48, 255 }      // Green
-// clang-format on
+#include <linux/acct.h>      // Required for: AGROUP
+#include <linux/futex.h>     // Required for: FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE - Only used by RecordRing
+#include <linux/genetlink.h> // Required for: struct genlmsghdr, CTRL_CMD_GETFAMILY
+#include <linux/io_uring.h>  // Required for: struct io_uring_sqe, IORING_OP_READ_FIXED - Only used by ProcReader
+#include <linux/netlink.h>   // Required for: struct nlmsghdr, struct nlattr, NETLINK_GENERIC
+#include <linux/taskstats.h> // Required for: struct taskstats, TASKSTATS_CMD_GET
 
 
 //-----------------------------------------------------------------------------
 // Some constants
 //-----------------------------------------------------------------------------
 
-// 2s refresh cycle per loop
-static const int MAX_HOT_LOOP_COUNT = (1 << 8); //> `256 (0x100)` (1 << 8)
-
-// Limit fopen for file at path: `char path[256]; snprintf(path, sizeof(path), "/proc/%d/status", pid);`
-static const int MAX_RETRIES_FILE_NOT_FOUND = (1 << 3); //> `8 (0x100)` (1 << 3)
-
-
-//-----------------------------------------------------------------------------
-// DATA STRUCTURESSSSS
-//-----------------------------------------------------------------------------
-
-typedef struct Memhold
-{
-    bool flagLog;
-    bool flagVerbose;
-
-    const char *apiID;
-    char       *apiVersion;
-
-    float refreshSeconds;
-
-    float  cpuThreshold;
-    size_t memThreshold;
+// Regions per process_madvise() call. The kernel accepts up to UIO_MAXIOV (1024)
+#define MAX_RECLAIM_IOVECS (1 << 8) //> `256 (0x100)` (1 << 8)
 
-    pid_t userProcessPID;
-    pid_t memholdMainProcessPID;
+// Entries per /proc/<pid>/pagemap pread() (32K)
+#define PAGEMAP_BATCH (1 << 12) //> `4096 (0x1000)` (1 << 12)
 
-} Memhold;
+// Words per page_idle bitmap pread()/pwrite() (32K, 256K pages)
+#define IDLE_RUN_WORDS (1 << 12) //> `4096 (0x1000)` (1 << 12)
 
-//-----------------------------------------------------------------------------
-// Global variables
-//-----------------------------------------------------------------------------
-// TODO: All declared global variables, must be initialized. Even if it is 0 again.
+// Words between two of our page frames still read in the same run
+#define IDLE_RUN_GAP (1 << 3) //> `8 (0x8)` (1 << 3)
 
-Memhold memhold = {0};
+// pagemap entry bits (see https://docs.kernel.org/admin-guide/mm/pagemap.html)
+#define PAGEMAP_PRESENT  (1ULL << 63)
+#define PAGEMAP_PFN_MASK ((1ULL << 55) - 1)
 
-bool  gVerbose; //@Temp
-pid_t gProcPID;
-
-static int cntrFopenRetries = 0;
 
 //-----------------------------------------------------------------------------
-// FUNCTIONSSSS
+// DATA STRUCTURESSSSS
 //-----------------------------------------------------------------------------
 
-MHAPI Memhold InitMemhold(void);
-
-MHAPI Memhold InitMemhold(void)
+// Read-only after CreateMemholdContext(), so one context may serve many
+// threads. The sample plan changes between frames only (SetSamplePlan()).
+struct MemholdContext
 {
-    Memhold result = {};
-
-    result = (Memhold){
-        .flagLog     = true,     // TODO(Lloyd): Override via CLI args
-        .flagVerbose = gVerbose, // TODO(Lloyd): Override via CLI args
+    long   clockTicks; // sysconf(_SC_CLK_TCK)
+    double nsPerTick;
+    long   pageSizeKB;
 
-        .apiID      = MEMHOLD_ID,
-        .apiVersion = MEMHOLD_VERSION,
-
-        .refreshSeconds = 2.0f,
+    SamplePlan samplePlan; // Of SampleProcesses(), pools and readers
+};
 
-        .cpuThreshold = 50.0f,
-        .memThreshold = MH_MEMORY_THRESHOLD, //>10240kb Max: 500000kb
+// One worker of a SamplerPool, on its own cache line
+typedef struct SamplerWorker
+{
+    _Alignas(64) _Atomic unsigned long long deque; // Chunk range: head << 32 | tail
 
-        .userProcessPID        = gProcPID,
-        .memholdMainProcessPID = 0,
-    };
+    struct SamplerPool *pool;
+    int                 sampledCount; // Last frame
+    int                 stolenCount;  // Last frame
 
-    return result;
-}
+    SampleTimings timings; // Written by this worker only
 
-int Init(void);
+} SamplerWorker;
 
-int Init(void)
+struct SamplerPool
 {
-    int status = -1; // SUCCESS
-
-    cntrFopenRetries = 0;
-    memhold          = InitMemhold();
-    {
-        memhold.memholdMainProcessPID = getpid();
-    }
-    status = 0;
-
-    return status;
+    const MemholdContext *context;
+    int                   workerCount; // Worker 0 is the calling thread
+    SamplerWorker        *workers;
+    pthread_t            *threads;
+
+    pthread_mutex_t   startLock; // Only taken to start a frame, never while sampling
+    pthread_cond_t    startCond;
+    unsigned int      frame;
+    bool              stopping;
+    pthread_barrier_t frameDone;
+
+    // The current frame
+    const pid_t   *pids;
+    int            count;
+    ProcessSample *samples;
+    int           *results;
 };
 
+
 /* 1.14. /proc
 
 Linux Filesystem Hierarchy:
@@ -229,573 +200,3083 @@ v
 1/54 H 2024-07-07 12:12 dr-xr-xr-x 0B
 */
 
+
 //-----------------------------------------------------------------------------
-// Module specific function declarations
+// Histograms
 //-----------------------------------------------------------------------------
+//
+// Bucket i covers one 1/32nd slice of a power of two: values under 32 get a
+// bucket each, then every [2^e, 2^(e+1)) is split into 32 equal buckets.
+// So any value is off by at most ~3%, whatever its magnitude.
+
+static int GetHistogramBucket(unsigned long long value)
+{
+    const unsigned long long subCount = 1ull << MH_HISTOGRAM_SUB_BITS;
 
-int RunMain(void);
+    if (value < subCount) return (int)value;
 
-MHAPI long GetCpuUsage(pid_t pid);
-MHAPI long GetMemUsage(pid_t pid);
-MHAPI long GetSystemUptimeSec(pid_t pid);
+    int exponent = 63 - __builtin_clzll(value);
 
-MHAPI void LogProcLimits(pid_t pid);
-MHAPI void NoOp(void); // Placeholder function that does nothing.
+    if (exponent >= MH_HISTOGRAM_MAX_BITS) return MH_HISTOGRAM_BUCKETS - 1;
 
+    int group = exponent - MH_HISTOGRAM_SUB_BITS + 1;
 
-#if MEMHOLD_YAGNI
-MHAPI void PanicUnimplemented(void);
-#endif /* if MEMHOLD_YAGNI */
+    return (group << MH_HISTOGRAM_SUB_BITS) + (int)((value >> (exponent - MH_HISTOGRAM_SUB_BITS)) - subCount);
+}
 
 
-//-----------------------------------------------------------------------------
-// Module specific function implementations
-//-----------------------------------------------------------------------------
+// Highest value that lands in `bucket`
+static unsigned long long GetHistogramBucketTop(int bucket)
+{
+    const unsigned long long subCount = 1ull << MH_HISTOGRAM_SUB_BITS;
 
-MHAPI void NoOp(void) {}
+    int                group = bucket >> MH_HISTOGRAM_SUB_BITS;
+    unsigned long long sub   = (unsigned long long)bucket & (subCount - 1);
 
+    if (group == 0) return sub;
 
-// See also: ~
-//   - snprintf(path, sizeof(path), "/proc/%d/status", pid);
-//     /proc/[pid]/status:
-//       While primarily used for memory information, it does contain some CPU-related fields:
-//
-//       Threads: Number of threads in the process
-//       voluntary_ctxt_switches and nonvoluntary_ctxt_switches: Context switch counts
-//
-MHAPI void LogProcLimits(pid_t pid)
+    return ((subCount + sub + 1) << (group - 1)) - 1;
+}
+
+
+MHAPI void RecordHistogram(Histogram *histogram, unsigned long long value)
 {
-    long status = -1;
+    histogram->counts[GetHistogramBucket(value)] += 1;
+    histogram->totalCount += 1;
+    if (value > histogram->maxValue) histogram->maxValue = value;
+}
 
-    // /proc
-    // NOTE: The file doesn't actually contain any data; it just acts as a
-    // pointer to where the actual process information resides.
-    // See https://tldp.org/LDP/Linux-Filesystem-Hierarchy/html/proc.html
-    char path[256];
-    snprintf(path, sizeof(path), "/proc/%d/limits", pid);  // Choices: cpuset
-                                                           //
-    fprintf(stdout, "[ INFO ]  PID: %d  %s\n", pid, path); //> path = /proc/2014/cpuset
 
-    // The file doesn't actually contain any data; it just acts as a pointer to
-    // where the actual process information resides.
-    FILE *fp = fopen(path, "r"); //> stream or NULL
+MHAPI void MergeHistogram(Histogram *histogram, const Histogram *other)
+{
+    for (int bucket = 0; bucket < MH_HISTOGRAM_BUCKETS; bucket++)
+        histogram->counts[bucket] += other->counts[bucket];
 
-    if (!fp)
-    {
-        fprintf(stderr, "[ ERR! ]  failed to open status file. file: %p\n", fp);
-        status = -1;
-        goto ioError;
-    }
+    histogram->totalCount += other->totalCount;
+    if (other->maxValue > histogram->maxValue) histogram->maxValue = other->maxValue;
+}
+
+
+// Top of the bucket holding the `percentile`th count, never above the exact
+// max. 0 when nothing was recorded.
+MHAPI unsigned long long GetHistogramPercentile(const Histogram *histogram, double percentile)
+{
+    if (histogram->totalCount == 0) return 0;
+
+    unsigned long long rank = (unsigned long long)((percentile / 100.0) * (double)histogram->totalCount + 0.5);
+    unsigned long long seen = 0;
 
-    char line[356];
-    int  lineCount = 0;
+    if (rank < 1) rank = 1;
 
-    while (fgets(line, sizeof(line), fp))
+    for (int bucket = 0; bucket < MH_HISTOGRAM_BUCKETS; bucket++)
     {
-        if (memhold.flagVerbose)
+        seen += histogram->counts[bucket];
+
+        if (seen >= rank)
         {
-            lineCount += 1;
-            fprintf(stdout, "[ INFO ]  PID: %d  \t| %2d ~ %s", pid, lineCount, line);
+            unsigned long long top = GetHistogramBucketTop(bucket);
+            return (top < histogram->maxValue) ? top : histogram->maxValue;
         }
     }
 
-    status = fclose(fp);
+    return histogram->maxValue;
+}
+
 
-    if ((status != 0))
-    {
-        perror("[ !ERR ]  failed to close status file");
-        goto ioError;
-    }
+MHAPI unsigned long long GetMonotonicNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((unsigned long long)now.tv_sec * 1000000000ull) + (unsigned long long)now.tv_nsec;
+}
 
-    return;
 
-ioError:
+//-----------------------------------------------------------------------------
+// Context and process samples
+//-----------------------------------------------------------------------------
+
+MHAPI MemholdContext *CreateMemholdContext(void)
+{
+    MemholdContext *context = MH_CALLOC(1, sizeof(MemholdContext));
 
-    return;
+    if (!context) return NULL;
+
+    context->clockTicks = sysconf(_SC_CLK_TCK);
+    context->nsPerTick  = 1e9 / context->clockTicks;
+    context->pageSizeKB = sysconf(_SC_PAGESIZE) / 1024;
+    context->samplePlan = SAMPLE_PLAN_STAT_ALL;
+
+    return context;
 }
 
 
-MHAPI long GetSystemUptimeSec(pid_t pid)
+MHAPI void DestroyMemholdContext(MemholdContext *context) { MH_FREE(context); }
+
+
+#if MEMHOLD_SAMPLE_GENERIC
+static void FillProcessSample(const MemholdContext *context, pid_t pid, const ProcStat *procStat, ProcessSample *sample)
 {
-    long status = -1;
+    *sample = (ProcessSample){
+        .pid        = pid,
+        .state      = procStat->state,
+        .starttime  = procStat->starttime,
+        .cpuTimeNs  = (unsigned long long)((procStat->utime + procStat->stime) * context->nsPerTick),
+        .minflt     = procStat->minflt,
+        .majflt     = procStat->majflt,
+        .numThreads = procStat->numThreads,
+        .vsizeKB    = procStat->vsize / 1024,
+        .rssKB      = (procStat->rss > 0) ? (size_t)procStat->rss * context->pageSizeKB : 0,
+    };
+    memcpy(sample->comm, procStat->comm, sizeof(sample->comm));
+}
+#endif /* if MEMHOLD_SAMPLE_GENERIC */
+
+
+// Parse a /proc/<pid>/stat (or statm) buffer into the `fields` of `sample`.
+// Inlined with constant `statm` and `fields` into one parser per sample
+// plan, so each skips the conversions (and the comm copy) it does not need
+// and stops after its last field.
+static inline __attribute__((always_inline)) int ParseSampleFields(const MemholdContext *context, const char *buf, int bufLen, bool statm,
+                                                                   unsigned int fields, ProcessSample *sample)
+{
+    const char *end = buf + bufLen;
+
+    // statm: "size resident shared text lib data dt", in pages
+    //----------------------------------------------------------------------------------
+    if (statm)
+    {
+        const char        *p          = buf;
+        unsigned long long values[2]  = {0};
+        int                valueCount = (fields & SAMPLE_FIELD_RSS) ? 2 : 1;
+
+        for (int i = 0; i < valueCount; i++)
+        {
+            if ((p >= end) || (*p < '0') || (*p > '9')) return -1;
 
-    long systemUptime = -1;
+            while ((p < end) && (*p >= '0') && (*p <= '9'))
+            {
+                values[i] = (values[i] * 10) + (unsigned long long)(*p - '0');
+                p++;
+            }
+            p++; // ' '
+        }
 
-    /*
-    $ cat /proc/uptime
-    6644.50 23980.38
-    $ tr . ' ' </proc/uptime | awk '{print $1}'
-    6667
-    */
+        if (fields & SAMPLE_FIELD_VSIZE) sample->vsizeKB = (size_t)values[0] * context->pageSizeKB;
+        if (fields & SAMPLE_FIELD_RSS) sample->rssKB = (size_t)values[1] * context->pageSizeKB;
 
-    FILE *fp = fopen("/proc/uptime", "r");
+        return 0;
+    }
+    //----------------------------------------------------------------------------------
 
-    if (!fp)
+    // stat: see ParseProcStat(), from the last ')' up to the last field of the plan
+    //----------------------------------------------------------------------------------
+    const int lastIndex = (fields & SAMPLE_FIELD_RSS)        ? PROCESS_STAT_RSS_INDEX
+                          : (fields & SAMPLE_FIELD_VSIZE)    ? PROCESS_STAT_VSIZE_INDEX
+                          : (fields & SAMPLE_FIELD_IDENTITY) ? PROCESS_STAT_STARTTIME_INDEX
+                          : (fields & SAMPLE_FIELD_THREADS)  ? PROCESS_STAT_NUM_THREADS_INDEX
+                          : (fields & SAMPLE_FIELD_CPU)      ? PROCESS_STAT_STIME_INDEX
+                          : (fields & SAMPLE_FIELD_FAULTS)   ? PROCESS_STAT_MAJFLT_INDEX
+                                                             : PROCESS_STAT_STATE_INDEX;
+
+    const char *commBegin = memchr(buf, '(', bufLen);
+    const char *commEnd   = NULL;
+
+    for (const char *p = end - 1; p > buf; p--)
     {
-        fprintf(stderr, "[ ERR! ]  failed to open status file. file: %p\n", fp);
-        status = -1;
-        goto ioError; // Bail out when file pointer fails to open
+        if (*p == ')')
+        {
+            commEnd = p;
+            break;
+        }
     }
 
-    char line[356];
-    int  lineCount = 0;
+    if (!commBegin || !commEnd || (commEnd < commBegin) || ((commEnd + 2) >= end)) return -1;
 
-    // while (fgets(line, sizeof(line), fp))
-    // {
-    //     printf("line = %s\n", line);
-    // }
+    if (fields & SAMPLE_FIELD_IDENTITY)
+    {
+        int commLen = (int)(commEnd - commBegin - 1);
+        if (commLen >= MH_COMM_LEN) commLen = MH_COMM_LEN - 1;
+        memcpy(sample->comm, commBegin + 1, commLen);
+        sample->comm[commLen] = '\0';
+        sample->state         = commEnd[2];
+    }
 
+    const char        *p          = commEnd + 2; // Skip ") "
+    int                fieldIndex = PROCESS_STAT_STATE_INDEX;
+    unsigned long long cpuTicks   = 0;
 
-    long tmpfieldNext = -1;
+    while ((p < end) && (fieldIndex < lastIndex))
+    {
+        while ((p < end) && (*p != ' '))
+            p++;
+        p++;
+        fieldIndex += 1;
 
-    fscanf(fp, "%lu %lu", &systemUptime, &tmpfieldNext);
-    fclose(fp);
+        if (p >= end) break;
 
+        bool               negative = (*p == '-');
+        unsigned long long value    = 0;
 
+        if (negative) p++;
 
-    return systemUptime;
+        while ((p < end) && (*p >= '0') && (*p <= '9'))
+        {
+            value = (value * 10) + (unsigned long long)(*p - '0');
+            p++;
+        }
 
-ioError:
+        switch (fieldIndex)
+        {
+        case PROCESS_STAT_MINFLT_INDEX:
+            if (fields & SAMPLE_FIELD_FAULTS) sample->minflt = (unsigned long)value;
+            break;
+        case PROCESS_STAT_MAJFLT_INDEX:
+            if (fields & SAMPLE_FIELD_FAULTS) sample->majflt = (unsigned long)value;
+            break;
+        case PROCESS_STAT_UTIME_INDEX:
+        case PROCESS_STAT_STIME_INDEX:
+            if (fields & SAMPLE_FIELD_CPU) cpuTicks += value;
+            break;
+        case PROCESS_STAT_NUM_THREADS_INDEX:
+            if (fields & SAMPLE_FIELD_THREADS) sample->numThreads = negative ? -(long)value : (long)value;
+            break;
+        case PROCESS_STAT_STARTTIME_INDEX:
+            if (fields & SAMPLE_FIELD_IDENTITY) sample->starttime = value;
+            break;
+        case PROCESS_STAT_VSIZE_INDEX:
+            if (fields & SAMPLE_FIELD_VSIZE) sample->vsizeKB = (size_t)(value / 1024);
+            break;
+        case PROCESS_STAT_RSS_INDEX:
+            if (fields & SAMPLE_FIELD_RSS) sample->rssKB = negative ? 0 : (size_t)value * context->pageSizeKB;
+            break;
+        default: break;
+        }
+    }
 
-    return status;
+    if (fields & SAMPLE_FIELD_CPU) sample->cpuTimeNs = (unsigned long long)(cpuTicks * context->nsPerTick);
+
+    return (fieldIndex == lastIndex) ? 0 : -1;
+    //----------------------------------------------------------------------------------
 }
 
 
-// /proc/[pid]/stat:
-// This file contains more detailed CPU usage data. The relevant fields are: ~
-//   - utime: User mode CPU time
-//   - stime: Kernel mode CPU time
-//
-// Note: ~
-//   - For processes using popen use: ~ "ps -p %d -o %%cpu --no-headers"
-MHAPI long GetCpuUsage(pid_t pid)
-{
+typedef int (*SampleParser)(const MemholdContext *context, const char *buf, int bufLen, ProcessSample *sample);
 
-    long status = -1;
-    //
-    char path[256];
-    snprintf(path, sizeof(path), "/proc/%d/stat", pid); // "/proc/%d/stat" is
+// One parser per MH_SAMPLE_PLANS entry
+#define MH_SAMPLE_PLAN_PARSER(plan, file, fields)                                                                    \
+    static int ParseSample_##plan(const MemholdContext *context, const char *buf, int bufLen, ProcessSample *sample) \
+    {                                                                                                                \
+        return ParseSampleFields(context, buf, bufLen, sizeof(file) == sizeof("statm"), (fields), sample);           \
+    }
+MH_SAMPLE_PLANS(MH_SAMPLE_PLAN_PARSER)
+#undef MH_SAMPLE_PLAN_PARSER
 
-    // The file doesn't actually contain any data; it just acts as a pointer to
-    // where the actual process information resides.
-    FILE *fp = fopen(path, "r"); //> stream or NULL
+typedef struct SamplePlanInfo
+{
+    const char  *file; // Under /proc/<pid>/
+    unsigned int fields;
+    SampleParser parse;
 
-    if (!fp)
-    {
-        fprintf(stderr, "[ ERR! ]  failed to open status file. file: %p\n", fp);
-        status = -1;
-        goto ioError; // Bail out
-    }
+} SamplePlanInfo;
 
+static const SamplePlanInfo gSamplePlans[SAMPLE_PLAN_COUNT] = {
+#define MH_SAMPLE_PLAN_INFO(plan, file, fields) [plan] = {file, (fields), ParseSample_##plan},
+    MH_SAMPLE_PLANS(MH_SAMPLE_PLAN_INFO)
+#undef MH_SAMPLE_PLAN_INFO
+};
 
-    const long CLOCK_TICKS = sysconf(_SC_CLK_TCK); // Repeated again. it's okay ^_^
 
-    long                   cpuUsage         = -1; // Result
-    unsigned long long int processUtime     = 0;
-    unsigned long long int processStime     = 0;
-    long long              processStarttime = 0;
+MHAPI SamplePlan SelectSamplePlan(unsigned int fieldMask)
+{
+#if !MEMHOLD_SAMPLE_GENERIC
+    for (int plan = 0; plan < SAMPLE_PLAN_COUNT; plan++)
+        if ((gSamplePlans[plan].fields & fieldMask) == fieldMask) return (SamplePlan)plan;
+#endif /* if !MEMHOLD_SAMPLE_GENERIC */
 
-    char line[356];
-    int  lineCount = 0;
+    return SAMPLE_PLAN_STAT_ALL;
+}
 
 
-#if 0
-   // Skip the first 13 fields
-    for (int i = 0; i < 13; i++) {
-        fscanf(file, "%*s");
-    }
+MHAPI void SetSamplePlan(MemholdContext *context, SamplePlan plan) { context->samplePlan = ((plan >= 0) && (plan < SAMPLE_PLAN_COUNT)) ? plan : SAMPLE_PLAN_STAT_ALL; }
 
-    fscanf(file, "%llu %llu", &utime, &stime);
-    fclose(file);
-#endif /* if 0 */
 
+MHAPI SamplePlan GetSamplePlan(const MemholdContext *context) { return context->samplePlan; }
 
-    // Split fields in output of /proc/<pid>/stat that are presented as a series
-    // of numbers and values separated by spaces.
-    //----------------------------------------------------------------------------------
-    const int MAX_TOKENS_CONSUMED_COUNT = 30; // Prevent infinite loops in inner while loop
 
-    while (fgets(line, sizeof(line), fp))
-    {
-        char *token = strtok(line, " "); // Divide S into tokens separated by characters in DELIM.
+MHAPI const char *GetSamplePlanFile(SamplePlan plan) { return gSamplePlans[plan].file; }
 
-#if MEMHOLD_YAGNI
-        char *token = strchr(line, ' ');
-#endif
 
-        int tokenConsumedCount = 1;
+MHAPI unsigned int GetSamplePlanFields(SamplePlan plan) { return gSamplePlans[plan].fields; }
 
-        while (token != NULL)
-        {
-            if (tokenConsumedCount >= MAX_TOKENS_CONSUMED_COUNT) break;
 
-            // Assign tokens
-            // See https://github.com/htop-dev/htop/blob/db73229bddc6efd26875213f7927b156feb5a937/linux/LinuxProcessTable.c#L276
+// Parse what a read of the plan's file left in `buf`. Returns 0 or -EINVAL.
+static int ParseSampleBuffer(const MemholdContext *context, SamplePlan plan, pid_t pid, const char *buf, int bufLen, ProcessSample *sample)
+{
+#if MEMHOLD_SAMPLE_GENERIC
+    ProcStat procStat;
 
-            /* (14) utime  -  %lu */
-            if (tokenConsumedCount == PROCESS_STAT_UTIME_INDEX) processUtime = strtoull(token, NULL, 10);
+    if (ParseProcStat(buf, bufLen, &procStat) != 0) return -EINVAL;
 
-            /* (15) stime  -  %lu */
-            if (tokenConsumedCount == PROCESS_STAT_STIME_INDEX) processStime = strtoull(token, NULL, 10);
+    FillProcessSample(context, pid, &procStat, sample);
+#else
+    *sample = (ProcessSample){.pid = pid};
 
-            /* (22) starttime  -  %llu */
-            if (tokenConsumedCount == PROCESS_STAT_STARTTIME_INDEX)
-            { // TODO(Lloyd): Adjust for boottime + adjustTime(lhost, ...)  / 100; See
-              // https://github.com/htop-dev/htop/blob/db73229bddc6efd26875213f7927b156feb5a937/linux/LinuxProcessTable.c#L381
-                if (processStarttime == 0) processStarttime = (strtoll(token, NULL, 10) / CLOCK_TICKS);
-            }
+    if (gSamplePlans[plan].parse(context, buf, bufLen, sample) != 0) return -EINVAL;
+#endif /* if MEMHOLD_SAMPLE_GENERIC */
 
-            // Consume token
-            token = strtok(NULL, " ");
-            tokenConsumedCount += 1;
-        }
-    }
+    return 0;
+}
 
-    if (processUtime && processStime)
-    {
-        // getconf
 
-        cpuUsage = (processUtime + processStime);
-    }
+// open() + read() + close() of /proc/[pid]/<file> into `buf`, NUL terminated.
+// Returns the length, or -errno.
+static int ReadProcStatFile(pid_t pid, const char *file, char *buf, int bufSize)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
 
-    assert((cpuUsage != -1) && "expected valid cpu usage while reading /proc/<pid>/stat");
-    //----------------------------------------------------------------------------------
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
 
-    status = fclose(fp); // Cleanup
+    if (fd < 0) return -errno; // Quietly: with `--all`, processes exit all the time
 
-    if ((status != 0))
-    {
-        perror("[ !ERR ]  failed to close status file");
-        goto ioError; // Bail out when close error
-    }
+    ssize_t bytesRead = read(fd, buf, bufSize - 1);
+    int     readError = errno;
 
-    fprintf(stdout, "[ INFO ]  PID: %d  starttime: %llu\n", pid, processStarttime);
+    close(fd);
 
-    return cpuUsage;
+    if (bytesRead < 0) return -readError;
+    if (bytesRead == 0) return -ENOENT;
 
-ioError:
+    buf[bytesRead] = '\0';
 
-    return status;
-};
+    return (int)bytesRead;
+}
 
 
-// For processes using popen use: ~ "ps -p %d -o rss --no-headers"
-MHAPI long GetMemUsage(pid_t pid)
+// One read of the `plan` file, timed into `timings` unless it is NULL.
+static int SampleProcessTimed(const MemholdContext *context, SamplePlan plan, pid_t pid, ProcessSample *sample, SampleTimings *timings)
 {
-    long status = -1;
+    char buf[1024];
 
-    char path[256];
-    snprintf(path, sizeof(path), "/proc/%d/status", pid); // Choices: status, mem
+    unsigned long long readBegin = timings ? GetMonotonicNs() : 0;
+    int                bufLen    = ReadProcStatFile(pid, gSamplePlans[plan].file, buf, sizeof(buf));
+    unsigned long long readEnd   = timings ? GetMonotonicNs() : 0;
 
-    // The file doesn't actually contain any data; it just acts as a pointer to
-    // where the actual process information resides.
-    FILE *fp = fopen(path, "r"); //> stream or NULL
+    if (bufLen < 0) return bufLen;
 
-    if (!fp) // [ ERR! ]  failed to open status file. file: (nil)
-    {        // zsh: segmentation fault (core dumped)  ./memhold $(pgrep clang)
-        fprintf(stderr, "[ ERR! ]  failed to open status file. file: %p\n", fp);
-        status = -1;
-        goto ioError; // Bail out
-    }
+    int parsed = ParseSampleBuffer(context, plan, pid, buf, bufLen, sample);
 
+    if (timings)
+    {
+        RecordHistogram(&timings->readNs, readEnd - readBegin);
+        RecordHistogram(&timings->parseNs, GetMonotonicNs() - readEnd);
+    }
 
-    char line[356];
-    long memoryUsage = -1;
+    return parsed;
+}
 
-    /*
-    VmRSS stands for Virtual Memory Resident Set Size.
 
-    VmRSS shows the amount of physical memory (RAM) that a process is
-    currently using. This includes:
+// One /proc/<pid>/stat read, every field whatever the plan (attach needs
+// comm and starttime). Returns 0, or -errno (-ENOENT when the process is gone).
+MHAPI int SampleProcess(const MemholdContext *context, pid_t pid, ProcessSample *sample) { return SampleProcessTimed(context, SAMPLE_PLAN_STAT_ALL, pid, sample, NULL); }
 
-      - The process's code
-      - Its data
-      - Shared libraries that are currently loaded into RAM
-    */
-    while (fgets(line, sizeof(line), fp))
-    {
-        if (strncmp(line, "VmRSS:", 6) == 0)
-        {
-            sscanf(line + 6, "%ld", &memoryUsage);
-            status = 0; // Success
-            break;
-        }
-    }
 
-    status = fclose(fp); // Cleanup
+MHAPI int SampleProcessesTimed(const MemholdContext *context, const pid_t *pids, int count, ProcessSample *samples, int *results, SampleTimings *timings)
+{
+    int sampledCount = 0;
 
-    if (status != 0)
+    for (int i = 0; i < count; i++)
     {
-        perror("[ ERR! ]  failed to close status file");
-        goto ioError;
+        results[i] = SampleProcessTimed(context, context->samplePlan, pids[i], &samples[i], timings);
+        if (results[i] == 0) sampledCount += 1;
     }
 
-    return memoryUsage;
+    return sampledCount;
+}
 
-ioError:
 
-    return status;
-};
+MHAPI int SampleProcesses(const MemholdContext *context, const pid_t *pids, int count, ProcessSample *samples, int *results)
+{
+    return SampleProcessesTimed(context, pids, count, samples, results, NULL);
+}
 
-#if MEMHOLD_YAGNI
-MHAPI void PanicUnimplemented(void) { UNIMPLEMENTED; }
-#endif /* if MEMHOLD_YAGNI */
 
 //-----------------------------------------------------------------------------
-// IT'S SHOWTIME                                                       ^_^
+// Parallel sampler (work-stealing pool)
 //-----------------------------------------------------------------------------
+//
+// The PID array of a frame is cut into chunks of SAMPLER_CHUNK_SIZE. Each
+// worker starts with an even share of chunks in its own deque and pops them
+// from the front. A worker that runs dry steals from the back of the others,
+// so a few expensive processes (huge maps, many threads) do not leave the
+// rest of the pool idle.
+//
+// Note: ~
+//   - A deque is one 64 bit word, head << 32 | tail, moved with CAS only.
+//   - Chunks are disjoint ranges of `samples`/`results`: workers write their
+//     results in place, without locks.
+//   - The calling thread is worker 0. A frame ends with a single barrier.
 
-int RunMain(void)
-{
-    int status = 0; // EXIT_SUCCESS
+// PIDs per chunk: small enough to balance, big enough to keep steals rare
+#define SAMPLER_CHUNK_SIZE (1 << 5) //> `32 (0x20)` (1 << 5)
+
+#define SAMPLER_DEQUE(head, tail) (((unsigned long long)(head) << 32) | (unsigned int)(tail))
 
-    // Log module information to stdout
-    //----------------------------------------------------------------------------------
-    if (memhold.flagVerbose)
-    {
-        fprintf(stdout, "[  OK  ]  <PID> %d\n", memhold.userProcessPID);
-        LogProcLimits(memhold.userProcessPID);
-    }
 
-    if (memhold.flagLog)
+// Pop a chunk from the front of our own deque. Returns -1 when empty.
+static int PopSamplerChunk(SamplerWorker *worker)
+{
+    unsigned long long deque = atomic_load(&worker->deque);
+
+    while ((unsigned int)(deque >> 32) < (unsigned int)deque)
     {
-        // Log user stats
-        fprintf(stdout, "[ INFO ]  [ user ]\n");
-        fprintf(stdout, "[ INFO ]  PID: %d\n", memhold.userProcessPID);
-        // Opts: constants like
-        fprintf(stdout, "[ INFO ]  Threshold CPU: %f\n", memhold.cpuThreshold);
-        fprintf(stdout, "[ INFO ]  Threshold MEM: %zu\n", memhold.memThreshold);
-        // Opts: loop stats
-        fprintf(stdout, "[ INFO ]  Refresh: %.2fs (%s)\n", memhold.refreshSeconds, memhold.apiID);
+        unsigned int head = (unsigned int)(deque >> 32);
 
-        // Log memhold stats
-        fprintf(stdout, "[ INFO ]  [ %s ]\n", memhold.apiID);
-        fprintf(stdout, "[ INFO ]  PID: %d\n", memhold.memholdMainProcessPID);
-        // Memhold: stats
-        fprintf(stdout, "[ INFO ]  Version: %d.%d.%d\n", MEMHOLD_VERSION_MAJOR, MEMHOLD_VERSION_MINOR, MEMHOLD_VERSION_PATCH);
+        if (atomic_compare_exchange_weak(&worker->deque, &deque, SAMPLER_DEQUE(head + 1, (unsigned int)deque))) return (int)head;
     }
-    //----------------------------------------------------------------------------------
 
-    // Prepare main loop
-    //----------------------------------------------------------------------------------
-    if (memhold.flagVerbose) fprintf(stdout, "\n[ INFO ]  <<< Stage 2: Monitor processes >>>\n\n");
-
-    char cmdGetProcName[256];
-
-    char   cmdCPU[256];
-    char   cmdMEM[256];
-    size_t cpuUsage[64];
-    size_t memUsage[64];
-
-    int    cpuUsageCounter   = 0;
-    int    memUsageCounter   = 0;
-    size_t cpuUsageThisFrame = 0;
-    size_t memUsageThisFrame = 0;
-
-#if 0 && MEMHOLD_YAGNI
-    //
-    // Prepare command statements
-    //
-
-    int stackAllocCmd = (sizeof(cmdCPU) + sizeof(cmdMEM) + sizeof(cmdGetProcName)); //> 768
-    int bytesSoFar    = 0;
-
-    bytesSoFar += snprintf(cmdCPU, sizeof(cmdCPU), "ps -p %d -o %%cpu --no-headers", memhold.userProcessPID);
-    bytesSoFar += snprintf(cmdMEM, sizeof(cmdMEM), "ps -p %d -o rss --no-headers", memhold.userProcessPID);
-    bytesSoFar += snprintf(cmdGetProcName, sizeof(cmdGetProcName), "ps aux | grep %d", memhold.userProcessPID);
-    assert(bytesSoFar >= 64 && bytesSoFar <= stackAllocCmd); //> 79 >= 64
-
-    #if 0            // TEMP LOG to stdout Process Name
-        int ret = system(cmdGetProcName);
-        if (ret != 0) {
-            char msg[256];
-            snprintf(msg, sizeof(msg), "[ ERR! ]  failed to execute command. system call returned: %d", ret);
-            perror(msg);
-            exit(1);
-        };
-    #endif           /* if 0 */
-
-    const int CMD_MAX = 1035;
-    int       pstatus;
-    FILE     *pipefp;
-    char      cmd[CMD_MAX];
-    pipefp = popen(cmdGetProcName, "r");
-    if (pipefp == NULL) {
-        perror("[ ERR! ]  failed to execute popen for getting process name via its PID");
-        exit(1);
-    }
-
-    int cntr = 0;
-    while (fgets(cmd, CMD_MAX, pipefp) != NULL) {
-        cntr++;
-        fprintf(stdout, "[  OK  ] [%d]: %s", cntr, cmd);
-    }
-
-    pstatus = pclose(pipefp);
-    if (pstatus == -1) perror("[ ERR! ] pclose"); // todo
-    #if MEMHOLD_SLOW // TODO: use macros (From examples in popen() are marvelous articles?)
-    else fprintf(stdout, "[ INFO ] pclose returned status for: %s\n", cmdGetProcName);
-    #endif           /* if MEMHOLD_SLOW */
-
-#endif /* if MEMHOLD_YAGNI */
-       //----------------------------------------------------------------------------------
-
-    // Run main loop
-    //----------------------------------------------------------------------------------
-    const long         CLOCK_TICKS = sysconf(_SC_CLK_TCK); // $ getconf CLK_TCK #> 100 # 100 clock ticks in a second.
-    int                loopCounter = 0;
-    double             cpuPercent  = 0;
-    unsigned long long cpuTime1, cpuTime2;
-    unsigned int       cpuWaitASecond = 1;
+    return -1;
+}
 
 
-    while (1)
+// Steal a chunk from the back of another worker's deque. Returns -1 when empty.
+static int StealSamplerChunk(SamplerWorker *victim)
+{
+    unsigned long long deque = atomic_load(&victim->deque);
+
+    while ((unsigned int)(deque >> 32) < (unsigned int)deque)
     {
+        unsigned int tail = (unsigned int)deque - 1;
 
-#if 1 /* <<<<<<<<<<< Remove this after prototyping >>>>>>>>>> */
+        if (atomic_compare_exchange_weak(&victim->deque, &deque, SAMPLER_DEQUE(deque >> 32, tail))) return (int)tail;
+    }
 
-        if (loopCounter >= MAX_HOT_LOOP_COUNT)
-        {
-            fprintf(stdout, "[ WARN ]  *break* main loop on iteration: %d\n", loopCounter);
-            break;
-        };
+    return -1;
+}
 
-        loopCounter += 1;
 
-#endif
+static void SampleChunk(SamplerPool *pool, int chunk, SamplerWorker *worker)
+{
+    int begin = chunk * SAMPLER_CHUNK_SIZE;
+    int end   = (begin + SAMPLER_CHUNK_SIZE < pool->count) ? (begin + SAMPLER_CHUNK_SIZE) : pool->count;
 
-        memUsageThisFrame = GetMemUsage(memhold.userProcessPID);
+    for (int i = begin; i < end; i++)
+    {
+        pool->results[i] = SampleProcessTimed(pool->context, pool->context->samplePlan, pool->pids[i], &pool->samples[i], &worker->timings);
+        if (pool->results[i] == 0) worker->sampledCount += 1;
+    }
+}
 
-        // Pause this frame (2s per frame by default.)
-        //----------------------------------------------------------------------------------
-        { // Wait for 1 second
-            cpuTime1 = GetCpuUsage(memhold.userProcessPID);
-            sleep(cpuWaitASecond);
-            cpuTime2 = GetCpuUsage(memhold.userProcessPID);
-        }
-        long systemUptime = GetSystemUptimeSec(memhold.userProcessPID);
-        printf("systemUptime = %ld\n", systemUptime);
 
-        // Calculate CPU usage
-        // We use sysconf(_SC_CLK_TCK) to get the number of clock ticks per second, which allows us to convert from clock ticks to seconds.
-        // @sysconf: Get the value of the system variable NAME. _SC_CLK_TCK:
-        cpuPercent = (1.0 * (cpuTime2 - cpuTime1)) / CLOCK_TICKS; // Multiply by 1.0 to avoid precision loss while dividing in next instruction
+// Drain our own deque, then steal until every deque is empty.
+static void RunSamplerWorker(SamplerPool *pool, int self)
+{
+    SamplerWorker *worker = &pool->workers[self];
+    int            chunk;
 
-#if 0  // Disabled as the value is too small and seems to be double of CPU% in btop for the running user process.
-        cpuPercent /= 100.0;
-#endif /* if 0 */
+    while ((chunk = PopSamplerChunk(worker)) >= 0)
+        SampleChunk(pool, chunk, worker);
 
-        // Ensure the loop waited for total `memhold.refreshSeconds` seconds
-        if (cpuWaitASecond < memhold.refreshSeconds) { sleep(memhold.refreshSeconds - cpuWaitASecond); }
-        //----------------------------------------------------------------------------------
+    for (int i = 1; i < pool->workerCount; i++)
+    {
+        SamplerWorker *victim = &pool->workers[(self + i) % pool->workerCount];
 
-        if (memhold.flagVerbose)
+        while ((chunk = StealSamplerChunk(victim)) >= 0)
         {
-            fprintf(stdout, "[ INFO ]  PID: %d  CPU: %3.6f%%  \t%ld\n", memhold.userProcessPID, cpuPercent, clock());
-            fprintf(stdout, "[ INFO ]  PID: %d  MEM: %8zuK  \t%ld\n", memhold.userProcessPID, memUsageThisFrame, clock());
+            SampleChunk(pool, chunk, worker);
+            worker->stolenCount += 1;
         }
     }
-    // end while (1)
-    //----------------------------------------------------------------------------------
+}
 
-    // Unload program
-    //----------------------------------------------------------------------------------
-    // NOTE(Lloyd): Unload more data or free memory here... (e.g. ML_FREE(...))
-    // ...
 
-    if (memhold.flagVerbose)
-    {
-        fprintf(stdout, "\n[ INFO ]  <<< Stage 3: Cleanup and Exit >>>\n\n");
-        fprintf(stdout, "[ INFO ]  took %.2fs\n", loopCounter * memhold.refreshSeconds);
-    }
-    //----------------------------------------------------------------------------------
+static void *SamplerPoolThread(void *arg)
+{
+    SamplerWorker *worker = arg;
+    SamplerPool   *pool   = worker->pool;
+    unsigned int   frame  = 0;
 
-    return status;
-};
+    // Signals are for the caller's threads
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
 
-// Main entry point of the program.
-int main(int argc, char *argv[])
-{
-    if (argc < 2)
+    while (1)
     {
-        fprintf(stderr, "Usage: %s <PID>\n", argv[0]);
-        exit(1);
-    }
+        pthread_mutex_lock(&pool->startLock);
+        while ((pool->frame == frame) && !pool->stopping)
+            pthread_cond_wait(&pool->startCond, &pool->startLock);
+        frame = pool->frame;
+        bool stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->startLock);
 
+        if (stopping) break;
 
-    // Declare main functions scoped variables
-    //----------------------------------------------------------------------------------
-    int status;
-    //----------------------------------------------------------------------------------
+        RunSamplerWorker(pool, (int)(worker - pool->workers));
+        pthread_barrier_wait(&pool->frameDone);
+    }
 
+    return NULL;
+}
 
-    // Parse args and ensure a valid process PID is passed.
-    //----------------------------------------------------------------------------------
-    if (!(argc < 2))
-    {
-        switch (argc - 1)
-        {
 
-        case 2:
-            if (strcmp(argv[2], "--verbose") == 0) { gVerbose = true; }
-            else gVerbose = false;
-            break;
+// Start `workerCount` - 1 threads. The caller of SampleProcessesParallel()
+// is the remaining worker. Returns NULL on error.
+MHAPI SamplerPool *CreateSamplerPool(const MemholdContext *context, int workerCount)
+{
+    if (workerCount < 1) workerCount = 1;
 
-        default: break;
-        }
-    }
+    SamplerPool *pool = MH_CALLOC(1, sizeof(SamplerPool));
+    if (!pool) return NULL;
 
-    // Convert argv[1] (<PID>: stdout of `$ pgrep lua`) to pid_t i.e. alias of integer.
-    gProcPID = (pid_t)(atoi(argv[1]));
+    pool->context     = context;
+    pool->workerCount = workerCount;
+    pool->workers     = aligned_alloc(64, workerCount * sizeof(SamplerWorker));
+    pool->threads     = MH_CALLOC(workerCount, sizeof(pthread_t));
 
-    // <<<<<<< HOW TO FIGURE OUT WHAT A VALID PID IS???? >>>>>>
-    // If is invalid (not a number or integer.) then
-    if (!(gProcPID >= 0))
-    {
-        fprintf(stderr, "Usage: %s <PID>\n", argv[0]);
-        fprintf(stderr, "expected valid PID. For example: 105815\n. got: %i", gProcPID);
-        status = 1;
-        goto cleanupError; // Bail out on invalid pid
-    }
-    //----------------------------------------------------------------------------------
+    if (!pool->workers || !pool->threads) goto initError;
 
+    memset(pool->workers, 0, workerCount * sizeof(SamplerWorker));
 
-    // Write stdout program name and version
-    //----------------------------------------------------------------------------------
-    fprintf(stdout, "%s %s\n", MEMHOLD_ID, MEMHOLD_VERSION);
+    pthread_mutex_init(&pool->startLock, NULL);
+    pthread_cond_init(&pool->startCond, NULL);
+    pthread_barrier_init(&pool->frameDone, NULL, workerCount);
 
-    if (gVerbose)
+    for (int w = 1; w < workerCount; w++)
     {
-        fprintf(stdout, "\n[ INFO ]  <<< Stage 1: Initialize program >>>\n\n");
+        pool->workers[w].pool = pool;
+
+        if (pthread_create(&pool->threads[w], NULL, SamplerPoolThread, &pool->workers[w]) != 0)
         {
-            fprintf(stdout, "[ INFO ]  ");
-            for (int i = 0; i < argc; i++)
-                fprintf(stdout, "%s ", argv[i]);
-            fprintf(stdout, "\n");
+            // Run the frame with the workers we have: the barrier needs all of them
+            pthread_mutex_lock(&pool->startLock);
+            pool->stopping = true;
+            pthread_cond_broadcast(&pool->startCond);
+            pthread_mutex_unlock(&pool->startLock);
+
+            for (int started = 1; started < w; started++)
+                pthread_join(pool->threads[started], NULL);
+
+            pthread_barrier_destroy(&pool->frameDone);
+            pthread_cond_destroy(&pool->startCond);
+            pthread_mutex_destroy(&pool->startLock);
+            goto initError;
         }
-        fprintf(stdout, "[ INFO ]  Verbose: %s\n", gVerbose ? "true" : "false");
     }
-    //----------------------------------------------------------------------------------
 
+    return pool;
 
-    // Initialize module
-    //----------------------------------------------------------------------------------
-    status = Init();
+initError:
+
+    free(pool->workers); // aligned_alloc()
+    MH_FREE(pool->threads);
+    MH_FREE(pool);
+
+    return NULL;
+}
+
+
+// SampleProcesses() spread over the pool. Returns how many succeeded.
+// NOTE: One frame at a time: the pool is not reentrant.
+MHAPI int SampleProcessesParallel(SamplerPool *pool, const pid_t *pids, int count, ProcessSample *samples, int *results)
+{
+    if (pool->workerCount == 1) return SampleProcessesTimed(pool->context, pids, count, samples, results, &pool->workers[0].timings);
 
-    if (status != 0)
+    int chunkCount = (count + SAMPLER_CHUNK_SIZE - 1) / SAMPLER_CHUNK_SIZE;
+
+    pool->pids    = pids;
+    pool->count   = count;
+    pool->samples = samples;
+    pool->results = results;
+
+    for (int w = 0; w < pool->workerCount; w++)
     {
-        fprintf(stderr, "[ ERR! ]  failed to initialize module\n");
+        SamplerWorker *worker = &pool->workers[w];
 
-        goto cleanupError;
+        worker->sampledCount = 0;
+        worker->stolenCount  = 0;
+        atomic_store(&worker->deque, SAMPLER_DEQUE((long long)chunkCount * w / pool->workerCount, (long long)chunkCount * (w + 1) / pool->workerCount));
     }
-    //----------------------------------------------------------------------------------
 
-    // Begin memhold hot loop.
-    //----------------------------------------------------------------------------------
-    status = RunMain();
+    pthread_mutex_lock(&pool->startLock);
+    pool->frame += 1;
+    pthread_cond_broadcast(&pool->startCond);
+    pthread_mutex_unlock(&pool->startLock);
+
+    RunSamplerWorker(pool, 0);
+    pthread_barrier_wait(&pool->frameDone);
+
+    int sampledCount = 0;
+    for (int w = 0; w < pool->workerCount; w++)
+        sampledCount += pool->workers[w].sampledCount;
+
+    return sampledCount;
+}
+
+
+// Chunks taken from other workers in the last frame (load imbalance).
+MHAPI int GetSamplerPoolSteals(const SamplerPool *pool)
+{
+    int stolenCount = 0;
+    for (int w = 0; w < pool->workerCount; w++)
+        stolenCount += pool->workers[w].stolenCount;
+
+    return stolenCount;
+}
+
+
+// The frame barrier orders every worker's writes before this, as long as no
+// frame is running.
+MHAPI void GetSamplerPoolTimings(const SamplerPool *pool, SampleTimings *timings)
+{
+    for (int w = 0; w < pool->workerCount; w++)
+    {
+        MergeHistogram(&timings->readNs, &pool->workers[w].timings.readNs);
+        MergeHistogram(&timings->parseNs, &pool->workers[w].timings.parseNs);
+    }
+}
+
+
+MHAPI void DestroySamplerPool(SamplerPool *pool)
+{
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->startLock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->startCond);
+    pthread_mutex_unlock(&pool->startLock);
+
+    for (int w = 1; w < pool->workerCount; w++)
+        pthread_join(pool->threads[w], NULL);
+
+    pthread_barrier_destroy(&pool->frameDone);
+    pthread_cond_destroy(&pool->startCond);
+    pthread_mutex_destroy(&pool->startLock);
+
+    free(pool->workers); // aligned_alloc()
+    MH_FREE(pool->threads);
+    MH_FREE(pool);
+}
+
+
+//-----------------------------------------------------------------------------
+// Batched stat reads (io_uring)
+//-----------------------------------------------------------------------------
+//
+// A ProcReader keeps /proc/<pid>/stat open per slot, so a sample is one read
+// at offset 0 instead of open() + read() + close(). With io_uring the fds
+// and the per-slot buffers are registered once, and a frame submits one
+// read per slot and reaps every completion in a single io_uring_enter().
+// Raw syscalls, no liburing.
+//
+// Note: ~
+//   - The ring is set up again (and everything registered again) when the
+//     capacity grows, which follows the process table and is rare.
+//   - Registered buffers count against RLIMIT_MEMLOCK. When registering them
+//     fails, reads go to the same buffers without IORING_OP_READ_FIXED.
+//   - procfs has no non-blocking reads, so the kernel completes them on its
+//     io-wq workers. The saving is in syscall transitions, not in CPU time.
+
+#define PROC_READER_MAX_ENTRIES (1 << 12) //> `4096 (0x1000)` (1 << 12)
+
+// Ring memory as mapped at setup
+typedef struct ProcReaderRing
+{
+    int      fd; // -1 in PROC_READER_PREAD mode
+    unsigned entries;
+
+    void  *sqRing;
+    size_t sqRingSize;
+    void  *cqRing; // == sqRing with IORING_FEAT_SINGLE_MMAP
+    size_t cqRingSize;
+
+    struct io_uring_sqe *sqes;
+    size_t               sqesSize;
+
+    _Atomic unsigned int *sqTail;
+    unsigned int          sqMask;
+    _Atomic unsigned int *cqHead;
+    _Atomic unsigned int *cqTail;
+    unsigned int          cqMask;
+    struct io_uring_cqe  *cqes;
+
+} ProcReaderRing;
+
+struct ProcReader
+{
+    const MemholdContext *context;
+    ProcReaderMode        mode;
+    bool                  useUring;
+    SamplePlan            plan; // The context's when the fds were opened
+
+    int    capacity; // Slots
+    int   *fds;      // -1 for empty
+    pid_t *pids;
+    char  *buffers; // capacity * MH_PROC_READ_SIZE
+
+    int syscallCount; // Last ReadProcStats()
+
+    SampleTimings timings; // readNs: one pread(), or one io_uring_enter() for a whole batch
+
+    ProcReaderRing ring;
+};
+
+
+static void TeardownProcReaderRing(ProcReaderRing *ring)
+{
+    if (ring->sqes) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && (ring->cqRing != ring->sqRing)) munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing) munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0) close(ring->fd);
+
+    *ring = (ProcReaderRing){.fd = -1};
+}
+
+
+// Set up a ring sized for the reader and register its fds and buffers.
+// Returns 0, or -errno with the reader left in PROC_READER_PREAD mode.
+static int SetupProcReaderRing(ProcReader *reader)
+{
+    ProcReaderRing *ring   = &reader->ring;
+    int             status = 0;
+
+    TeardownProcReaderRing(ring);
+    reader->mode = PROC_READER_PREAD;
+
+    unsigned int entries = 1;
+    while ((entries < (unsigned int)reader->capacity) && (entries < PROC_READER_MAX_ENTRIES))
+        entries <<= 1;
+
+    struct io_uring_params params = {0};
+
+    ring->fd = (int)syscall(SYS_io_uring_setup, entries, &params);
+    if (ring->fd < 0) goto ioError; // ENOSYS, or EPERM under kernel.io_uring_disabled
+
+    ring->entries    = params.sq_entries;
+    ring->sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned int));
+    ring->cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    ring->sqesSize   = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqRingSize > ring->sqRingSize) ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) { ring->sqRing = NULL; goto ioError; }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) ring->cqRing = ring->sqRing;
+    else
+    {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) { ring->cqRing = NULL; goto ioError; }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) { ring->sqes = NULL; goto ioError; }
+
+    char *sq = ring->sqRing;
+    char *cq = ring->cqRing;
+
+    ring->sqTail = (_Atomic unsigned int *)(sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->cqHead = (_Atomic unsigned int *)(cq + params.cq_off.head);
+    ring->cqTail = (_Atomic unsigned int *)(cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes   = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // SQE i always sits in SQ ring entry i
+    unsigned int *sqArray = (unsigned int *)(sq + params.sq_off.array);
+    for (unsigned int i = 0; i < ring->entries; i++)
+        sqArray[i] = i;
+
+    // IORING_OP_READ is 5.6+, older kernels only know readv
+    struct io_uring_probe *probe = MH_CALLOC(1, sizeof(struct io_uring_probe) + (IORING_OP_LAST * sizeof(struct io_uring_probe_op)));
+
+    if (!probe) { errno = ENOMEM; goto ioError; }
+
+    bool canRead = (syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) &&
+                   (probe->last_op >= IORING_OP_READ) && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    bool canReadFixed = canRead && (probe->ops[IORING_OP_READ_FIXED].flags & IO_URING_OP_SUPPORTED);
+
+    MH_FREE(probe);
+
+    if (!canRead) { errno = EOPNOTSUPP; goto ioError; }
+
+    // Empty slots are -1, which the kernel keeps as sparse entries
+    if (syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_FILES, reader->fds, reader->capacity) != 0) goto ioError;
+
+    struct iovec bufferVec = {.iov_base = reader->buffers, .iov_len = (size_t)reader->capacity * MH_PROC_READ_SIZE};
+
+    reader->mode = PROC_READER_URING;
+    if (canReadFixed && (syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &bufferVec, 1) == 0))
+        reader->mode = PROC_READER_URING_FIXED;
+
+    return 0;
+
+ioError:
+
+    status = -errno;
+    TeardownProcReaderRing(ring);
+    reader->mode = PROC_READER_PREAD;
+
+    return status;
+}
+
+
+// Grow to at least `capacity` slots. Buffers move, so the ring is set up again.
+static int GrowProcReader(ProcReader *reader, int capacity)
+{
+    int newCapacity = (reader->capacity > 0) ? reader->capacity : 64;
+
+    while (newCapacity < capacity)
+        newCapacity *= 2;
+
+    int   *fds     = MH_REALLOC(reader->fds, newCapacity * sizeof(int));
+    if (fds) reader->fds = fds;
+    pid_t *pids    = MH_REALLOC(reader->pids, newCapacity * sizeof(pid_t));
+    if (pids) reader->pids = pids;
+    char  *buffers = MH_REALLOC(reader->buffers, (size_t)newCapacity * MH_PROC_READ_SIZE);
+    if (buffers) reader->buffers = buffers;
+
+    if (!fds || !pids || !buffers) return -ENOMEM;
+
+    for (int slot = reader->capacity; slot < newCapacity; slot++)
+    {
+        reader->fds[slot]  = -1;
+        reader->pids[slot] = 0;
+    }
+
+    reader->capacity = newCapacity;
+
+    if (reader->useUring) SetupProcReaderRing(reader); // PROC_READER_PREAD on failure
+
+    return 0;
+}
+
+
+MHAPI ProcReader *CreateProcReader(const MemholdContext *context, int capacity, bool useUring)
+{
+    ProcReader *reader = MH_CALLOC(1, sizeof(ProcReader));
+
+    if (!reader) return NULL;
+
+    reader->context  = context;
+    reader->useUring = useUring;
+    reader->plan     = context->samplePlan;
+    reader->ring     = (ProcReaderRing){.fd = -1};
+
+    if (GrowProcReader(reader, (capacity > 0) ? capacity : 1) != 0)
+    {
+        DestroyProcReader(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+
+// Put `fd` in an empty `slot`, and in the ring's registered files
+static void RegisterProcReaderFd(ProcReader *reader, int slot, int fd)
+{
+    reader->fds[slot] = fd;
+
+    if (reader->ring.fd >= 0)
+    {
+        struct io_uring_files_update update = {.offset = (unsigned int)slot, .fds = (unsigned long)&reader->fds[slot]};
+
+        if (syscall(SYS_io_uring_register, reader->ring.fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+            SetupProcReaderRing(reader); // Registers the whole table again, or drops to pread
+    }
+}
+
+
+MHAPI int AttachProcReader(ProcReader *reader, int slot, pid_t pid)
+{
+    if ((slot >= reader->capacity) && (GrowProcReader(reader, slot + 1) != 0)) return -ENOMEM;
+
+    DetachProcReader(reader, slot);
+    reader->pids[slot] = pid;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, gSamplePlans[reader->plan].file);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return -errno; // EMFILE past RLIMIT_NOFILE: the slot is read by path
+
+    RegisterProcReaderFd(reader, slot, fd);
+
+    return 0;
+}
+
+
+MHAPI void DetachProcReader(ProcReader *reader, int slot)
+{
+    if ((slot >= reader->capacity) || (reader->fds[slot] < 0)) return;
+
+    close(reader->fds[slot]);
+    reader->fds[slot]  = -1;
+    reader->pids[slot] = 0;
+
+    if (reader->ring.fd >= 0)
+    {
+        struct io_uring_files_update update = {.offset = (unsigned int)slot, .fds = (unsigned long)&reader->fds[slot]};
+
+        syscall(SYS_io_uring_register, reader->ring.fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+    }
+}
+
+
+// Parse what a read left in the slot buffer. Returns 0 or -errno.
+static int FinishProcRead(ProcReader *reader, int slot, ssize_t bytesRead, ProcessSample *sample)
+{
+    if (bytesRead < 0) return (int)bytesRead;
+    if (bytesRead == 0) return -ESRCH;
+
+    char *buf = reader->buffers + ((size_t)slot * MH_PROC_READ_SIZE);
+
+    unsigned long long parseBegin = GetMonotonicNs();
+
+    buf[bytesRead] = '\0';
+    int parsed     = ParseSampleBuffer(reader->context, reader->plan, reader->pids[slot], buf, (int)bytesRead, sample);
+
+    RecordHistogram(&reader->timings.parseNs, GetMonotonicNs() - parseBegin);
+
+    return parsed;
+}
+
+
+// Open every attached slot again on the file of the context's new plan.
+// The new file is opened by PID, so it is only taken when the old fd still
+// reads afterwards: the process was alive past the open, so the PID was
+// still its own. Otherwise the old fd stays, fails with ESRCH on the next
+// read and the slot's process is detached as gone.
+static void ReopenProcReader(ProcReader *reader)
+{
+    reader->plan = reader->context->samplePlan;
+
+    for (int slot = 0; slot < reader->capacity; slot++)
+    {
+        pid_t pid = reader->pids[slot];
+
+        if ((reader->fds[slot] < 0) || (pid == 0)) continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/%s", pid, gSamplePlans[reader->plan].file);
+
+        char probe;
+        int  fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (pread(reader->fds[slot], &probe, 1, 0) != 1)
+        {
+            if (fd >= 0) close(fd);
+            continue;
+        }
+
+        DetachProcReader(reader, slot);
+        reader->pids[slot] = pid;
+
+        if (fd >= 0) RegisterProcReaderFd(reader, slot, fd); // Else (EMFILE) read by path, with starttime
+    }
+}
+
+
+MHAPI int ReadProcStats(ProcReader *reader, const int *slots, int count, ProcessSample *samples, int *results)
+{
+    ProcReaderRing *ring         = &reader->ring;
+    int             sampledCount = 0;
+    int             next         = 0;
+
+    reader->syscallCount = 0;
+
+    if (strcmp(gSamplePlans[reader->plan].file, gSamplePlans[reader->context->samplePlan].file) != 0) ReopenProcReader(reader);
+    reader->plan = reader->context->samplePlan;
+
+    // io_uring: up to ring->entries reads per io_uring_enter()
+    //----------------------------------------------------------------------------------
+    while ((ring->fd >= 0) && (next < count))
+    {
+        unsigned int tail   = atomic_load_explicit(ring->sqTail, memory_order_relaxed);
+        int          queued = 0;
+
+        for (; (next < count) && ((unsigned int)queued < ring->entries); next++)
+        {
+            int slot = slots[next];
+
+            if ((slot >= reader->capacity) || (reader->fds[slot] < 0))
+            {
+                results[next] = -EBADF; // Read by path below
+                continue;
+            }
+
+            struct io_uring_sqe *sqe = &ring->sqes[(tail + queued) & ring->sqMask];
+
+            *sqe = (struct io_uring_sqe){
+                .opcode    = (reader->mode == PROC_READER_URING_FIXED) ? IORING_OP_READ_FIXED : IORING_OP_READ,
+                .flags     = IOSQE_FIXED_FILE,
+                .fd        = slot, // Index in the registered files
+                .off       = 0,
+                .addr      = (unsigned long)(reader->buffers + ((size_t)slot * MH_PROC_READ_SIZE)),
+                .len       = MH_PROC_READ_SIZE - 1,
+                .buf_index = 0,
+                .user_data = (unsigned long long)next,
+            };
+            results[next] = -EINPROGRESS;
+            queued += 1;
+        }
+
+        atomic_store_explicit(ring->sqTail, tail + queued, memory_order_release);
+
+        int toSubmit = queued;
+        int pending  = queued;
+
+        while (pending > 0)
+        {
+            unsigned long long enterBegin = GetMonotonicNs();
+            int                submitted  = (int)syscall(SYS_io_uring_enter, ring->fd, toSubmit, pending, IORING_ENTER_GETEVENTS, NULL, 0);
+
+            RecordHistogram(&reader->timings.readNs, GetMonotonicNs() - enterBegin);
+            reader->syscallCount += 1;
+
+            if (submitted < 0)
+            {
+                if (errno == EINTR) continue;
+
+                // Queued reads never complete now. Drop the ring, read them with pread.
+                for (int i = 0; i < next; i++)
+                    if (results[i] == -EINPROGRESS) results[i] = -EBADF;
+
+                TeardownProcReaderRing(ring);
+                reader->mode = PROC_READER_PREAD;
+                break;
+            }
+
+            toSubmit -= submitted;
+
+            unsigned int head   = atomic_load_explicit(ring->cqHead, memory_order_relaxed);
+            unsigned int cqTail = atomic_load_explicit(ring->cqTail, memory_order_acquire);
+
+            for (; head != cqTail; head++)
+            {
+                const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqMask];
+                int                        i   = (int)cqe->user_data;
+
+                results[i] = FinishProcRead(reader, slots[i], cqe->res, &samples[i]);
+                if (results[i] == 0) sampledCount += 1;
+                pending -= 1;
+            }
+
+            atomic_store_explicit(ring->cqHead, head, memory_order_release);
+        }
+    }
+    //----------------------------------------------------------------------------------
+
+    // pread: one read per kept-open fd, by path for slots without one
+    //----------------------------------------------------------------------------------
+    for (int i = 0; i < count; i++)
+    {
+        int slot = slots[i];
+
+        if ((i < next) && (results[i] != -EBADF)) continue; // Done by io_uring
+
+        if ((slot < reader->capacity) && (reader->fds[slot] >= 0))
+        {
+            unsigned long long readBegin = GetMonotonicNs();
+            ssize_t            bytesRead = pread(reader->fds[slot], reader->buffers + ((size_t)slot * MH_PROC_READ_SIZE), MH_PROC_READ_SIZE - 1, 0);
+
+            RecordHistogram(&reader->timings.readNs, GetMonotonicNs() - readBegin);
+
+            results[i] = FinishProcRead(reader, slot, (bytesRead < 0) ? -errno : bytesRead, &samples[i]);
+            reader->syscallCount += 1;
+        }
+        else
+        {
+            // Without a kept-open fd only starttime tells a reused PID apart
+            SamplePlan plan = SelectSamplePlan(gSamplePlans[reader->plan].fields | SAMPLE_FIELD_IDENTITY);
+
+            results[i] = SampleProcessTimed(reader->context, plan, (slot < reader->capacity) ? reader->pids[slot] : 0, &samples[i], &reader->timings);
+            reader->syscallCount += 3; // open(), read(), close()
+        }
+
+        if (results[i] == 0) sampledCount += 1;
+    }
     //----------------------------------------------------------------------------------
 
-cleanupError:
+    return sampledCount;
+}
+
+
+MHAPI ProcReaderMode GetProcReaderMode(const ProcReader *reader) { return reader->mode; }
+
+
+MHAPI int GetProcReaderSyscalls(const ProcReader *reader) { return reader->syscallCount; }
+
+
+MHAPI void GetProcReaderTimings(const ProcReader *reader, SampleTimings *timings)
+{
+    MergeHistogram(&timings->readNs, &reader->timings.readNs);
+    MergeHistogram(&timings->parseNs, &reader->timings.parseNs);
+}
+
+
+MHAPI void DestroyProcReader(ProcReader *reader)
+{
+    if (!reader) return;
+
+    TeardownProcReaderRing(&reader->ring);
+
+    for (int slot = 0; slot < reader->capacity; slot++)
+        if (reader->fds[slot] >= 0) close(reader->fds[slot]);
+
+    MH_FREE(reader->fds);
+    MH_FREE(reader->pids);
+    MH_FREE(reader->buffers);
+    MH_FREE(reader);
+}
+
+
+//-----------------------------------------------------------------------------
+// Procfs readers
+//-----------------------------------------------------------------------------
+
+// Seconds since boot, suspend included. Same clock as /proc/<pid>/stat
+// `starttime`, without reading /proc/uptime.
+MHAPI long GetSystemUptimeSec(pid_t pid)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &now) != 0) return -1;
+
+    return (long)now.tv_sec;
+}
+
+
+// Seconds since a process started, from its /proc/<pid>/stat `starttime`.
+MHAPI double GetProcessAgeSec(const MemholdContext *context, unsigned long long starttime)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &now) != 0) return -1.0;
+
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1e9) - ((double)starttime / context->clockTicks);
+}
+
+
+// Parse one /proc/[pid]/stat (or /proc/[pid]/task/[tid]/stat) buffer in a single pass.
+//
+// Note: ~
+//   - `comm` may contain spaces and parentheses, so it spans from the first '('
+//     to the *last* ')'. Every field after it is a plain integer.
+//   - No strtok(), no sscanf(): fields are skipped by counting spaces and
+//     only the PROCESS_STAT_*_INDEX fields are converted.
+MHAPI int ParseProcStat(const char *buf, int bufLen, ProcStat *stat)
+{
+    const char *end       = buf + bufLen;
+    const char *commBegin = memchr(buf, '(', bufLen);
+    const char *commEnd   = NULL;
+
+    for (const char *p = end - 1; p > buf; p--)
+    {
+        if (*p == ')')
+        {
+            commEnd = p;
+            break;
+        }
+    }
+
+    if (!commBegin || !commEnd || (commEnd < commBegin) || ((commEnd + 2) >= end)) return -1;
+
+    *stat = (ProcStat){0};
+
+    for (const char *p = buf; p < commBegin; p++)
+    {
+        if ((*p >= '0') && (*p <= '9')) stat->pid = (stat->pid * 10) + (*p - '0');
+    }
+
+    int commLen = (int)(commEnd - commBegin - 1);
+    if (commLen >= MH_COMM_LEN) commLen = MH_COMM_LEN - 1;
+    memcpy(stat->comm, commBegin + 1, commLen);
+    stat->comm[commLen] = '\0';
+
+    const char *p          = commEnd + 2; // Skip ") "
+    int         fieldIndex = PROCESS_STAT_STATE_INDEX;
+
+    stat->state = *p;
+
+    while ((p < end) && (fieldIndex < PROCESS_STAT_RSS_INDEX))
+    {
+        // Advance to the start of the next field
+        while ((p < end) && (*p != ' '))
+            p++;
+        p++;
+        fieldIndex += 1;
+
+        if (p >= end) break;
+
+        bool               negative = (*p == '-');
+        unsigned long long value    = 0;
+
+        if (negative) p++;
+
+        while ((p < end) && (*p >= '0') && (*p <= '9'))
+        {
+            value = (value * 10) + (unsigned long long)(*p - '0');
+            p++;
+        }
+
+        switch (fieldIndex)
+        {
+        case PROCESS_STAT_MINFLT_INDEX: stat->minflt = (unsigned long)value; break;
+        case PROCESS_STAT_MAJFLT_INDEX: stat->majflt = (unsigned long)value; break;
+        case PROCESS_STAT_UTIME_INDEX: stat->utime = value; break;
+        case PROCESS_STAT_STIME_INDEX: stat->stime = value; break;
+        case PROCESS_STAT_NUM_THREADS_INDEX: stat->numThreads = negative ? -(long)value : (long)value; break;
+        case PROCESS_STAT_STARTTIME_INDEX: stat->starttime = value; break;
+        case PROCESS_STAT_VSIZE_INDEX: stat->vsize = (unsigned long)value; break;
+        case PROCESS_STAT_RSS_INDEX: stat->rss = negative ? -(long)value : (long)value; break;
+        default: break;
+        }
+    }
+
+    return (fieldIndex == PROCESS_STAT_RSS_INDEX) ? 0 : -1;
+}
+
+
+// Read and parse /proc/[pid]/stat. Returns 0 on success, -1 on error.
+MHAPI int GetProcStat(pid_t pid, ProcStat *stat)
+{
+    int status = -1;
+
+    char buf[1024];
+    int  bufLen = ReadProcStatFile(pid, "stat", buf, sizeof(buf));
+
+    if (bufLen < 0) goto ioError; // Bail out
+
+    status = ParseProcStat(buf, bufLen, stat);
+
+    return status;
+
+ioError:
+
+    errno = -bufLen;
+
+    return status;
+}
+
+
+// /proc/[pid]/stat:
+// This file contains more detailed CPU usage data. The relevant fields are: ~
+//   - utime: User mode CPU time
+//   - stime: Kernel mode CPU time
+//
+// Note: ~
+//   - For processes using popen use: ~ "ps -p %d -o %%cpu --no-headers"
+//   - Parsed by ParseProcStat(), shared with the per-thread sampler.
+MHAPI long GetCpuUsage(pid_t pid)
+{
+    long status = -1;
+
+    ProcStat procStat = {0};
+
+    if (GetProcStat(pid, &procStat) != 0) goto ioError; // Bail out
+
+    long cpuUsage = (long)(procStat.utime + procStat.stime);
+
+    return cpuUsage;
+
+ioError:
+
+    return status;
+};
+
+
+// "some avg10" of /proc/pressure/memory (PSI): the share of the last 10s in
+// which at least one task stalled on memory, in percent. `fd` stays open
+// across calls and is read with pread(). Returns 0, or -1 on error.
+MHAPI int GetMemoryPressure(int fd, float *someAvg10)
+{
+    char    buf[256];
+    ssize_t bytesRead = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (bytesRead <= 0) return -1;
+    buf[bytesRead] = '\0';
+
+    const char *value = strstr(buf, "some avg10=");
+    if (!value) return -1;
+
+    *someAvg10 = strtof(value + 11, NULL);
+
+    return 0;
+}
+
+
+// Paging counters of /proc/vmstat. `fd` stays open across calls and is read
+// with pread(). Kernels before 5.9 have one workingset_refault line instead
+// of the _anon/_file pair. Returns 0, or -1 on error.
+MHAPI int GetVmStat(int fd, VmStat *vmStat)
+{
+    char    buf[8192]; // ~4K on current kernels
+    ssize_t bytesRead = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (bytesRead <= 0) return -1;
+    buf[bytesRead] = '\0';
+
+    static const struct
+    {
+        const char *key;
+        int         keyLen;
+        size_t      offset;
+
+    } vmStatKeys[] = {
+        {"pswpin ", 7, offsetof(VmStat, pswpin)},
+        {"pswpout ", 8, offsetof(VmStat, pswpout)},
+        {"pgmajfault ", 11, offsetof(VmStat, pgmajfault)},
+        {"workingset_refault ", 19, offsetof(VmStat, workingsetRefault)},
+        {"workingset_refault_anon ", 24, offsetof(VmStat, workingsetRefault)},
+        {"workingset_refault_file ", 24, offsetof(VmStat, workingsetRefault)},
+    };
+
+    int found = 0;
+
+    *vmStat = (VmStat){0};
+
+    for (char *line = buf, *next; line; line = next)
+    {
+        next = strchr(line, '\n');
+        if (next) next += 1;
+
+        // Every key we want starts with 'p' or 'w'
+        if ((line[0] != 'p') && (line[0] != 'w')) continue;
+
+        for (int k = 0; k < (int)(sizeof(vmStatKeys) / sizeof(vmStatKeys[0])); k++)
+        {
+            if (strncmp(line, vmStatKeys[k].key, vmStatKeys[k].keyLen) != 0) continue;
+
+            *(unsigned long long *)((char *)vmStat + vmStatKeys[k].offset) += strtoull(line + vmStatKeys[k].keyLen, NULL, 10);
+            found += 1;
+            break;
+        }
+    }
+
+    return (found > 0) ? 0 : -1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Per-thread sampling (`--threads`)
+//-----------------------------------------------------------------------------
+
+// Start sampling the threads of PID. The first SampleThreads() call only
+// primes the deltas.
+MHAPI int InitThreadSampler(ThreadSampler *sampler, pid_t pid)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+    *sampler = (ThreadSampler){
+        .pid     = pid,
+        .active  = false,
+        .taskDir = opendir(path),
+    };
+
+    if (!sampler->taskDir) return -1;
+
+    sampler->capacity = 16;
+    sampler->threads  = MH_CALLOC(sampler->capacity, sizeof(ThreadSample));
+
+    if (!sampler->threads)
+    {
+        closedir(sampler->taskDir);
+        sampler->taskDir = NULL;
+        return -1;
+    }
+
+    sampler->active = true;
+
+    return 0;
+}
+
+
+// Walk /proc/<pid>/task and pread() each thread's stat through its kept-open fd.
+// Threads that exited since the last call are dropped, new ones are opened.
+// Returns the number of live threads or -1 on error.
+MHAPI int SampleThreads(ThreadSampler *sampler)
+{
+    if (!sampler->active) return -1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (sampler->lastSampleTime.tv_sec != 0)
+    {
+        sampler->sampleSeconds =
+            (double)(now.tv_sec - sampler->lastSampleTime.tv_sec) + ((double)(now.tv_nsec - sampler->lastSampleTime.tv_nsec) / 1e9);
+    }
+    sampler->lastSampleTime = now;
+
+    for (int i = 0; i < sampler->count; i++)
+        sampler->threads[i].alive = false;
+
+    // readdir() order is stable between walks, so `cursor` usually hits on
+    // the first compare and the lookup stays O(threads) per frame.
+    rewinddir(sampler->taskDir);
+
+    struct dirent *entry  = NULL;
+    int            cursor = 0;
+
+    while ((entry = readdir(sampler->taskDir)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+
+        pid_t tid   = (pid_t)atoi(entry->d_name);
+        int   found = -1;
+
+        for (int n = 0; n < sampler->count; n++)
+        {
+            int i = (cursor + n) % sampler->count;
+            if (sampler->threads[i].tid == tid)
+            {
+                found  = i;
+                cursor = i + 1;
+                break;
+            }
+        }
+
+        if (found < 0)
+        {
+            char path[256];
+            snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", sampler->pid, tid);
+
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue; // Thread exited between readdir() and open()
+
+            if (sampler->count == sampler->capacity)
+            {
+                int           capacity = sampler->capacity * 2;
+                ThreadSample *threads  = MH_REALLOC(sampler->threads, capacity * sizeof(ThreadSample));
+
+                if (!threads)
+                {
+                    close(fd);
+                    continue;
+                }
+
+                sampler->threads  = threads;
+                sampler->capacity = capacity;
+            }
+
+            found                   = sampler->count++;
+            sampler->threads[found] = (ThreadSample){.tid = tid, .fd = fd};
+        }
+
+        ThreadSample *thread = &sampler->threads[found];
+
+        char    buf[1024];
+        ssize_t bytesRead = pread(thread->fd, buf, sizeof(buf) - 1, 0);
+
+        ProcStat threadStat;
+
+        if ((bytesRead <= 0) || (ParseProcStat(buf, (int)bytesRead, &threadStat) != 0)) continue; // Thread is gone
+
+        unsigned long long cpuTicks = threadStat.utime + threadStat.stime;
+
+        if (thread->primed)
+        {
+            thread->cpuDelta    = cpuTicks - thread->cpuTicks;
+            thread->minfltDelta = threadStat.minflt - thread->minflt;
+            thread->majfltDelta = threadStat.majflt - thread->majflt;
+        }
+
+        memcpy(thread->comm, threadStat.comm, sizeof(thread->comm));
+        thread->cpuTicks = cpuTicks;
+        thread->minflt   = threadStat.minflt;
+        thread->majflt   = threadStat.majflt;
+        thread->primed   = true;
+        thread->alive    = true;
+    }
+
+    // Drop exited threads, keeping readdir() order for the cursor
+    int liveCount = 0;
+
+    for (int i = 0; i < sampler->count; i++)
+    {
+        if (sampler->threads[i].alive) sampler->threads[liveCount++] = sampler->threads[i];
+        else close(sampler->threads[i].fd);
+    }
+
+    sampler->count = liveCount;
+
+    return liveCount;
+}
+
+
+// Copy the K threads with the largest CPU delta (ties broken by faults) into
+// `topThreads`, hottest first. Returns how many were copied.
+MHAPI int GetTopThreads(const ThreadSampler *sampler, ThreadSample *topThreads, int k)
+{
+    int topCount = 0;
+
+    for (int i = 0; i < sampler->count; i++)
+    {
+        const ThreadSample *thread = &sampler->threads[i];
+
+        if (!thread->primed) continue;
+
+        unsigned long faults = thread->minfltDelta + thread->majfltDelta;
+
+        // Insertion into a K-sized sorted array. K is tiny, so this beats sorting every thread.
+        int slot = topCount;
+        while (slot > 0)
+        {
+            const ThreadSample *prev       = &topThreads[slot - 1];
+            unsigned long       prevFaults = prev->minfltDelta + prev->majfltDelta;
+
+            if ((prev->cpuDelta > thread->cpuDelta) || ((prev->cpuDelta == thread->cpuDelta) && (prevFaults >= faults))) break;
+
+            if (slot < k) topThreads[slot] = *prev;
+            slot -= 1;
+        }
+
+        if (slot < k)
+        {
+            topThreads[slot] = *thread;
+            if (topCount < k) topCount += 1;
+        }
+    }
+
+    return topCount;
+}
+
+
+MHAPI void UnloadThreadSampler(ThreadSampler *sampler)
+{
+    for (int i = 0; i < sampler->count; i++)
+        close(sampler->threads[i].fd);
+
+    if (sampler->taskDir) closedir(sampler->taskDir);
+    MH_FREE(sampler->threads);
+
+    *sampler = (ThreadSampler){0};
+}
+
+
+// Keys of /proc/<pid>/status we parse, by a perfect hash of their first 4
+// bytes: (bytes * STATUS_KEY_HASH) >> 28 puts each in its own slot. Any
+// other key lands on a slot whose key does not match.
+#define STATUS_KEY_HASH 0xcd613e31u
+
+typedef struct StatusKey
+{
+    const char  *key; // NULL for an empty slot
+    int          keyLen;
+    unsigned int field; // ProcStatusField
+
+} StatusKey;
+
+static const StatusKey statusKeys[16] = {
+    [3]  = {"VmRSS", 5, STATUS_VM_RSS},
+    [8]  = {"VmHWM", 5, STATUS_VM_HWM},
+    [5]  = {"VmSwap", 6, STATUS_VM_SWAP},
+    [13] = {"RssAnon", 7, STATUS_RSS_ANON},
+    [12] = {"RssFile", 7, STATUS_RSS_FILE},
+    [4]  = {"RssShmem", 8, STATUS_RSS_SHMEM},
+    [14] = {"Threads", 7, STATUS_THREADS},
+    [7]  = {"voluntary_ctxt_switches", 23, STATUS_VOLUNTARY_CTXT_SWITCHES},
+    [11] = {"nonvoluntary_ctxt_switches", 26, STATUS_NONVOLUNTARY_CTXT_SWITCHES},
+};
+
+
+// Match one "Key:\tvalue[ kB]" line. Returns the ProcStatusField it filled, or 0.
+static unsigned int ParseStatusLine(const char *line, const char *lineEnd, unsigned int fieldMask, ProcStatus *status)
+{
+    if (lineEnd - line < 4) return 0;
+
+    unsigned int firstBytes;
+    memcpy(&firstBytes, line, sizeof(firstBytes));
+
+    const StatusKey *key = &statusKeys[(firstBytes * STATUS_KEY_HASH) >> 28];
+
+    if (!(key->field & fieldMask)) return 0; // Empty slot, or not asked for: skipped without a compare
+    if ((lineEnd - line <= key->keyLen) || (line[key->keyLen] != ':') || (memcmp(line, key->key, key->keyLen) != 0)) return 0;
+
+    const char   *p     = line + key->keyLen + 1;
+    unsigned long value = 0;
+
+    while ((p < lineEnd) && ((*p == ' ') || (*p == '\t')))
+        p++;
+
+    while ((p < lineEnd) && (*p >= '0') && (*p <= '9'))
+        value = (value * 10) + (unsigned long)(*p++ - '0');
+
+    switch (key->field)
+    {
+    case STATUS_VM_RSS: status->vmRssKB = value; break;
+    case STATUS_VM_HWM: status->vmHwmKB = value; break;
+    case STATUS_VM_SWAP: status->vmSwapKB = value; break;
+    case STATUS_RSS_ANON: status->rssAnonKB = value; break;
+    case STATUS_RSS_FILE: status->rssFileKB = value; break;
+    case STATUS_RSS_SHMEM: status->rssShmemKB = value; break;
+    case STATUS_THREADS: status->threads = (long)value; break;
+    case STATUS_VOLUNTARY_CTXT_SWITCHES: status->voluntaryCtxtSwitches = value; break;
+    case STATUS_NONVOLUNTARY_CTXT_SWITCHES: status->nonvoluntaryCtxtSwitches = value; break;
+    default: break;
+    }
+
+    return key->field;
+}
+
+
+// Parse a /proc/[pid]/status buffer in a single pass.
+//
+// Note: ~
+//   - Newlines are found 16 bytes at a time (SSE2 compare + movemask), so
+//     each line costs one hash and at most one compare, never a strncmp()
+//     per known key.
+//   - Stops as soon as every field of `fieldMask` was found.
+MHAPI int ParseProcStatus(const char *buf, int bufLen, unsigned int fieldMask, ProcStatus *status)
+{
+    const char *line = buf;
+    int         base = 0;
+
+    *status = (ProcStatus){0};
+
+    while ((base < bufLen) && ((status->found & fieldMask) != fieldMask))
+    {
+        unsigned int newlines = 0; // Bit i: buf[base + i] is '\n'
+
+#if defined(__SSE2__)
+        if (base + 16 <= bufLen)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i *)(buf + base));
+            newlines      = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        }
+        else
+#endif
+        {
+            for (int i = 0; (i < 16) && (base + i < bufLen); i++)
+                if (buf[base + i] == '\n') newlines |= (1u << i);
+        }
+
+        while (newlines)
+        {
+            const char *lineEnd = buf + base + __builtin_ctz(newlines);
+
+            status->found |= ParseStatusLine(line, lineEnd, fieldMask, status);
+            line = lineEnd + 1;
+            newlines &= newlines - 1;
+        }
+
+        base += 16;
+    }
+
+    if ((line < buf + bufLen) && ((status->found & fieldMask) != fieldMask)) // No trailing newline
+        status->found |= ParseStatusLine(line, buf + bufLen, fieldMask, status);
+
+    return __builtin_popcount(status->found);
+}
+
+
+// Read and parse /proc/[pid]/status. Returns how many fields were found, -1 on error.
+MHAPI int GetProcStatus(pid_t pid, unsigned int fieldMask, ProcStatus *status)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    char    buf[4096]; // status is ~1.5KB
+    ssize_t bytesRead = read(fd, buf, sizeof(buf));
+    close(fd);
+
+    if (bytesRead <= 0) return -1;
+
+    return ParseProcStatus(buf, (int)bytesRead, fieldMask, status);
+}
+
+
+// VmRSS of /proc/[pid]/status in KB.
+//
+// VmRSS stands for Virtual Memory Resident Set Size. It shows the amount of
+// physical memory (RAM) that a process is currently using. This includes: ~
+//   - The process's code
+//   - Its data
+//   - Shared libraries that are currently loaded into RAM
+//
+// Note: ~
+//   - For processes using popen use: ~ "ps -p %d -o rss --no-headers"
+//   - Kernel threads have no VmRSS line: -1.
+MHAPI long GetMemUsage(pid_t pid)
+{
+    ProcStatus status;
+
+    if (GetProcStatus(pid, STATUS_VM_RSS, &status) < 0) return -1;
+
+    return (status.found & STATUS_VM_RSS) ? (long)status.vmRssKB : -1;
+}
+
+
+// Resident pages of /proc/[pid]/statm in KB: the counters behind VmRSS,
+// without formatting and parsing the whole status file.
+MHAPI long GetMemUsageStatm(const MemholdContext *context, pid_t pid)
+{
+    ProcessSample sample = {0};
+
+    if (SampleProcessTimed(context, SAMPLE_PLAN_STATM_RSS, pid, &sample, NULL) != 0) return -1;
+
+    return (long)sample.rssKB;
+}
+
+
+// Names of the /proc/<pid>/limits rows, by RLIMIT_* resource (see
+// proc_pid_limits() in fs/proc/base.c). Rows are matched by name, not by
+// position, in case a kernel adds or reorders some.
+static const char *gProcLimitNames[MH_PROC_LIMIT_COUNT] = {
+    "Max cpu time",      "Max file size",      "Max data size",       "Max stack size",    "Max core file size",   "Max resident set",
+    "Max processes",     "Max open files",     "Max locked memory",   "Max address space", "Max file locks",       "Max pending signals",
+    "Max msgqueue size", "Max nice priority", "Max realtime priority", "Max realtime timeout",
+};
+
+
+// Parse one limit column: "unlimited" or a number. Returns NULL on error,
+// or where the next column starts.
+static const char *ParseProcLimitValue(const char *p, const char *end, unsigned long long *value)
+{
+    while ((p < end) && (*p == ' ')) p++;
+
+    if (((end - p) >= 9) && (memcmp(p, "unlimited", 9) == 0))
+    {
+        *value = MH_LIMIT_UNLIMITED;
+        return p + 9;
+    }
+
+    if ((p == end) || (*p < '0') || (*p > '9')) return NULL;
+
+    *value = 0;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) *value = (*value * 10) + (unsigned long long)(*p++ - '0');
+
+    return p;
+}
+
+
+// The file is a header line and one row per resource:
+//
+//     Limit                     Soft Limit           Hard Limit           Units
+//     Max cpu time              unlimited            unlimited            seconds
+//     Max address space         8589934592           unlimited            bytes
+MHAPI int ParseProcLimits(const char *buf, int bufLen, ProcLimits *limits)
+{
+    const char *p     = buf;
+    const char *end   = buf + bufLen;
+    int         count = 0;
+
+    *limits = (ProcLimits){0};
+
+    while (p < end)
+    {
+        const char *lineEnd = memchr(p, '\n', end - p);
+        if (!lineEnd) lineEnd = end;
+
+        for (int resource = 0; resource < MH_PROC_LIMIT_COUNT; resource++)
+        {
+            size_t nameLen = strlen(gProcLimitNames[resource]);
+
+            if (((size_t)(lineEnd - p) <= nameLen) || (memcmp(p, gProcLimitNames[resource], nameLen) != 0) || (p[nameLen] != ' ')) continue;
+
+            const char *column = ParseProcLimitValue(p + nameLen, lineEnd, &limits->soft[resource]);
+            if (column) column = ParseProcLimitValue(column, lineEnd, &limits->hard[resource]);
+
+            if (column)
+            {
+                limits->found |= 1u << resource;
+                count += 1;
+            }
+
+            break;
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return count;
+}
+
+
+MHAPI const char *GetProcLimitName(int resource) { return ((resource >= 0) && (resource < MH_PROC_LIMIT_COUNT)) ? gProcLimitNames[resource] : "?"; }
+
+
+MHAPI int GetProcLimits(pid_t pid, ProcLimits *limits)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/limits", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -errno;
+
+    char    buf[2048]; // limits is ~1.3KB
+    ssize_t bytesRead = read(fd, buf, sizeof(buf));
+    int     status    = (bytesRead < 0) ? -errno : 0;
+    close(fd);
+
+    if (status != 0) return status;
+    if (ParseProcLimits(buf, (int)bytesRead, limits) == 0) return -EINVAL;
+
+    return 0;
+}
+
+
+// Two prlimit(2) calls: read the current limits, then write `soft` with the
+// hard limit as read, so whatever the process did to its hard limit since
+// stays. Other processes' limits need CAP_SYS_RESOURCE, or the same user.
+MHAPI int SetProcSoftLimit(pid_t pid, int resource, unsigned long long soft, unsigned long long *previous)
+{
+    struct rlimit limit;
+
+    if (prlimit(pid, resource, NULL, &limit) != 0) return -errno;
+
+    if (previous) *previous = (limit.rlim_cur == RLIM_INFINITY) ? MH_LIMIT_UNLIMITED : (unsigned long long)limit.rlim_cur;
+
+    rlim_t cur = (soft == MH_LIMIT_UNLIMITED) ? RLIM_INFINITY : (rlim_t)soft;
+
+    limit.rlim_cur = (cur < limit.rlim_max) ? cur : limit.rlim_max;
+
+    return (prlimit(pid, resource, &limit, NULL) == 0) ? 0 : -errno;
+}
+
+//-----------------------------------------------------------------------------
+// Taskstats backend (`--backend=taskstats`)
+//-----------------------------------------------------------------------------
+//
+// Binary per-task accounting over the TASKSTATS generic netlink family.
+// See https://docs.kernel.org/accounting/taskstats.html
+//
+// Note: ~
+//   - Each PID costs two requests: TGID (CPU and delays summed over all
+//     threads) and PID (mm-wide RSS/VM high-water marks, leader I/O).
+//   - A whole batch goes out in one sendmsg(), replies come back through
+//     recvmmsg(), so N PIDs cost O(1) syscalls instead of O(N) open/read/close.
+//   - Needs CAP_NET_ADMIN. InitTaskstats() probes once and fails so the caller
+//     can fall back to the procfs readers.
+
+// Room for one genetlink request carrying a u32 or a short cpumask string
+#define TASKSTATS_REQUEST_SIZE 64
+
+// Room for one reply (struct taskstats is ~450 bytes at version 13)
+#define TASKSTATS_REPLY_SIZE 2048
+
+// Netlink attribute payload accessors (NLA_DATA is not exported by <linux/netlink.h>)
+#define TASKSTATS_NLA_DATA(nla) ((char *)(nla) + NLA_HDRLEN)
+#define TASKSTATS_NLA_LEN(nla)  ((int)(nla)->nla_len - NLA_HDRLEN)
+
+// Append one attribute to the message at `msg`. Returns the new message length.
+static int TaskstatsPutAttr(struct nlmsghdr *msg, unsigned short type, const void *data, int dataLen)
+{
+    struct nlattr *nla = (struct nlattr *)((char *)msg + NLMSG_ALIGN(msg->nlmsg_len));
+
+    nla->nla_type = type;
+    nla->nla_len  = (unsigned short)(NLA_HDRLEN + dataLen);
+    memcpy(TASKSTATS_NLA_DATA(nla), data, dataLen);
+
+    msg->nlmsg_len = NLMSG_ALIGN(msg->nlmsg_len) + NLA_ALIGN(nla->nla_len);
+
+    return (int)msg->nlmsg_len;
+}
+
+
+// Write a generic netlink request header into `buf`. Returns the message.
+static struct nlmsghdr *TaskstatsPutHeader(char *buf, unsigned short familyId, unsigned char cmd, unsigned int seq)
+{
+    memset(buf, 0, TASKSTATS_REQUEST_SIZE);
+
+    struct nlmsghdr  *msg  = (struct nlmsghdr *)buf;
+    struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(msg);
+
+    msg->nlmsg_len   = NLMSG_LENGTH(GENL_HDRLEN);
+    msg->nlmsg_type  = familyId;
+    msg->nlmsg_flags = NLM_F_REQUEST;
+    msg->nlmsg_seq   = seq;
+    msg->nlmsg_pid   = 0;
+    genl->cmd        = cmd;
+    genl->version    = 1;
+
+    return msg;
+}
+
+
+// Copy the fields we use out of a TASKSTATS_TYPE_STATS payload.
+// `fromTgid` selects which half of a TGID/PID request pair this reply fills.
+static void TaskstatsFillSample(const char *payload, int payloadLen, bool fromTgid, TaskSample *sample)
+{
+    struct taskstats stats = {0};
+
+    // Older kernels send a shorter struct, newer ones a longer one
+    memcpy(&stats, payload, (payloadLen < (int)sizeof(stats)) ? payloadLen : (int)sizeof(stats));
+
+    if (fromTgid)
+    {
+        sample->cpuRunRealNs    = stats.cpu_run_real_total;
+        sample->cpuRunVirtualNs = stats.cpu_run_virtual_total;
+        sample->utimeUs         = stats.ac_utime;
+        sample->stimeUs         = stats.ac_stime;
+        sample->cpuDelayNs      = stats.cpu_delay_total;
+        sample->blkioDelayNs    = stats.blkio_delay_total;
+        sample->swapinDelayNs   = stats.swapin_delay_total;
+        sample->reclaimDelayNs  = stats.freepages_delay_total;
+#if TASKSTATS_VERSION >= 9
+        sample->thrashingDelayNs = stats.thrashing_delay_total;
+#endif
+    }
+    else
+    {
+        sample->hiwaterRssKB = stats.hiwater_rss;
+        sample->hiwaterVmKB  = stats.hiwater_vm;
+        sample->readBytes    = stats.read_bytes;
+        sample->writeBytes   = stats.write_bytes;
+        sample->minflt       = stats.ac_minflt;
+        sample->majflt       = stats.ac_majflt;
+        sample->elapsedUs    = stats.ac_etime;
+        sample->groupExit    = (stats.ac_flag & AGROUP) != 0;
+    }
+}
+
+
+// Parse one TASKSTATS_CMD_NEW reply. Returns the PID/TGID it describes or -1.
+// With `pidFillsAll`, an AGGR_PID record fills the TGID half too (exit records
+// of single threaded processes carry no AGGR_TGID).
+static pid_t TaskstatsParseReply(const struct nlmsghdr *msg, bool pidFillsAll, bool *isTgid, TaskSample *sample)
+{
+    const char *attrs    = (const char *)NLMSG_DATA(msg) + GENL_HDRLEN;
+    int         attrsLen = (int)msg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    pid_t       pid      = -1;
+
+    for (const struct nlattr *nla = (const struct nlattr *)attrs; (attrsLen >= NLA_HDRLEN) && (nla->nla_len >= NLA_HDRLEN);)
+    {
+        if ((nla->nla_type == TASKSTATS_TYPE_AGGR_PID) || (nla->nla_type == TASKSTATS_TYPE_AGGR_TGID))
+        {
+            *isTgid = (nla->nla_type == TASKSTATS_TYPE_AGGR_TGID);
+
+            const char *nested    = TASKSTATS_NLA_DATA(nla);
+            int         nestedLen = TASKSTATS_NLA_LEN(nla);
+
+            for (const struct nlattr *inner = (const struct nlattr *)nested; (nestedLen >= NLA_HDRLEN) && (inner->nla_len >= NLA_HDRLEN);)
+            {
+                if ((inner->nla_type == TASKSTATS_TYPE_PID) || (inner->nla_type == TASKSTATS_TYPE_TGID))
+                {
+                    unsigned int value;
+                    memcpy(&value, TASKSTATS_NLA_DATA(inner), sizeof(value));
+                    pid = (pid_t)value;
+                }
+                else if (inner->nla_type == TASKSTATS_TYPE_STATS)
+                {
+                    TaskstatsFillSample(TASKSTATS_NLA_DATA(inner), TASKSTATS_NLA_LEN(inner), *isTgid, sample);
+                    if (pidFillsAll && !*isTgid) TaskstatsFillSample(TASKSTATS_NLA_DATA(inner), TASKSTATS_NLA_LEN(inner), true, sample);
+                }
+
+                nestedLen -= NLA_ALIGN(inner->nla_len);
+                inner = (const struct nlattr *)((const char *)inner + NLA_ALIGN(inner->nla_len));
+            }
+        }
+
+        attrsLen -= NLA_ALIGN(nla->nla_len);
+        nla = (const struct nlattr *)((const char *)nla + NLA_ALIGN(nla->nla_len));
+    }
+
+    return pid;
+}
+
+
+// Open a bound NETLINK_GENERIC socket. Returns the fd or -1.
+static int TaskstatsOpenSocket(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd < 0) return -1;
+
+    struct sockaddr_nl addr = {.nl_family = AF_NETLINK};
+
+    int rcvbuf = (1 << 20); // Replies of a whole batch queue up before we reap them
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct timeval timeout = {.tv_sec = 1}; // Never hang a frame on a lost reply
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+MHAPI int InitTaskstats(TaskstatsBackend *ts)
+{
+    *ts = (TaskstatsBackend){.fd = -1, .exitFd = -1, .available = false};
+
+    ts->fd = TaskstatsOpenSocket();
+
+    if (ts->fd < 0) return -1;
+
+    ts->requestBuffer = MH_MALLOC((MH_TASKSTATS_BATCH * 2) * TASKSTATS_REQUEST_SIZE);
+    ts->replyBuffer   = MH_MALLOC((MH_TASKSTATS_BATCH * 2) * TASKSTATS_REPLY_SIZE);
+
+    if (!ts->requestBuffer || !ts->replyBuffer) goto initError;
+
+    // Resolve the TASKSTATS family id
+    //----------------------------------------------------------------------------------
+    char             request[TASKSTATS_REQUEST_SIZE];
+    struct nlmsghdr *msg = TaskstatsPutHeader(request, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, ++ts->seq);
+
+    TaskstatsPutAttr(msg, CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME));
+
+    char    reply[TASKSTATS_REPLY_SIZE];
+    ssize_t replyLen = -1;
+
+    if (send(ts->fd, request, msg->nlmsg_len, 0) >= 0) replyLen = recv(ts->fd, reply, sizeof(reply), 0);
+
+    const struct nlmsghdr *replyMsg = (const struct nlmsghdr *)reply;
+
+    if ((replyLen > 0) && NLMSG_OK(replyMsg, (unsigned int)replyLen) && (replyMsg->nlmsg_type != NLMSG_ERROR))
+    {
+        const char *attrs    = (const char *)NLMSG_DATA(replyMsg) + GENL_HDRLEN;
+        int         attrsLen = (int)replyMsg->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+
+        for (const struct nlattr *nla = (const struct nlattr *)attrs; (attrsLen >= NLA_HDRLEN) && (nla->nla_len >= NLA_HDRLEN);)
+        {
+            if (nla->nla_type == CTRL_ATTR_FAMILY_ID) memcpy(&ts->familyId, TASKSTATS_NLA_DATA(nla), sizeof(ts->familyId));
+
+            attrsLen -= NLA_ALIGN(nla->nla_len);
+            nla = (const struct nlattr *)((const char *)nla + NLA_ALIGN(nla->nla_len));
+        }
+    }
+
+    if (ts->familyId == 0)
+    {
+        errno = ENOENT; // CONFIG_TASKSTATS=n
+        goto initError;
+    }
+    //----------------------------------------------------------------------------------
+
+    // Probe with our own PID: fails with EPERM without CAP_NET_ADMIN
+    //----------------------------------------------------------------------------------
+    ts->available = true;
+
+    pid_t      self = getpid();
+    TaskSample probe;
+    int        probeStatus = 0;
+
+    if ((GetTaskstatsBatch(ts, &self, 1, &probe, &probeStatus) != 1))
+    {
+        errno = -probeStatus; // EPERM without CAP_NET_ADMIN
+        goto initError;
+    }
+    //----------------------------------------------------------------------------------
+
+    return 0;
+
+initError:;
+
+    int initErrno = errno;
+
+    CloseTaskstats(ts);
+    errno = initErrno;
+
+    return -1;
+}
+
+
+// Query `count` PIDs in batches of MH_TASKSTATS_BATCH. `results[i]` is set
+// to 0 or a negative errno (-ESRCH: process gone). Returns how many succeeded.
+MHAPI int GetTaskstatsBatch(TaskstatsBackend *ts, const pid_t *pids, int count, TaskSample *samples, int *results)
+{
+    if (!ts->available) return -1;
+
+    char(*request)[TASKSTATS_REQUEST_SIZE] = (char(*)[TASKSTATS_REQUEST_SIZE])ts->requestBuffer;
+    char(*reply)[TASKSTATS_REPLY_SIZE]     = (char(*)[TASKSTATS_REPLY_SIZE])ts->replyBuffer;
+
+    struct iovec   sendIov[MH_TASKSTATS_BATCH * 2];
+    struct iovec   recvIov[MH_TASKSTATS_BATCH * 2];
+    struct mmsghdr recvMsgs[MH_TASKSTATS_BATCH * 2];
+
+    int successCount = 0;
+
+    for (int batchBegin = 0; batchBegin < count; batchBegin += MH_TASKSTATS_BATCH)
+    {
+        int          batchCount = ((count - batchBegin) < MH_TASKSTATS_BATCH) ? (count - batchBegin) : MH_TASKSTATS_BATCH;
+        unsigned int seqBase    = ts->seq + 1;
+
+        // Build: one TGID and one PID request per process, in a single sendmsg()
+        //----------------------------------------------------------------------------------
+        for (int i = 0; i < batchCount; i++)
+        {
+            unsigned int pid = (unsigned int)pids[batchBegin + i];
+
+            for (int half = 0; half < 2; half++)
+            {
+                int              m   = (2 * i) + half;
+                struct nlmsghdr *msg = TaskstatsPutHeader(request[m], ts->familyId, TASKSTATS_CMD_GET, seqBase + m);
+
+                TaskstatsPutAttr(msg, (half == 0) ? TASKSTATS_CMD_ATTR_TGID : TASKSTATS_CMD_ATTR_PID, &pid, sizeof(pid));
+
+                sendIov[m] = (struct iovec){.iov_base = request[m], .iov_len = msg->nlmsg_len};
+            }
+
+            samples[batchBegin + i] = (TaskSample){.pid = pids[batchBegin + i]};
+            results[batchBegin + i] = 0;
+        }
+
+        int                msgCount = 2 * batchCount;
+        struct sockaddr_nl kernel   = {.nl_family = AF_NETLINK};
+        struct msghdr      sendMsg  = {.msg_name = &kernel, .msg_namelen = sizeof(kernel), .msg_iov = sendIov, .msg_iovlen = msgCount};
+
+        ts->seq += msgCount;
+
+        if (sendmsg(ts->fd, &sendMsg, 0) < 0)
+        {
+            for (int i = 0; i < batchCount; i++)
+                results[batchBegin + i] = -errno;
+            continue;
+        }
+        //----------------------------------------------------------------------------------
+
+        // Reap: each reply is its own datagram, recvmmsg() takes what is queued.
+        // Late replies to an earlier batch that timed out are read and dropped.
+        //----------------------------------------------------------------------------------
+        bool answered[MH_TASKSTATS_BATCH * 2] = {0};
+
+        for (int received = 0; received < msgCount;)
+        {
+            for (int m = 0; m < msgCount - received; m++)
+            {
+                recvIov[m]  = (struct iovec){.iov_base = reply[m], .iov_len = TASKSTATS_REPLY_SIZE};
+                recvMsgs[m] = (struct mmsghdr){.msg_hdr = {.msg_iov = &recvIov[m], .msg_iovlen = 1}};
+            }
+
+            int got = recvmmsg(ts->fd, recvMsgs, msgCount - received, MSG_WAITFORONE, NULL);
+
+            if (got <= 0) break;
+
+            for (int r = 0; r < got; r++)
+            {
+                const struct nlmsghdr *msg = (const struct nlmsghdr *)reply[r];
+                unsigned int           m   = msg->nlmsg_seq - seqBase;
+
+                if (!NLMSG_OK(msg, recvMsgs[r].msg_len) || (m >= (unsigned int)msgCount) || answered[m]) continue;
+
+                int index = batchBegin + (int)(m / 2);
+
+                answered[m] = true;
+                received += 1;
+
+                if (msg->nlmsg_type == NLMSG_ERROR)
+                {
+                    const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(msg);
+                    if (err->error != 0) results[index] = err->error;
+                }
+                else
+                {
+                    bool isTgid = false;
+                    TaskstatsParseReply(msg, false, &isTgid, &samples[index]);
+                }
+            }
+
+        }
+        //----------------------------------------------------------------------------------
+
+        // A process is sampled once both of its replies are in
+        for (int i = 0; i < batchCount; i++)
+        {
+            if ((results[batchBegin + i] == 0) && !(answered[2 * i] && answered[(2 * i) + 1])) results[batchBegin + i] = -ETIMEDOUT;
+            if (results[batchBegin + i] == 0) successCount += 1;
+        }
+    }
+
+    return successCount;
+}
+
+
+MHAPI int GetTaskstats(TaskstatsBackend *ts, pid_t pid, TaskSample *sample)
+{
+    int result = 0;
+
+    if (GetTaskstatsBatch(ts, &pid, 1, sample, &result) != 1) return (result != 0) ? result : -1;
+
+    return 0;
+}
+
+
+// Register for exit records of every task that dies on the CPUs in
+// `cpumask` (for example "0-7"; NULL means all online CPUs).
+MHAPI int ListenTaskstatsExit(TaskstatsBackend *ts, const char *cpumask)
+{
+    if (!ts->available) return -1;
+
+    char defaultMask[32];
+
+    if (!cpumask)
+    {
+        snprintf(defaultMask, sizeof(defaultMask), "0-%ld", sysconf(_SC_NPROCESSORS_CONF) - 1);
+        cpumask = defaultMask;
+    }
+
+    ts->exitFd = TaskstatsOpenSocket();
+    if (ts->exitFd < 0) return -1;
+
+    char             request[TASKSTATS_REQUEST_SIZE];
+    struct nlmsghdr *msg = TaskstatsPutHeader(request, ts->familyId, TASKSTATS_CMD_GET, 1);
+
+    msg->nlmsg_flags |= NLM_F_ACK;
+    TaskstatsPutAttr(msg, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK, cpumask, (int)strlen(cpumask) + 1);
+
+    char    reply[TASKSTATS_REPLY_SIZE];
+    ssize_t replyLen = -1;
+
+    if (send(ts->exitFd, request, msg->nlmsg_len, 0) >= 0) replyLen = recv(ts->exitFd, reply, sizeof(reply), 0);
+
+    const struct nlmsghdr *ack = (const struct nlmsghdr *)reply;
+
+    if ((replyLen <= 0) || (ack->nlmsg_type != NLMSG_ERROR) || (((const struct nlmsgerr *)NLMSG_DATA(ack))->error != 0))
+    {
+        close(ts->exitFd);
+        ts->exitFd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+// Drain queued exit records without blocking. Exits of single threads are
+// skipped; only whole process exits are returned. Returns the count.
+MHAPI int PollTaskstatsExit(TaskstatsBackend *ts, TaskSample *samples, int maxCount)
+{
+    if (ts->exitFd < 0) return 0;
+
+    char(*reply)[TASKSTATS_REPLY_SIZE] = (char(*)[TASKSTATS_REPLY_SIZE])ts->replyBuffer;
+
+    struct iovec   recvIov[MH_TASKSTATS_BATCH];
+    struct mmsghdr recvMsgs[MH_TASKSTATS_BATCH];
+
+    int sampleCount = 0;
+
+    while (sampleCount < maxCount)
+    {
+        for (int m = 0; m < MH_TASKSTATS_BATCH; m++)
+        {
+            recvIov[m]  = (struct iovec){.iov_base = reply[m], .iov_len = TASKSTATS_REPLY_SIZE};
+            recvMsgs[m] = (struct mmsghdr){.msg_hdr = {.msg_iov = &recvIov[m], .msg_iovlen = 1}};
+        }
+
+        int got = recvmmsg(ts->exitFd, recvMsgs, MH_TASKSTATS_BATCH, MSG_DONTWAIT, NULL);
+        if (got <= 0) break;
+
+        for (int r = 0; (r < got) && (sampleCount < maxCount); r++)
+        {
+            const struct nlmsghdr *msg = (const struct nlmsghdr *)reply[r];
+
+            if (!NLMSG_OK(msg, recvMsgs[r].msg_len) || (msg->nlmsg_type == NLMSG_ERROR)) continue;
+
+            // A group exit carries AGGR_PID for the last thread (flagged AGROUP), then
+            // AGGR_TGID for the group unless the process was single threaded
+            TaskSample sample = {0};
+            bool       isTgid = false;
+
+            sample.pid = TaskstatsParseReply(msg, true, &isTgid, &sample);
+
+            if ((isTgid || sample.groupExit) && (sample.pid > 0)) samples[sampleCount++] = sample;
+        }
+    }
+
+    return sampleCount;
+}
+
+
+MHAPI void CloseTaskstats(TaskstatsBackend *ts)
+{
+    if (ts->fd >= 0) close(ts->fd);
+    if (ts->exitFd >= 0) close(ts->exitFd);
+
+    MH_FREE(ts->requestBuffer);
+    MH_FREE(ts->replyBuffer);
+
+    *ts = (TaskstatsBackend){.fd = -1, .exitFd = -1, .available = false};
+}
+
+
+//-----------------------------------------------------------------------------
+// Soft hold (`action=cold|pageout` in rules)
+//-----------------------------------------------------------------------------
+//
+// Instead of stopping a process over its memory threshold, push its private
+// anonymous memory towards swap/zram and let it keep running: ~
+//   - MADV_COLD:    deactivate the pages, reclaimed first under pressure
+//   - MADV_PAGEOUT: reclaim the pages now
+//
+// Regions come from /proc/<pid>/maps and are advised through a pidfd with
+// batched process_madvise() calls (Linux 5.10+). Needs CAP_SYS_NICE and
+// PTRACE_MODE_READ over the target.
+
+#ifndef MADV_COLD
+    #define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+    #define MADV_PAGEOUT 21
+#endif
+
+
+// Parse one /proc/<pid>/maps line: `start-end perms offset dev inode [path]`.
+// Returns true for private anonymous memory worth advising.
+static bool ParseMapsLine(const char *line, const char *lineEnd, unsigned long *start, unsigned long *end)
+{
+    const char *cursor = line;
+
+    *start = *end = 0;
+
+    for (; cursor < lineEnd && *cursor != '-'; cursor++)
+        *start = (*start << 4) | (unsigned long)((*cursor <= '9') ? (*cursor - '0') : ((*cursor | 0x20) - 'a' + 10));
+
+    for (cursor++; cursor < lineEnd && *cursor != ' '; cursor++)
+        *end = (*end << 4) | (unsigned long)((*cursor <= '9') ? (*cursor - '0') : ((*cursor | 0x20) - 'a' + 10));
+
+    const char *perms = cursor + 1;
+
+    if ((perms + 4 > lineEnd) || (perms[3] != 'p')) return false;
+    if ((perms[0] != 'r') && (perms[1] != 'w')) return false; // Guard pages
+
+    // Skip offset, dev and inode, then any padding before the path
+    cursor = perms;
+    for (int field = 0; field < 4 && cursor < lineEnd; field++)
+    {
+        while (cursor < lineEnd && *cursor != ' ')
+            cursor++;
+        while (cursor < lineEnd && *cursor == ' ')
+            cursor++;
+    }
+
+    if (cursor == lineEnd) return true; // No path: anonymous
+
+    int pathLen = (int)(lineEnd - cursor);
+
+    return ((pathLen == 6) && (memcmp(cursor, "[heap]", 6) == 0)) || ((pathLen == 7) && (memcmp(cursor, "[stack]", 7) == 0)) ||
+           ((pathLen > 6) && (memcmp(cursor, "[anon:", 6) == 0));
+}
+
+
+// Advise `iovecs` with as few calls as possible. A region the kernel rejects
+// (locked, PFN mapped, gone since the maps read) is skipped. Returns -1 when
+// advice cannot be given at all (process gone, no permission, old kernel).
+static int AdviseRegions(int pidfd, int advice, struct iovec *iovecs, int count, ReclaimStats *stats)
+{
+    int i = 0;
+
+    while (i < count)
+    {
+        long result = syscall(SYS_process_madvise, pidfd, iovecs + i, count - i, advice, 0);
+
+        stats->callCount += 1;
+
+        if (result < 0)
+        {
+            if ((errno == ESRCH) || (errno == EPERM) || (errno == ENOSYS)) return -1;
+            i += 1;
+            continue;
+        }
+
+        stats->bytesAdvised += (size_t)result;
+
+        // A short count means the region after the advised ones failed
+        for (; i < count && (size_t)result >= iovecs[i].iov_len; i++)
+        {
+            result -= (long)iovecs[i].iov_len;
+            stats->regionCount += 1;
+        }
+
+        i += 1;
+    }
+
+    return 0;
+}
+
+
+MHAPI int OpenReclaimer(Reclaimer *reclaimer, pid_t pid)
+{
+    *reclaimer = (Reclaimer){.pidfd = (int)syscall(SYS_pidfd_open, pid, 0)};
+
+    return (reclaimer->pidfd >= 0) ? 0 : -1;
+}
+
+
+// Advise the private anonymous memory of PID with `advice` (MADV_COLD or
+// MADV_PAGEOUT), at most `maxBytes` per call (MH_NO_LIMIT for all of it). A
+// capped pass resumes where the previous call stopped, on a page boundary
+// (a cap under one page advises one page). Returns 0 on success, -1 on error.
+MHAPI int ReclaimProcessMemory(Reclaimer *reclaimer, pid_t pid, int advice, size_t maxBytes, ReclaimStats *stats)
+{
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    *stats = (ReclaimStats){0};
+
+    if ((reclaimer->pidfd < 0) && (OpenReclaimer(reclaimer, pid) != 0)) return -1;
+
+    char path[256];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct iovec iovecs[MAX_RECLAIM_IOVECS];
+    int          iovecCount  = 0;
+    size_t       pageSize    = (size_t)sysconf(_SC_PAGESIZE);
+    size_t       queuedBytes = 0;
+    bool         capped      = false;
+    int          status      = 0;
+
+    char    buf[1 << 14];
+    int     carried = 0; // Bytes of an unfinished line kept at the start of buf
+    ssize_t bytesRead;
+
+    while (!capped && (bytesRead = read(fd, buf + carried, sizeof(buf) - carried)) > 0)
+    {
+        char *bufEnd = buf + carried + bytesRead;
+        char *line   = buf;
+        char *lineEnd;
+
+        while (!capped && (lineEnd = memchr(line, '\n', bufEnd - line)) != NULL)
+        {
+            unsigned long start, stop;
+
+            if (ParseMapsLine(line, lineEnd, &start, &stop) && (stop > reclaimer->nextAddress))
+            {
+                if (start < reclaimer->nextAddress) start = reclaimer->nextAddress;
+
+                size_t length = stop - start;
+
+                if ((maxBytes != MH_NO_LIMIT) && (queuedBytes + length >= maxBytes))
+                {
+                    length = (maxBytes - queuedBytes) & ~(pageSize - 1); // process_madvise() wants whole pages
+                    if ((length == 0) && (queuedBytes == 0)) length = pageSize;
+
+                    reclaimer->nextAddress = start + length;
+                    capped                = true;
+                }
+
+                if (length > 0)
+                {
+                    iovecs[iovecCount++] = (struct iovec){.iov_base = (void *)start, .iov_len = length};
+                    queuedBytes += length;
+                }
+
+                if (iovecCount == MAX_RECLAIM_IOVECS)
+                {
+                    if (AdviseRegions(reclaimer->pidfd, advice, iovecs, iovecCount, stats) != 0) goto ioError;
+                    iovecCount = 0;
+                }
+            }
+
+            line = lineEnd + 1;
+        }
+
+        // Keep the partial last line for the next read. Lines never fill buf
+        carried = (int)(bufEnd - line);
+        if (carried == sizeof(buf)) carried = 0;
+        memmove(buf, line, carried);
+    }
+
+    if ((iovecCount > 0) && (AdviseRegions(reclaimer->pidfd, advice, iovecs, iovecCount, stats) != 0)) goto ioError;
+
+    stats->passDone = !capped;
+    if (!capped) reclaimer->nextAddress = 0;
+
+    goto done;
+
+ioError:
+
+    status = -1;
+
+done:
+
+    close(fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = (double)(end.tv_sec - begin.tv_sec) + ((double)(end.tv_nsec - begin.tv_nsec) / 1e9);
+
+    return status;
+}
+
+
+MHAPI void CloseReclaimer(Reclaimer *reclaimer)
+{
+    if (reclaimer->pidfd >= 0) close(reclaimer->pidfd);
+
+    *reclaimer = (Reclaimer){.pidfd = -1};
+}
+
+
+//-----------------------------------------------------------------------------
+// OOM killer steering (`oom=steer|protect` in rules)
+//-----------------------------------------------------------------------------
+
+MHAPI int OpenOomScore(OomScore *score, pid_t pid)
+{
+    char path[64];
+    char buf[16];
+    int  status = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", pid);
+
+    *score = (OomScore){.fd = open(path, O_RDWR | O_CLOEXEC)};
+    if (score->fd < 0) return -errno;
+
+    ssize_t bytesRead = pread(score->fd, buf, sizeof(buf) - 1, 0);
+    if (bytesRead <= 0)
+    {
+        status = (bytesRead < 0) ? -errno : -EIO;
+        goto ioError;
+    }
+
+    buf[bytesRead]  = '\0';
+    score->original = (int)strtol(buf, NULL, 10);
+    score->current  = score->original;
+
+    return 0;
+
+ioError:
+
+    close(score->fd);
+    score->fd = -1;
+
+    return status;
+}
+
+
+MHAPI int SetOomScore(OomScore *score, int value)
+{
+    char buf[16];
+    int  length = snprintf(buf, sizeof(buf), "%d\n", value);
+
+    if (pwrite(score->fd, buf, length, 0) != length) return -errno;
+
+    score->current = value;
+
+    return 0;
+}
+
+
+MHAPI void CloseOomScore(OomScore *score, bool restore)
+{
+    if (score->fd >= 0)
+    {
+        if (restore && (score->current != score->original)) SetOomScore(score, score->original);
+        close(score->fd);
+    }
+
+    *score = (OomScore){.fd = -1};
+}
+
+
+//-----------------------------------------------------------------------------
+// Working set (`--wss`, idle page tracking)
+//-----------------------------------------------------------------------------
+//
+// RSS counts every resident page, also the ones touched once long ago. To
+// see what a process really uses, all of its resident pages are marked idle
+// in /sys/kernel/mm/page_idle/bitmap, and the next call counts how many the
+// kernel has found accessed since (it clears the bit on access).
+//
+// Page frames come from /proc/<pid>/pagemap, PAGEMAP_BATCH entries per read.
+// The bitmap is one bit per page frame in 8-byte words. Writing a 1 marks a
+// page idle and a 0 changes nothing, so frames close together share one run
+// of words, read and written whole.
+// See https://docs.kernel.org/admin-guide/mm/idle_page_tracking.html
+//
+// Note: ~
+//   Needs CONFIG_IDLE_PAGE_TRACKING, and CAP_SYS_ADMIN for page frames.
+
+MHAPI int OpenWorkingSet(WorkingSet *workingSet, pid_t pid)
+{
+    char path[64];
+    int  status = 0;
+
+    *workingSet = (WorkingSet){.pagemapFd = -1, .bitmapFd = open("/sys/kernel/mm/page_idle/bitmap", O_RDWR | O_CLOEXEC)};
+    if (workingSet->bitmapFd < 0) return -errno;
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", pid);
+
+    workingSet->pagemapFd = open(path, O_RDONLY | O_CLOEXEC);
+    workingSet->words     = MH_MALLOC(2 * IDLE_RUN_WORDS * sizeof(unsigned long long));
+
+    if (workingSet->pagemapFd < 0) status = -errno;
+    else if (!workingSet->words) status = -ENOMEM;
+
+    if (status != 0) CloseWorkingSet(workingSet);
+
+    return status;
+}
+
+
+static int CompareFrames(const void *a, const void *b)
+{
+    unsigned long long frameA = *(const unsigned long long *)a;
+    unsigned long long frameB = *(const unsigned long long *)b;
+
+    return (frameA > frameB) - (frameA < frameB);
+}
+
+
+// Page frames of every resident page in [start, end). Returns 0 or -errno.
+static int ReadPageFrames(WorkingSet *workingSet, unsigned long start, unsigned long end, long pageSize, WorkingSetStats *stats)
+{
+    unsigned long long entries[PAGEMAP_BATCH];
+
+    for (unsigned long page = start / pageSize; page < (end / pageSize);)
+    {
+        int     count     = ((end / pageSize) - page < PAGEMAP_BATCH) ? (int)((end / pageSize) - page) : PAGEMAP_BATCH;
+        ssize_t bytesRead = pread(workingSet->pagemapFd, entries, count * sizeof(unsigned long long), (off_t)(page * sizeof(unsigned long long)));
+
+        stats->syscallCount += 1;
+
+        if (bytesRead < 0) return -errno;
+        if (bytesRead == 0) break;
+
+        count = (int)(bytesRead / sizeof(unsigned long long));
+
+        if (workingSet->pfnCount + count > workingSet->pfnCapacity)
+        {
+            int                 capacity = (workingSet->pfnCapacity == 0) ? (1 << 16) : workingSet->pfnCapacity;
+            while (capacity < workingSet->pfnCount + count)
+                capacity *= 2;
+
+            unsigned long long *pfns     = MH_REALLOC(workingSet->pfns, capacity * sizeof(unsigned long long));
+            if (!pfns) return -ENOMEM;
+
+            workingSet->pfns        = pfns;
+            workingSet->pfnCapacity = capacity;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            unsigned long long pfn = entries[i] & PAGEMAP_PFN_MASK;
+
+            // Without CAP_SYS_ADMIN present pages read as frame 0
+            if ((entries[i] & PAGEMAP_PRESENT) && (pfn != 0)) workingSet->pfns[workingSet->pfnCount++] = pfn;
+        }
+
+        page += count;
+    }
+
+    return 0;
+}
+
+
+// Walk /proc/<pid>/maps into the sorted frames of every resident page.
+// Returns 0 or -errno.
+static int CollectPageFrames(WorkingSet *workingSet, pid_t pid, WorkingSetStats *stats)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -errno;
+
+    long    pageSize = sysconf(_SC_PAGESIZE);
+    int     status   = 0;
+    char    buf[1 << 14];
+    int     carried = 0; // Bytes of an unfinished line kept at the start of buf
+    ssize_t bytesRead;
+
+    workingSet->pfnCount = 0;
+
+    while ((status == 0) && (bytesRead = read(fd, buf + carried, sizeof(buf) - carried)) > 0)
+    {
+        char *bufEnd = buf + carried + bytesRead;
+        char *line   = buf;
+        char *lineEnd;
+
+        while ((status == 0) && (lineEnd = memchr(line, '\n', bufEnd - line)) != NULL)
+        {
+            char         *end   = NULL;
+            unsigned long start = strtoul(line, &end, 16);
+            unsigned long stop  = (*end == '-') ? strtoul(end + 1, NULL, 16) : start;
+
+            if (stop > start) status = ReadPageFrames(workingSet, start, stop, pageSize, stats);
+
+            line = lineEnd + 1;
+        }
+
+        // Keep the partial last line for the next read. Lines never fill buf
+        carried = (int)(bufEnd - line);
+        if (carried == sizeof(buf)) carried = 0;
+        memmove(buf, line, carried);
+    }
+
+    close(fd);
+
+    // A frame mapped twice is listed twice, SampleWorkingSet() counts it once
+    if (status == 0) qsort(workingSet->pfns, workingSet->pfnCount, sizeof(unsigned long long), CompareFrames);
+
+    return status;
+}
+
+
+// Bits set in both a[i] and b[i]
+static unsigned long long CountCommonBits(const unsigned long long *a, const unsigned long long *b, int count)
+{
+    unsigned long long total = 0;
+    int                i     = 0;
+
+#if defined(__AVX512VPOPCNTDQ__)
+    __m512i sum512 = _mm512_setzero_si512();
+
+    for (; i + 8 <= count; i += 8)
+        sum512 = _mm512_add_epi64(sum512, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+
+    total += (unsigned long long)_mm512_reduce_add_epi64(sum512);
+#endif
+#if defined(__AVX2__)
+    // Nibble lookup popcount (Mula et al.), bytes summed with SAD
+    const __m256i lookup  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibbles = _mm256_set1_epi8(0x0f);
+    __m256i       sum256  = _mm256_setzero_si256();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i bits = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        __m256i low  = _mm256_shuffle_epi8(lookup, _mm256_and_si256(bits, nibbles));
+        __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(bits, 4), nibbles));
+
+        sum256 = _mm256_add_epi64(sum256, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+    }
+
+    total += (unsigned long long)(_mm256_extract_epi64(sum256, 0) + _mm256_extract_epi64(sum256, 1) + _mm256_extract_epi64(sum256, 2) +
+                                  _mm256_extract_epi64(sum256, 3));
+#endif
+
+    for (; i < count; i++)
+        total += (unsigned long long)__builtin_popcountll(a[i] & b[i]);
+
+    return total;
+}
+
+
+// Count the pages accessed since the previous call, then mark every resident
+// page idle again. Returns 1 with `stats->activeKB` set, 0 when the pages
+// were only marked (first call), or -errno.
+MHAPI int SampleWorkingSet(WorkingSet *workingSet, pid_t pid, WorkingSetStats *stats)
+{
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    *stats = (WorkingSetStats){0};
+
+    int status = CollectPageFrames(workingSet, pid, stats);
+    if (status != 0) goto ioError;
+
+    unsigned long long *mask      = workingSet->words;
+    unsigned long long *bitmap    = workingSet->words + IDLE_RUN_WORDS;
+    unsigned long long  idleCount = 0;
+    unsigned long long  pageCount = 0;
+
+    for (int i = 0; i < workingSet->pfnCount;)
+    {
+        // One run: frames from here until a gap or a full buffer
+        unsigned long long firstWord = workingSet->pfns[i] / 64;
+        int                wordCount = 0;
+
+        memset(mask, 0, IDLE_RUN_WORDS * sizeof(unsigned long long));
+
+        for (; i < workingSet->pfnCount; i++)
+        {
+            unsigned long long pfn  = workingSet->pfns[i];
+            unsigned long long word = (pfn / 64) - firstWord;
+
+            if ((word >= IDLE_RUN_WORDS) || (word > (unsigned long long)wordCount + IDLE_RUN_GAP)) break;
+
+            // Shared frames repeat, count each once
+            if (!(mask[word] & (1ULL << (pfn % 64)))) pageCount += 1;
+
+            mask[word] |= 1ULL << (pfn % 64);
+            wordCount = (int)word + 1;
+        }
+
+        off_t offset = (off_t)(firstWord * sizeof(unsigned long long));
+        int   length = wordCount * (int)sizeof(unsigned long long);
+
+        if (workingSet->marked)
+        {
+            if (pread(workingSet->bitmapFd, bitmap, length, offset) != length) goto ioErrno;
+            idleCount += CountCommonBits(mask, bitmap, wordCount);
+            stats->syscallCount += 1;
+        }
+
+        if (pwrite(workingSet->bitmapFd, mask, length, offset) != length) goto ioErrno;
+
+        stats->syscallCount += 1;
+        stats->runCount += 1;
+    }
+
+    long pageSizeKB = sysconf(_SC_PAGESIZE) / 1024;
+
+    stats->residentKB = (size_t)(pageCount * pageSizeKB);
+    stats->activeKB   = (size_t)((pageCount - idleCount) * pageSizeKB);
+
+    status             = workingSet->marked ? 1 : 0;
+    workingSet->marked = true;
+
+    goto done;
+
+ioErrno:
+
+    status = -errno;
+
+ioError:
+
+    workingSet->marked = false;
+
+done:
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = (double)(end.tv_sec - begin.tv_sec) + ((double)(end.tv_nsec - begin.tv_nsec) / 1e9);
+
+    return status;
+}
+
+
+MHAPI void CloseWorkingSet(WorkingSet *workingSet)
+{
+    if (workingSet->pagemapFd >= 0) close(workingSet->pagemapFd);
+    if (workingSet->bitmapFd >= 0) close(workingSet->bitmapFd);
+
+    MH_FREE(workingSet->pfns);
+    MH_FREE(workingSet->words);
+
+    *workingSet = (WorkingSet){.pagemapFd = -1, .bitmapFd = -1};
+}
+
+
+//-----------------------------------------------------------------------------
+// Record rings (`--pipeline`)
+//-----------------------------------------------------------------------------
+//
+// One producer and one consumer thread, fixed-size records copied in and out.
+// head and tail run free and are only masked to index, so full is
+// `tail - head == capacity` without a spare slot. Each side caches the other
+// side's index and only loads it again when the ring looks full or empty.
+//
+// A side that has to wait sleeps on a futex word the other side bumps after
+// every push or pop (and CloseRecordRing() bumps both). The word is read
+// before checking the ring again, so a bump in between makes FUTEX_WAIT
+// return at once instead of losing the wake-up. Wakes are only made while
+// the other side flags that it waits, so the fast path has no syscall.
+
+struct RecordRing
+{
+    _Alignas(64) _Atomic unsigned int tail; // Written by the producer
+    _Atomic unsigned int pushSeq;           // Futex word the consumer waits on
+    unsigned int         cachedHead;        // Producer's last look at head
+
+    _Alignas(64) _Atomic unsigned int head; // Written by the consumer
+    _Atomic unsigned int popSeq;            // Futex word the producer waits on
+    unsigned int         cachedTail;        // Consumer's last look at tail
+
+    _Alignas(64) _Atomic bool producerWaiting;
+    _Atomic bool              consumerWaiting;
+    _Atomic bool              closed;
+
+    _Atomic int                maxDepth; // Producer writes, anyone reads
+    _Atomic unsigned long long pushCount;
+    _Atomic unsigned long long dropCount;
+    _Atomic unsigned long long pushStallNs;
+    _Atomic unsigned long long popWaitNs;
+
+    unsigned int mask; // capacity - 1
+    int          recordSize;
+    char        *records;
+};
+
+
+static void WaitRingWord(_Atomic unsigned int *word, unsigned int value)
+{
+    // EINTR and EAGAIN both mean: look at the ring again
+    syscall(SYS_futex, (unsigned int *)word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+
+static void WakeRingWord(_Atomic unsigned int *word)
+{
+    syscall(SYS_futex, (unsigned int *)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+
+MHAPI RecordRing *CreateRecordRing(int recordSize, int capacity)
+{
+    if ((recordSize <= 0) || (capacity <= 0) || (capacity > (1 << 24))) return NULL;
+
+    RecordRing *ring = MH_CALLOC(1, sizeof(RecordRing));
+    if (!ring) return NULL;
+
+    unsigned int size = 1;
+    while (size < (unsigned int)capacity) size <<= 1;
+
+    ring->mask       = size - 1;
+    ring->recordSize = recordSize;
+    ring->records    = MH_MALLOC((size_t)size * (size_t)recordSize);
+
+    if (!ring->records)
+    {
+        MH_FREE(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+
+MHAPI bool PushRecord(RecordRing *ring, const void *record, bool wait)
+{
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if ((tail - ring->cachedHead) > ring->mask)
+    {
+        ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if ((tail - ring->cachedHead) > ring->mask)
+        {
+            if (!wait || atomic_load(&ring->closed))
+            {
+                atomic_fetch_add_explicit(&ring->dropCount, 1, memory_order_relaxed);
+                return false;
+            }
+
+            unsigned long long stallBeginNs = GetMonotonicNs();
+
+            while ((tail - ring->cachedHead) > ring->mask)
+            {
+                unsigned int seq = atomic_load(&ring->popSeq);
+
+                atomic_store(&ring->producerWaiting, true);
+
+                if (atomic_load(&ring->closed))
+                {
+                    atomic_store(&ring->producerWaiting, false);
+                    atomic_fetch_add_explicit(&ring->dropCount, 1, memory_order_relaxed);
+                    return false;
+                }
+
+                ring->cachedHead = atomic_load(&ring->head);
+                if ((tail - ring->cachedHead) > ring->mask) WaitRingWord(&ring->popSeq, seq);
+
+                atomic_store(&ring->producerWaiting, false);
+                ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+            }
+
+            atomic_fetch_add_explicit(&ring->pushStallNs, GetMonotonicNs() - stallBeginNs, memory_order_relaxed);
+        }
+    }
+
+    memcpy(ring->records + ((size_t)(tail & ring->mask) * (size_t)ring->recordSize), record, (size_t)ring->recordSize);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    atomic_fetch_add(&ring->pushSeq, 1);
+
+    if (atomic_load(&ring->consumerWaiting)) WakeRingWord(&ring->pushSeq);
+
+    // cachedHead is only refreshed when the ring looks full, so it would count records long popped
+    int depth = (int)(tail + 1 - atomic_load_explicit(&ring->head, memory_order_relaxed));
+    if (depth > atomic_load_explicit(&ring->maxDepth, memory_order_relaxed)) atomic_store_explicit(&ring->maxDepth, depth, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&ring->pushCount, 1, memory_order_relaxed);
+
+    return true;
+}
+
+
+MHAPI bool PopRecord(RecordRing *ring, void *record)
+{
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head == ring->cachedTail)
+    {
+        ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        if (head == ring->cachedTail)
+        {
+            unsigned long long waitBeginNs = GetMonotonicNs();
+
+            while (head == ring->cachedTail)
+            {
+                unsigned int seq    = atomic_load(&ring->pushSeq);
+                bool         closed = atomic_load(&ring->closed);
+
+                atomic_store(&ring->consumerWaiting, true);
+
+                // Pushes made before closing are still drained
+                ring->cachedTail = atomic_load(&ring->tail);
+
+                if ((head == ring->cachedTail) && closed)
+                {
+                    atomic_store(&ring->consumerWaiting, false);
+                    atomic_fetch_add_explicit(&ring->popWaitNs, GetMonotonicNs() - waitBeginNs, memory_order_relaxed);
+                    return false;
+                }
+
+                if (head == ring->cachedTail) WaitRingWord(&ring->pushSeq, seq);
+
+                atomic_store(&ring->consumerWaiting, false);
+                ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            }
+
+            atomic_fetch_add_explicit(&ring->popWaitNs, GetMonotonicNs() - waitBeginNs, memory_order_relaxed);
+        }
+    }
+
+    memcpy(record, ring->records + ((size_t)(head & ring->mask) * (size_t)ring->recordSize), (size_t)ring->recordSize);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add(&ring->popSeq, 1);
+
+    if (atomic_load(&ring->producerWaiting)) WakeRingWord(&ring->popSeq);
+
+    return true;
+}
+
+
+MHAPI void CloseRecordRing(RecordRing *ring)
+{
+    atomic_store(&ring->closed, true);
+
+    atomic_fetch_add(&ring->pushSeq, 1);
+    atomic_fetch_add(&ring->popSeq, 1);
+
+    WakeRingWord(&ring->pushSeq);
+    WakeRingWord(&ring->popSeq);
+}
+
+
+MHAPI void GetRecordRingStats(RecordRing *ring, RecordRingStats *stats)
+{
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    *stats = (RecordRingStats){
+        .capacity    = (int)ring->mask + 1,
+        .depth       = ((tail - head) > ring->mask) ? (int)ring->mask + 1 : (int)(tail - head),
+        .maxDepth    = atomic_load_explicit(&ring->maxDepth, memory_order_relaxed),
+        .pushCount   = atomic_load_explicit(&ring->pushCount, memory_order_relaxed),
+        .dropCount   = atomic_load_explicit(&ring->dropCount, memory_order_relaxed),
+        .pushStallNs = atomic_load_explicit(&ring->pushStallNs, memory_order_relaxed),
+        .popWaitNs   = atomic_load_explicit(&ring->popWaitNs, memory_order_relaxed),
+    };
+}
+
+
+MHAPI void DestroyRecordRing(RecordRing *ring)
+{
+    if (!ring) return;
 
-    return status; // EXIT_SUCCESS
+    MH_FREE(ring->records);
+    MH_FREE(ring);
 }
@@ -10,8 +10,12 @@
     #define MEMHOLD_H
 
 
-    #include <stdarg.h> // Required for: va_list - Only used by TraceLogCallback
-    #include <stdio.h>  // Required for: fprintf() - Only used by macro UNIMPLEMENTED
+    #include <dirent.h>    // Required for: DIR - Only used by ThreadSampler
+    #include <stdarg.h>    // Required for: va_list - Only used by TraceLogCallback
+    #include <stddef.h>    // Required for: size_t
+    #include <stdio.h>     // Required for: fprintf() - Only used by macro UNIMPLEMENTED
+    #include <sys/types.h> // Required for: pid_t
+    #include <time.h>      // Required for: struct timespec - Only used by ThreadSampler
 
 
     #define MEMHOLD_VERSION_MAJOR 0
@@ -63,9 +67,59 @@
     // /proc/PID/state
     //      Process status.
     //      See https://tldp.org/LDP/Linux-Filesystem-Hierarchy/html/proc.html
-    #define PROCESS_STAT_UTIME_INDEX     14
-    #define PROCESS_STAT_STIME_INDEX     15
-    #define PROCESS_STAT_STARTTIME_INDEX 22
+    #define PROCESS_STAT_STATE_INDEX       3
+    #define PROCESS_STAT_MINFLT_INDEX      10
+    #define PROCESS_STAT_MAJFLT_INDEX      12
+    #define PROCESS_STAT_UTIME_INDEX       14
+    #define PROCESS_STAT_STIME_INDEX       15
+    #define PROCESS_STAT_NUM_THREADS_INDEX 20
+    #define PROCESS_STAT_STARTTIME_INDEX   22
+    #define PROCESS_STAT_VSIZE_INDEX       23
+    #define PROCESS_STAT_RSS_INDEX         24
+
+    // Debugging: MEMHOLD_SAMPLE_GENERIC = 1 --> every sample plan reads and parses all of /proc/<pid>/stat (see MH_SAMPLE_PLANS)
+    #ifndef MEMHOLD_SAMPLE_GENERIC
+        #define MEMHOLD_SAMPLE_GENERIC 0
+    #endif
+
+    // Longest `comm` we keep. Kernel threads may exceed TASK_COMM_LEN (16)
+    #define MH_COMM_LEN 64
+
+    // Number of hottest threads reported in `--threads` mode
+    #define MH_THREAD_TOP_K 5
+
+    // Major faults per frame that turn on per-thread sampling (see `--threads`)
+    #define MH_FAULT_THRESHOLD 64
+
+    // oom_score_adj of protected processes (`oom=protect` in rules), and the
+    // smallest change worth a write when steering
+    #define MH_OOM_PROTECT_ADJ -900
+    #define MH_OOM_HYSTERESIS  50
+
+    // Threshold values that never trigger (`mem=none`, `cpu=none` in rules)
+    #define MH_NO_LIMIT     ((size_t)-1)
+    #define MH_NO_LIMIT_CPU FLT_MAX
+
+    // Longest comm/exe/cmdline pattern of a rule
+    #define MH_RULE_PATTERN_LEN 128
+
+    // Rows of /proc/<pid>/limits, one per RLIMIT_* resource (RLIM_NLIMITS)
+    #define MH_PROC_LIMIT_COUNT 16
+
+    // "unlimited" in /proc/<pid>/limits, same value as RLIM_INFINITY
+    #define MH_LIMIT_UNLIMITED (~0ULL)
+
+    // PIDs per taskstats sendmsg(). Two requests each, so 128 replies per recvmmsg() round
+    #define MH_TASKSTATS_BATCH 64
+
+    // Bytes read from one /proc/<pid>/stat by a ProcReader (the line is well under 1K)
+    #define MH_PROC_READ_SIZE 1024
+
+    // Histogram layout: 2^MH_HISTOGRAM_SUB_BITS linear buckets per power of two (~3% error),
+    // values up to 2^MH_HISTOGRAM_MAX_BITS (in ns, ~18 minutes). Larger ones count in the last bucket
+    #define MH_HISTOGRAM_SUB_BITS 5
+    #define MH_HISTOGRAM_MAX_BITS 40
+    #define MH_HISTOGRAM_BUCKETS  ((MH_HISTOGRAM_MAX_BITS - MH_HISTOGRAM_SUB_BITS + 1) << MH_HISTOGRAM_SUB_BITS)
 
     ///
     /// NOTE(Lloyd): The following is ported from raylib.h
@@ -165,6 +219,267 @@ typedef struct Color
 
 } Color;
 
+// Sampling context (opaque). Create one with CreateMemholdContext()
+typedef struct MemholdContext MemholdContext;
+
+// Work-stealing pool of sampler threads (opaque). Create one with CreateSamplerPool()
+typedef struct SamplerPool SamplerPool;
+
+// Kept-open /proc/<pid>/stat fds read in batches (opaque). Create one with CreateProcReader()
+typedef struct ProcReader ProcReader;
+
+// Bounded single-producer/single-consumer ring of fixed-size records (opaque). Create one with CreateRecordRing()
+typedef struct RecordRing RecordRing;
+
+// Fields of /proc/<pid>/stat (and /proc/<pid>/task/<tid>/stat) we care about.
+// See proc(5) for the full list. Field numbers are in PROCESS_STAT_*_INDEX.
+typedef struct ProcStat
+{
+    pid_t pid;
+    char  comm[MH_COMM_LEN];
+    char  state;
+
+    unsigned long minflt;
+    unsigned long majflt;
+
+    unsigned long long utime; // Clock ticks
+    unsigned long long stime; // Clock ticks
+
+    long               numThreads;
+    unsigned long long starttime; // Clock ticks after boot
+    unsigned long      vsize;     // Bytes
+    long               rss;       // Pages
+
+} ProcStat;
+
+// Fields of /proc/<pid>/status. Sizes are in KB, as the file has them.
+// Only the fields in ParseProcStatus()'s mask are filled, see `found`.
+typedef struct ProcStatus
+{
+    size_t vmRssKB;
+    size_t vmHwmKB; // Peak RSS
+    size_t vmSwapKB;
+    size_t rssAnonKB;
+    size_t rssFileKB;
+    size_t rssShmemKB;
+
+    long          threads;
+    unsigned long voluntaryCtxtSwitches;
+    unsigned long nonvoluntaryCtxtSwitches;
+
+    unsigned int found; // ProcStatusField bits of the fields read. Kernel threads have no Vm*/Rss* lines
+
+} ProcStatus;
+
+// Resource limits of /proc/<pid>/limits, indexed by RLIMIT_* resource (see
+// getrlimit(2)). Values are in the file's units: bytes, seconds or counts.
+typedef struct ProcLimits
+{
+    unsigned long long soft[MH_PROC_LIMIT_COUNT]; // MH_LIMIT_UNLIMITED for "unlimited"
+    unsigned long long hard[MH_PROC_LIMIT_COUNT]; //
+
+    unsigned int found; // (1 << RLIMIT_*) bits of the rows read
+
+} ProcLimits;
+
+// Host paging counters of /proc/vmstat, in pages since boot
+typedef struct VmStat
+{
+    unsigned long long pswpin;            // Pages swapped in
+    unsigned long long pswpout;           // Pages swapped out
+    unsigned long long pgmajfault;        // Major faults of every process
+    unsigned long long workingsetRefault; // Evicted pages faulted back in soon after (anon + file)
+
+} VmStat;
+
+// Counters of a RecordRing. Totals are since CreateRecordRing()
+typedef struct RecordRingStats
+{
+    int capacity; // Records
+    int depth;    // Queued now
+    int maxDepth; // Most ever queued
+
+    unsigned long long pushCount;
+    unsigned long long dropCount;   // Pushes without waiting that found the ring full
+    unsigned long long pushStallNs; // Producer waited for room
+    unsigned long long popWaitNs;   // Consumer waited for records
+
+} RecordRingStats;
+
+// One thread of a monitored process.
+typedef struct ThreadSample
+{
+    pid_t tid;
+    int   fd; // Kept open across frames: /proc/<pid>/task/<tid>/stat
+    char  comm[MH_COMM_LEN];
+
+    unsigned long long cpuTicks; // utime + stime
+    unsigned long long cpuDelta; // Ticks since previous sample
+    unsigned long      minflt;
+    unsigned long      majflt;
+    unsigned long      minfltDelta;
+    unsigned long      majfltDelta;
+
+    bool primed; // Has a previous sample, so deltas are meaningful
+    bool alive;  // Seen in latest walk of /proc/<pid>/task
+
+} ThreadSample;
+
+// One taskstats sample. Times are cumulative since the task started.
+typedef struct TaskSample
+{
+    pid_t pid;
+
+    unsigned long long cpuRunRealNs;    // On-CPU time, all threads (scheduler clock)
+    unsigned long long cpuRunVirtualNs; // Same, excluding steal time
+    unsigned long long utimeUs;
+    unsigned long long stimeUs;
+
+    unsigned long long hiwaterRssKB; // RSS high-water mark
+    unsigned long long hiwaterVmKB;  // Virtual memory high-water mark
+
+    unsigned long long readBytes;  // Storage I/O of the group leader
+    unsigned long long writeBytes; //
+    unsigned long long minflt;     //
+    unsigned long long majflt;     //
+
+    unsigned long long cpuDelayNs;       // Delay accounting: waiting for a CPU
+    unsigned long long blkioDelayNs;     //   ... for synchronous block I/O
+    unsigned long long swapinDelayNs;    //   ... for swap-in
+    unsigned long long reclaimDelayNs;   //   ... in direct memory reclaim (freepages)
+    unsigned long long thrashingDelayNs; //   ... on refaulting pages
+
+    unsigned long long elapsedUs; // Since the task started (CLOCK_MONOTONIC)
+
+    bool groupExit; // Exit record of the last task of the process
+
+} TaskSample;
+
+typedef struct TaskstatsBackend
+{
+    int fd;     // Query socket
+    int exitFd; // Exit record socket, -1 until ListenTaskstatsExit()
+
+    unsigned short familyId; // Resolved TASKSTATS generic netlink family
+    unsigned int   seq;
+    bool           available;
+
+    char *requestBuffer; // MH_TASKSTATS_BATCH * 2 requests
+    char *replyBuffer;   // MH_TASKSTATS_BATCH * 2 replies
+
+} TaskstatsBackend;
+
+// Per-thread sampler. Only kept alive while the process is above threshold.
+typedef struct ThreadSampler
+{
+    pid_t pid;
+    bool  active;
+
+    DIR          *taskDir; // /proc/<pid>/task, rewound on each sample
+    ThreadSample *threads; // Ordered as readdir() returns them
+    int           count;
+    int           capacity;
+
+    struct timespec lastSampleTime;
+    double          sampleSeconds; // Wall time between the last two samples
+
+} ThreadSampler;
+
+// Soft hold state of one process. The pidfd pins the process, so advice is
+// never given to a process that reused its PID.
+typedef struct Reclaimer
+{
+    int           pidfd;       // -1 until the first soft hold
+    unsigned long nextAddress; // Where a capped pass resumes, 0 for a new pass
+
+} Reclaimer;
+
+// oom_score_adj of one process through a kept-open fd. Writes to the fd of a
+// process that exited fail, so a reused PID is never steered by mistake.
+typedef struct OomScore
+{
+    int fd;       // /proc/<pid>/oom_score_adj, -1 until opened
+    int original; // At OpenOomScore(), restored by CloseOomScore()
+    int current;  // Last read or written
+
+} OomScore;
+
+// Idle page tracking state of one process (`--wss`, see SampleWorkingSet())
+typedef struct WorkingSet
+{
+    int  pagemapFd; // /proc/<pid>/pagemap, -1 when closed
+    int  bitmapFd;  // /sys/kernel/mm/page_idle/bitmap
+    bool marked;    // The last call marked the pages idle, so the next one can count
+
+    unsigned long long *pfns; // Resident page frames, sorted
+    int                 pfnCount;
+    int                 pfnCapacity;
+
+    unsigned long long *words; // One run of the bitmap: our bits, then what the file has
+
+} WorkingSet;
+
+// Outcome of one SampleWorkingSet() call
+typedef struct WorkingSetStats
+{
+    size_t residentKB;   // Mapped pages with a page frame
+    size_t activeKB;     // Of them, accessed since the previous call
+    int    runCount;     // Bitmap runs read and written
+    int    syscallCount; // pagemap and bitmap reads and writes
+    double seconds;
+
+} WorkingSetStats;
+
+// Outcome of one ReclaimProcessMemory() call
+typedef struct ReclaimStats
+{
+    size_t bytesAdvised; // Accepted by process_madvise()
+    int    regionCount;  // Private anonymous regions advised
+    int    callCount;    // process_madvise() calls
+    bool   passDone;     // Reached the end of the address space
+    double seconds;
+
+} ReclaimStats;
+
+
+// Fixed-memory log-linear (HDR-style) histogram. Recording is a plain
+// increment, so each thread records into its own and they are merged with
+// MergeHistogram() to report.
+typedef struct Histogram
+{
+    unsigned long long counts[MH_HISTOGRAM_BUCKETS];
+    unsigned long long totalCount;
+    unsigned long long maxValue; // Exact
+
+} Histogram;
+
+// Latencies of the procfs reads of one thread, in ns
+typedef struct SampleTimings
+{
+    Histogram readNs;  // open() + read() + close(), or one read of a kept-open fd
+    Histogram parseNs; // ParseProcStat()
+
+} SampleTimings;
+
+// One process sample, filled by SampleProcess()
+typedef struct ProcessSample
+{
+    pid_t pid;
+    char  comm[MH_COMM_LEN];
+    char  state;
+
+    unsigned long long starttime; // Clock ticks after boot. With pid, the identity of the process
+
+    unsigned long long cpuTimeNs; // Cumulative utime + stime
+    unsigned long      minflt;
+    unsigned long      majflt;
+    long               numThreads;
+
+    size_t vsizeKB;
+    size_t rssKB; // Same counters as VmRSS in /proc/<pid>/status
+
+} ProcessSample;
+
 //----------------------------------------------------------------------------------
 // Enumerators Definition
 //----------------------------------------------------------------------------------
@@ -209,6 +524,69 @@ typedef enum
 
 } TraceLogLevel;
 
+// Fields of /proc/<pid>/status, as a mask for ParseProcStatus()
+typedef enum
+{
+    STATUS_VM_RSS                     = 0x0001, // VmRSS
+    STATUS_VM_HWM                     = 0x0002, // VmHWM
+    STATUS_VM_SWAP                    = 0x0004, // VmSwap
+    STATUS_RSS_ANON                   = 0x0008, // RssAnon
+    STATUS_RSS_FILE                   = 0x0010, // RssFile
+    STATUS_RSS_SHMEM                  = 0x0020, // RssShmem
+    STATUS_THREADS                    = 0x0040, // Threads
+    STATUS_VOLUNTARY_CTXT_SWITCHES    = 0x0080, // voluntary_ctxt_switches
+    STATUS_NONVOLUNTARY_CTXT_SWITCHES = 0x0100, // nonvoluntary_ctxt_switches
+    STATUS_ALL                        = 0x01ff
+
+} ProcStatusField;
+
+// Fields of a ProcessSample, as a mask for a SamplePlan
+typedef enum
+{
+    SAMPLE_FIELD_IDENTITY = 0x0001, // comm, state, starttime
+    SAMPLE_FIELD_CPU      = 0x0002, // cpuTimeNs
+    SAMPLE_FIELD_FAULTS   = 0x0004, // minflt, majflt
+    SAMPLE_FIELD_THREADS  = 0x0008, // numThreads
+    SAMPLE_FIELD_VSIZE    = 0x0010, // vsizeKB
+    SAMPLE_FIELD_RSS      = 0x0020, // rssKB
+    SAMPLE_FIELD_ALL      = 0x003f
+
+} SampleField;
+
+// Sampler variants, cheapest first: X(plan, file, fields). A reader and
+// parser specialized on `fields` is generated for each, and the fields
+// left out are 0 in the samples. SelectSamplePlan() picks the first one
+// covering what a policy uses.
+//
+// Note: ~
+//   - statm has no starttime, so without a kept-open fd (which fails with
+//     ESRCH once its process is gone) a reused PID goes unnoticed. Ask for
+//     SAMPLE_FIELD_IDENTITY when reading by path.
+#define MH_SAMPLE_PLANS(X)                                                                            \
+    X(SAMPLE_PLAN_STATM_RSS, "statm", SAMPLE_FIELD_RSS)                                               \
+    X(SAMPLE_PLAN_STATM_MEM, "statm", SAMPLE_FIELD_RSS | SAMPLE_FIELD_VSIZE)                          \
+    X(SAMPLE_PLAN_STAT_MEM, "stat", SAMPLE_FIELD_IDENTITY | SAMPLE_FIELD_RSS | SAMPLE_FIELD_VSIZE)    \
+    X(SAMPLE_PLAN_STAT_CPU, "stat", SAMPLE_FIELD_ALL & ~(SAMPLE_FIELD_FAULTS | SAMPLE_FIELD_THREADS)) \
+    X(SAMPLE_PLAN_STAT_ALL, "stat", SAMPLE_FIELD_ALL)
+
+typedef enum
+{
+#define MH_SAMPLE_PLAN_ENUM(plan, file, fields) plan,
+    MH_SAMPLE_PLANS(MH_SAMPLE_PLAN_ENUM)
+#undef MH_SAMPLE_PLAN_ENUM
+    SAMPLE_PLAN_COUNT
+
+} SamplePlan;
+
+// How a ProcReader reads its stat fds
+typedef enum
+{
+    PROC_READER_PREAD = 0,   // One pread() per process
+    PROC_READER_URING,       // One io_uring_enter() per frame, registered fds
+    PROC_READER_URING_FIXED, // Same, into registered buffers (IORING_OP_READ_FIXED)
+
+} ProcReaderMode;
+
 
 // Callbacks to hook some internal functions
 // WARNING: These callbacks are intended for advance users
@@ -236,6 +614,94 @@ extern "C"
 
     #endif
 
+    // Process sampling functions (Module: libmemhold)
+    // NOTE: Nothing here writes to stdout or keeps global state. Calls taking a
+    // `const MemholdContext *` may share one context across threads. Samplers,
+    // taskstats backends and reclaimers belong to one thread at a time.
+    MHAPI MemholdContext *CreateMemholdContext(void);                                                         // Create a sampling context, NULL on error
+    MHAPI void            DestroyMemholdContext(MemholdContext *context);                                     // Destroy a sampling context
+    MHAPI int             SampleProcess(const MemholdContext *context, pid_t pid, ProcessSample *sample);     // Sample all of one stat, 0 or -errno
+    MHAPI int             SampleProcesses(const MemholdContext *context, const pid_t *pids, int count,        // Sample `count` processes, `results[i]` is
+                                          ProcessSample *samples, int *results);                             // 0 or -errno. Returns how many succeeded
+    MHAPI int             SampleProcessesTimed(const MemholdContext *context, const pid_t *pids, int count,   // SampleProcesses(), recording read and
+                                               ProcessSample *samples, int *results, SampleTimings *timings); // parse latency into `timings`
+    MHAPI double          GetProcessAgeSec(const MemholdContext *context, unsigned long long starttime);      // Seconds since a process started
+    MHAPI SamplePlan      SelectSamplePlan(unsigned int fieldMask);                                           // Cheapest plan sampling every SampleField in the mask
+    MHAPI void            SetSamplePlan(MemholdContext *context, SamplePlan plan);                            // Plan of SampleProcesses() and readers, SAMPLE_PLAN_STAT_ALL
+    MHAPI SamplePlan      GetSamplePlan(const MemholdContext *context);                                       // by default. Between frames only
+    MHAPI const char     *GetSamplePlanFile(SamplePlan plan);                                                 // "stat" or "statm"
+    MHAPI unsigned int    GetSamplePlanFields(SamplePlan plan);                                               // SampleField bits a plan fills
+    MHAPI long            GetSystemUptimeSec(pid_t pid);                                                      // Seconds since boot (CLOCK_BOOTTIME)
+
+    MHAPI SamplerPool *CreateSamplerPool(const MemholdContext *context, int workerCount);   // Start a pool of sampler threads, NULL on error
+    MHAPI int          SampleProcessesParallel(SamplerPool *pool, const pid_t *pids,        // SampleProcesses() over the pool with work
+                                               int count, ProcessSample *samples, int *results); // stealing. One frame at a time
+    MHAPI int          GetSamplerPoolSteals(const SamplerPool *pool);                       // Chunks stolen in the last frame
+    MHAPI void         GetSamplerPoolTimings(const SamplerPool *pool, SampleTimings *timings); // Merge every worker's latencies. Between frames only
+    MHAPI void         DestroySamplerPool(SamplerPool *pool);                               // Stop and join the sampler threads
+
+    MHAPI ProcReader    *CreateProcReader(const MemholdContext *context, int capacity, bool useUring); // Create a reader, io_uring when the kernel has it
+    MHAPI int            AttachProcReader(ProcReader *reader, int slot, pid_t pid);                    // Keep /proc/<pid>/stat (or statm) open in `slot`, 0 or -errno
+    MHAPI void           DetachProcReader(ProcReader *reader, int slot);                               // Close the fd in `slot`
+    MHAPI int            ReadProcStats(ProcReader *reader, const int *slots, int count,                // SampleProcesses() over attached slots, in one
+                                       ProcessSample *samples, int *results);                         // io_uring batch. Returns how many succeeded
+    MHAPI ProcReaderMode GetProcReaderMode(const ProcReader *reader);                                  // How the reader reads, after detection
+    MHAPI int            GetProcReaderSyscalls(const ProcReader *reader);                              // Syscalls made by the last ReadProcStats()
+    MHAPI void           GetProcReaderTimings(const ProcReader *reader, SampleTimings *timings);       // Merge the reader's latencies into `timings`
+    MHAPI void           DestroyProcReader(ProcReader *reader);                                        // Close every fd and the ring
+
+    MHAPI RecordRing *CreateRecordRing(int recordSize, int capacity);              // Capacity is rounded up to a power of two, NULL on error
+    MHAPI bool        PushRecord(RecordRing *ring, const void *record, bool wait); // Producer side. false when full (without `wait`) or closed
+    MHAPI bool        PopRecord(RecordRing *ring, void *record);                   // Consumer side, waits. false once closed and drained
+    MHAPI void        CloseRecordRing(RecordRing *ring);                           // Either side: no more pushes, wake whoever waits
+    MHAPI void        GetRecordRingStats(RecordRing *ring, RecordRingStats *stats); // Any thread
+    MHAPI void        DestroyRecordRing(RecordRing *ring);                         // Once both sides are done
+
+    MHAPI int  ParseProcStat(const char *buf, int bufLen, ProcStat *stat); // Parse a /proc/<pid>/stat buffer, 0 or -1
+    MHAPI int  GetProcStat(pid_t pid, ProcStat *stat);                     // Read and parse /proc/<pid>/stat, 0 or -1
+    MHAPI long GetCpuUsage(pid_t pid);                                     // utime + stime in clock ticks, -1 on error
+    MHAPI int  GetMemoryPressure(int fd, float *someAvg10);                // PSI memory "some avg10" of an open /proc/pressure/memory
+    MHAPI int  GetVmStat(int fd, VmStat *vmStat);                          // Paging counters of an open /proc/vmstat, 0 or -1
+    MHAPI long GetMemUsage(pid_t pid);                                     // VmRSS in KB, -1 on error or for kernel threads
+    MHAPI long GetMemUsageStatm(const MemholdContext *context, pid_t pid); // VmRSS in KB from /proc/<pid>/statm, -1 on error
+    MHAPI int  ParseProcStatus(const char *buf, int bufLen,                // Parse the `fieldMask` fields of a /proc/<pid>/status
+                               unsigned int fieldMask, ProcStatus *status); // buffer in one pass. Returns how many were found
+    MHAPI int  GetProcStatus(pid_t pid, unsigned int fieldMask, ProcStatus *status); // Read and parse /proc/<pid>/status, -1 on error
+    MHAPI int  ParseProcLimits(const char *buf, int bufLen, ProcLimits *limits);    // Parse a /proc/<pid>/limits buffer. Returns how many rows were found
+    MHAPI int  GetProcLimits(pid_t pid, ProcLimits *limits);                        // Read and parse /proc/<pid>/limits, 0 or -errno
+    MHAPI const char *GetProcLimitName(int resource);                               // Row name of an RLIMIT_* resource, e.g. "Max address space"
+    MHAPI int  SetProcSoftLimit(pid_t pid, int resource, unsigned long long soft,   // Set the soft limit of `resource` (at most the current hard
+                                unsigned long long *previous);                       // one, which is kept). `previous` gets the replaced one. 0 or -errno
+
+    MHAPI void               RecordHistogram(Histogram *histogram, unsigned long long value);        // Count one value
+    MHAPI void               MergeHistogram(Histogram *histogram, const Histogram *other);           // Add `other` into `histogram`
+    MHAPI unsigned long long GetHistogramPercentile(const Histogram *histogram, double percentile); // Value at or under `percentile`% of counts
+    MHAPI unsigned long long GetMonotonicNs(void);                                                   // CLOCK_MONOTONIC in ns
+
+    MHAPI int  InitThreadSampler(ThreadSampler *sampler, pid_t pid);                          // Start sampling the threads of a process
+    MHAPI int  SampleThreads(ThreadSampler *sampler);                                         // Sample every thread, returns how many are alive
+    MHAPI int  GetTopThreads(const ThreadSampler *sampler, ThreadSample *topThreads, int k); // Copy the K hottest threads
+    MHAPI void UnloadThreadSampler(ThreadSampler *sampler);                                   // Close every thread fd
+
+    MHAPI int  InitTaskstats(TaskstatsBackend *ts);                                                                     // Open the taskstats backend, errno on error
+    MHAPI int  GetTaskstats(TaskstatsBackend *ts, pid_t pid, TaskSample *sample);                                       // Query one process
+    MHAPI int  GetTaskstatsBatch(TaskstatsBackend *ts, const pid_t *pids, int count, TaskSample *samples, int *results); // Query many processes
+    MHAPI int  ListenTaskstatsExit(TaskstatsBackend *ts, const char *cpumask);                                          // Subscribe to exit records
+    MHAPI int  PollTaskstatsExit(TaskstatsBackend *ts, TaskSample *samples, int maxCount);                              // Drain exit records
+    MHAPI void CloseTaskstats(TaskstatsBackend *ts);                                                                    // Close the taskstats backend
+
+    MHAPI int  OpenReclaimer(Reclaimer *reclaimer, pid_t pid);                                                           // Open a pidfd for soft holds
+    MHAPI int  ReclaimProcessMemory(Reclaimer *reclaimer, pid_t pid, int advice, size_t maxBytes, ReclaimStats *stats); // MADV_COLD/MADV_PAGEOUT
+    MHAPI void CloseReclaimer(Reclaimer *reclaimer);                                                                     // Close the pidfd
+
+    MHAPI int  OpenWorkingSet(WorkingSet *workingSet, pid_t pid);                                   // Open pagemap and the idle bitmap, 0 or -errno
+    MHAPI int  SampleWorkingSet(WorkingSet *workingSet, pid_t pid, WorkingSetStats *stats);         // Count what was accessed, mark idle again. 1 with an estimate, 0 or -errno
+    MHAPI void CloseWorkingSet(WorkingSet *workingSet);                                             // Close and free
+
+    MHAPI int  OpenOomScore(OomScore *score, pid_t pid);       // Open oom_score_adj and read it, 0 or -errno
+    MHAPI int  SetOomScore(OomScore *score, int value);        // One pwrite(), 0 or -errno
+    MHAPI void CloseOomScore(OomScore *score, bool restore);   // Close, writing the original value back first with `restore`
+
     // Window-related functions
     MHAPI void InitWindow(int width, int height, const char *title); // Initialize window and OpenGL context
     MHAPI void CloseWindow(void);                                    // Close window and unload OpenGL context